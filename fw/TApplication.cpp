@@ -330,55 +330,33 @@ void TApplication::PollEvent(bool allowSleep)
 			throw exception;
 		}
 		
-		if (XPending(fDisplay))
+		// handle everything that has arrived before laying out and drawing,
+		// but not what arrives meanwhile, so a steady stream of events cannot hold off drawing
+		int count = XEventsQueued(fDisplay, QueuedAfterReading);
+		
+		while (count-- > 0 && XPending(fDisplay))
 		{
 			XEvent	event;
 			XNextEvent(fDisplay, &event);
-			TWindow* imWindow = TInputContext::GetFocusedWindow();
 
-			if (event.type == KeyPress || event.type == KeyRelease || !XFilterEvent(&event, (imWindow ? imWindow->GetXWindow() : None)))
+			// only the last of several resizes needs to be laid out
+			if (event.type == ConfigureNotify)
 			{
-				ASSERT(event.xany.display == fDisplay);
-				TWindow* window = TWindow::GetWindow(event.xany.window);
-
-				if (window)
-				{
-					if (fModalDialog)
-					{
-						TTopLevelWindow* topLevel = window->GetTopLevelWindow();
-						
-						// check for topLevel != NULL to avoid problems with menus in dialogs
-						if (topLevel && topLevel != fModalDialog)
-						{
-							// always pass these events
-							if (event.type == Expose || event.type == FocusOut)
-								window->HandleEvent(event);
-							else if (event.type == FocusIn)
-								RaiseModalDialogs(fModalDialog, topLevel);
-						}
-						else
-							window->HandleEvent(event);
-					}
-					else
-						window->HandleEvent(event);
-				}
-				else if (event.xany.window == fLeaderWindow)
-				{
-					HandleLeaderWindowEvent(event);
-				}
-					
+				while (XCheckTypedWindowEvent(fDisplay, event.xany.window, ConfigureNotify, &event))
+					count--;
 			}
+
+			DispatchEvent(event);
 		}
 
-		if (!XPending(fDisplay))
-			TWindow::ProcessUpdates();
+		TWindow::ProcessUpdates();
 	
 		int sleepTime = fNextIdle - GetCurrentTime();
 		if (sleepTime <= 0)
 		{
 			Idle();
 		}
-		else if (allowSleep && !XPending(fDisplay) && !CheckForSignals())
+		else if (allowSleep && !XPending(fDisplay) && !TWindow::HasPendingUpdates() && !CheckForSignals())
 		{
 			CheckForSignals();
 			fInSelect = true;
@@ -428,6 +406,44 @@ void TApplication::PollEvent(bool allowSleep)
 }
 
 
+void TApplication::DispatchEvent(XEvent& event)
+{
+	TWindow* imWindow = TInputContext::GetFocusedWindow();
+
+	if (event.type == KeyPress || event.type == KeyRelease || !XFilterEvent(&event, (imWindow ? imWindow->GetXWindow() : None)))
+	{
+		ASSERT(event.xany.display == fDisplay);
+		TWindow* window = TWindow::GetWindow(event.xany.window);
+
+		if (window)
+		{
+			if (fModalDialog)
+			{
+				TTopLevelWindow* topLevel = window->GetTopLevelWindow();
+				
+				// check for topLevel != NULL to avoid problems with menus in dialogs
+				if (topLevel && topLevel != fModalDialog)
+				{
+					// always pass these events
+					if (event.type == Expose || event.type == FocusOut)
+						window->HandleEvent(event);
+					else if (event.type == FocusIn)
+						RaiseModalDialogs(fModalDialog, topLevel);
+				}
+				else
+					window->HandleEvent(event);
+			}
+			else
+				window->HandleEvent(event);
+		}
+		else if (event.xany.window == fLeaderWindow)
+		{
+			HandleLeaderWindowEvent(event);
+		}
+	}
+}
+
+
 void TApplication::Close()
 {
 	if (CloseSubContexts())
@@ -151,6 +151,7 @@ protected:
 	static bool				FindFileIdleProc(void* data);
 
 	void					PollEvent(bool allowSleep = true);
+	void					DispatchEvent(XEvent& event);
 	void					Idle();
 	void					ComputeNextIdle();
 
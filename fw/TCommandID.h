@@ -95,6 +95,16 @@ const TCommandID kShiftLeftCommandID			= 500;
 const TCommandID kShiftRightCommandID			= 501;
 const TCommandID kBalanceSelectionCommandID		= 502;
 const TCommandID kToggleLineWrapCommandID		= 503;
+const TCommandID kSortLinesCommandID			= 504;
+const TCommandID kSortLinesNumericallyCommandID	= 505;
+const TCommandID kSortLinesIgnoringCaseCommandID	= 506;
+const TCommandID kSortLinesByColumnCommandID	= 507;
+const TCommandID kUniqueLinesCommandID			= 508;
+const TCommandID kKeepMatchingLinesCommandID	= 509;
+const TCommandID kDeleteMatchingLinesCommandID	= 510;
+const TCommandID kNextChangeCommandID			= 511;
+const TCommandID kPreviousChangeCommandID		= 512;
+const TCommandID kSortLinesReversedCommandID	= 513;
 
 // For Documents
 const TCommandID kFilePathChangedCommandID		= 600;
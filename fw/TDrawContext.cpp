@@ -35,39 +35,75 @@
 #include <string.h>
 #include <stdlib.h>
 
+#ifdef HAVE_XRENDER
+#include <X11/extensions/Xrender.h>
+#endif
+
 Display*	TDrawContext::sDisplay = 0;
 TFont*		TDrawContext::sDefaultFont = NULL;
+TGCState*	TDrawContext::sFreeGCs = NULL;
+int			TDrawContext::sFreeGCCount = 0;
+
+// enough for the draw contexts that are alive at the same time
+const int	kMaxFreeGCs = 16;
+
+// batches covering at least this many pixels are drawn on the client
+const int	kMinRasterArea = 256 * 256;
+
+static int		sRasterDepth = 0;				// depth we can draw on the client, 0 if none
+static TImage*	sRasterImage = NULL;
+static bool		sRasterImagePending = false;	// an XShmPutImage of it may not have been read yet
+
+#ifdef HAVE_XRENDER
+// set if the server's RENDER extension can draw text to windows of the default visual
+static XRenderPictFormat*	sRenderFormat = NULL;
+static int					sRenderDepth = 0;
+#endif
 
 
 TDrawContext::TDrawContext(TDrawable* drawable, TRegion* clip)
 	:	fGC(0),
+		fGCState(NULL),
 		fDrawable(drawable),
 		fScroll(drawable->GetScroll()),
+		fPenMode(kCopyMode),
 		fFont(NULL),
 		fForeColor(kBlackColor),
-		fBackColor(kWhiteColor)
+		fBackColor(kWhiteColor),
+		fBatching(false),
+		fBatchFills(NULL),
+		fBatchTexts(NULL),
+		fBatchChars(NULL),
+		fBatchCharsLength(0),
+		fBatchCharsSize(0)
+#ifdef HAVE_XRENDER
+		, fPicture(0)
+#endif
 {
 	Initialize(drawable);
 
-	if (clip)
-	{
-		// clip is in unscrolled coordinates
-		XSetRegion(sDisplay, fGC, clip->GetRegion());
-	}
+	// clip is in unscrolled coordinates
+	SetClip(clip);
 }
 
 
 void TDrawContext::Initialize(TDrawable* drawable)
 {
 	int screen = gApplication->GetDefaultScreen();
-	XGCValues	gcv;
-	memset(&gcv, 0, sizeof(gcv));
 
 	Drawable Xdrawable =  fDrawable->GetDrawable();
 	ASSERT(Xdrawable);
-	fGC = XCreateGC(sDisplay, Xdrawable, 0, &gcv);
-	XSetForeground(sDisplay, fGC, WhitePixel(sDisplay, screen));
-	XSetBackground(sDisplay, fGC, BlackPixel(sDisplay, screen));
+	fGCState = AcquireGC(Xdrawable, drawable->GetDepth());
+	fGC = fGCState->gc;
+
+	// a GC from the pool may have been left in any of these states
+	SetFunction(GXcopy);
+	SetFillStyle(FillSolid);
+	if (fGCState->subwindowMode != ClipByChildren)
+		ClipSubWindows(true);
+
+	SetForeground(WhitePixel(sDisplay, screen));
+	SetBackground(BlackPixel(sDisplay, screen));
 
 	SetFont(sDefaultFont);
 
@@ -78,8 +114,145 @@ void TDrawContext::Initialize(TDrawable* drawable)
 	
 TDrawContext::~TDrawContext()
 {
-	if (fGC)
-		XFreeGC(gApplication->GetDisplay(), fGC);
+	if (fBatching)
+		FlushBatch();
+
+	delete fBatchFills;
+	delete fBatchTexts;
+	free(fBatchChars);
+
+#ifdef HAVE_XRENDER
+	if (fPicture)
+		XRenderFreePicture(sDisplay, fPicture);
+#endif
+
+	if (fGCState)
+		ReleaseGC(fGCState);
+}
+
+
+TGCState* TDrawContext::AcquireGC(Drawable drawable, int depth)
+{
+	// a GC can be used with any drawable of the same depth
+	TGCState* previous = NULL;
+
+	for (TGCState* state = sFreeGCs; state; state = state->next)
+	{
+		if (state->depth == depth)
+		{
+			if (previous)
+				previous->next = state->next;
+			else
+				sFreeGCs = state->next;
+
+			sFreeGCCount--;
+			state->next = NULL;
+			return state;
+		}
+
+		previous = state;
+	}
+
+	XGCValues	gcv;
+	memset(&gcv, 0, sizeof(gcv));
+
+	// start with the X defaults for a new GC
+	TGCState* state = new TGCState;
+	state->gc = XCreateGC(sDisplay, drawable, 0, &gcv);
+	state->depth = depth;
+	state->foreground = 0;
+	state->background = 1;
+	state->function = GXcopy;
+	state->fillStyle = FillSolid;
+	state->subwindowMode = ClipByChildren;
+	state->clip = NULL;
+	state->next = NULL;
+
+	return state;
+}
+
+
+void TDrawContext::ReleaseGC(TGCState* state)
+{
+	// depth is unknown for some drawables, so don't share those
+	if (state->depth == 0 || sFreeGCCount >= kMaxFreeGCs)
+	{
+		if (state->clip)
+			XDestroyRegion(state->clip);
+		XFreeGC(sDisplay, state->gc);
+		delete state;
+	}
+	else
+	{
+		state->next = sFreeGCs;
+		sFreeGCs = state;
+		sFreeGCCount++;
+	}
+}
+
+
+void TDrawContext::SetForeground(unsigned long pixel)
+{
+	if (fGCState->foreground != pixel)
+	{
+		XSetForeground(sDisplay, fGC, pixel);
+		fGCState->foreground = pixel;
+	}
+}
+
+
+void TDrawContext::SetBackground(unsigned long pixel)
+{
+	if (fGCState->background != pixel)
+	{
+		XSetBackground(sDisplay, fGC, pixel);
+		fGCState->background = pixel;
+	}
+}
+
+
+void TDrawContext::SetFunction(int function)
+{
+	if (fGCState->function != function)
+	{
+		XSetFunction(sDisplay, fGC, function);
+		fGCState->function = function;
+	}
+}
+
+
+void TDrawContext::SetFillStyle(int fillStyle)
+{
+	if (fGCState->fillStyle != fillStyle)
+	{
+		XSetFillStyle(sDisplay, fGC, fillStyle);
+		fGCState->fillStyle = fillStyle;
+	}
+}
+
+
+void TDrawContext::SetClip(TRegion* clip)
+{
+	Region& current = fGCState->clip;
+
+	if (clip)
+	{
+		if (current && XEqualRegion(current, clip->GetRegion()))
+			return;
+
+		XSetRegion(sDisplay, fGC, clip->GetRegion());
+
+		// keep our own copy to compare against the next time
+		if (!current)
+			current = XCreateRegion();
+		XUnionRegion(clip->GetRegion(), clip->GetRegion(), current);
+	}
+	else if (current)
+	{
+		XSetClipMask(sDisplay, fGC, None);
+		XDestroyRegion(current);
+		current = NULL;
+	}
 }
 	
 
@@ -90,6 +263,8 @@ void TDrawContext::DrawText(const TChar* text, int length, bool movePen)
 
 	const TChar* start = text;
 	TCoord leftOffset = 0;
+	TCoord h = fPen.h - fScroll.h;
+	TCoord v = fPen.v - fScroll.v;
 	
 	// avoid invalid characters
 	while (length > 0)
@@ -102,8 +277,7 @@ void TDrawContext::DrawText(const TChar* text, int length, bool movePen)
 		}
 		else
 		{
-			XmbDrawImageString(sDisplay, fDrawable->GetDrawable(), fFont->GetFontSet(), fGC, fPen.h - fScroll.h + leftOffset, fPen.v - fScroll.v, (const char *)start, text - start);
-			leftOffset += XmbTextExtents(fFont->GetFontSet(), (const char *)start, text - start, NULL, NULL);
+			leftOffset += DrawTextSegment(h + leftOffset, v, (const char *)start, text - start, true);
 			leftOffset += XmbTextExtents(fFont->GetFontSet(), " ", 1, NULL, NULL);
 			text += 1;
 			start = text;
@@ -112,16 +286,145 @@ void TDrawContext::DrawText(const TChar* text, int length, bool movePen)
 	}
 	
 	if (text > start)
+		leftOffset += DrawTextSegment(h + leftOffset, v, (const char *)start, text - start, movePen);
+
+	if (movePen)
+		fPen.h += leftOffset;
+}
+
+
+// draws text with its background at h, v in drawable coordinates, and returns its width if measure is true
+TCoord TDrawContext::DrawTextSegment(TCoord h, TCoord v, const char* text, int length, bool measure)
+{
+	XFontSet fontSet = fFont->GetFontSet();
+
+	if (!CanBatch() && !CanRender())
+	{
+		if (fBatching)
+			FlushBatch();
+
+		XmbDrawImageString(sDisplay, fDrawable->GetDrawable(), fontSet, fGC, h, v, text, length);
+		return (measure ? XmbTextExtents(fontSet, text, length, NULL, NULL) : 0);
+	}
+
+	if (length <= 0)
+		return 0;
+
+	// the background is the same one XmbDrawImageString would fill
+	XRectangle	logical;
+	TBatchText	batchText;
+	batchText.width = XmbTextExtents(fontSet, text, length, NULL, &logical);
+	batchText.h = h;
+	batchText.v = v;
+	batchText.text = text;
+	batchText.length = length;
+	batchText.font = fFont;
+	batchText.pixel = fForeColor.GetPixel();
+	batchText.color = fForeColor;
+
+	TBatchFill	fill;
+	fill.rect.x = h + logical.x;
+	fill.rect.y = v + logical.y;
+	fill.rect.width = logical.width;
+	fill.rect.height = logical.height;
+	fill.pixel = fBackColor.GetPixel();
+
+	if (CanBatch())
 	{
-		XmbDrawImageString(sDisplay, fDrawable->GetDrawable(), fFont->GetFontSet(), fGC, fPen.h - fScroll.h + leftOffset, fPen.v - fScroll.v, (const char *)start, text - start);
-		if (movePen)
+		if (fBatchCharsLength + length > fBatchCharsSize)
 		{
-			leftOffset += XmbTextExtents(fFont->GetFontSet(), (const char *)start, text - start, NULL, NULL);
+			fBatchCharsSize = (fBatchCharsLength + length) * 2 + 4096;
+			fBatchChars = (char *)realloc(fBatchChars, fBatchCharsSize);
+			ASSERT(fBatchChars);
 		}
+
+		memcpy(fBatchChars + fBatchCharsLength, text, length);
+		batchText.textOffset = fBatchCharsLength;
+		fBatchCharsLength += length;
+
+		if (fill.rect.width > 0)
+			fBatchFills->InsertLast(fill);
+		fBatchTexts->InsertLast(batchText);
 	}
+	else
+	{
+		SetForeground(fill.pixel);
+		XFillRectangle(sDisplay, fDrawable->GetDrawable(), fGC, fill.rect.x, fill.rect.y, fill.rect.width, fill.rect.height);
+		SetForeground(batchText.pixel);
 
-	if (movePen)
-		fPen.h += leftOffset;
+		if (!RenderText(&batchText, 1))
+			XmbDrawString(sDisplay, fDrawable->GetDrawable(), fontSet, fGC, h, v, text, length);
+	}
+
+	return batchText.width;
+}
+
+
+bool TDrawContext::CanRender() const
+{
+#ifdef HAVE_XRENDER
+	return (sRenderFormat && fDrawable->GetDepth() == sRenderDepth && fGCState->function == GXcopy);
+#else
+	return false;
+#endif
+}
+
+
+// draws runs on one baseline in a single XRenderCompositeText8 request.
+// returns false if they have to be drawn with the core font instead.
+bool TDrawContext::RenderText(const TBatchText* texts, int count)
+{
+#ifdef HAVE_XRENDER
+	if (!CanRender())
+		return false;
+
+	XGlyphElt8* elts = (XGlyphElt8 *)malloc(count * sizeof(XGlyphElt8));
+	ASSERT(elts);
+
+	TCoord h = texts[0].h;
+
+	for (int i = 0; i < count; i++)
+	{
+		XID glyphSet;
+
+		if (!texts[i].font->GetGlyphSet(texts[i].text, texts[i].length, glyphSet))
+		{
+			free(elts);
+			return false;
+		}
+
+		elts[i].glyphset = glyphSet;
+		elts[i].chars = (char *)texts[i].text;
+		elts[i].nchars = texts[i].length;
+		elts[i].xOff = texts[i].h - h;
+		elts[i].yOff = 0;
+
+		h = texts[i].h + texts[i].width;
+	}
+
+	if (!fPicture)
+	{
+		fPicture = XRenderCreatePicture(sDisplay, fDrawable->GetDrawable(), sRenderFormat, 0, NULL);
+		if (fGCState->clip)
+			XRenderSetPictureClipRegion(sDisplay, fPicture, fGCState->clip);
+	}
+
+	const TColor& color = texts[0].color;
+	XRenderColor renderColor;
+	renderColor.red = color.Red() * 257;
+	renderColor.green = color.Green() * 257;
+	renderColor.blue = color.Blue() * 257;
+	renderColor.alpha = 0xFFFF;
+
+	Picture source = XRenderCreateSolidFill(sDisplay, &renderColor);
+	XRenderCompositeText8(sDisplay, PictOpOver, source, fPicture, NULL, 0, 0, texts[0].h, texts[0].v, elts, count);
+	XRenderFreePicture(sDisplay, source);
+
+	free(elts);
+	return true;
+#else
+	return false;
+#endif
 }
 
 
@@ -157,8 +460,7 @@ void TDrawContext::DrawTextBox(const TChar* text, int length, const TRect& box,
 				}
 				else
 				{
-					XmbDrawImageString(sDisplay, fDrawable->GetDrawable(), fFont->GetFontSet(), fGC, h - fScroll.h + leftOffset, v + ascent - fScroll.v, (const char *)start, text - start);
-					leftOffset += XmbTextExtents(fFont->GetFontSet(), (const char *)start, text - start, NULL, NULL);
+					leftOffset += DrawTextSegment(h - fScroll.h + leftOffset, v + ascent - fScroll.v, (const char *)start, text - start, true);
 					leftOffset += XmbTextExtents(fFont->GetFontSet(), " ", 1, NULL, NULL);
 					text += 1;
 					start = text;
@@ -167,9 +469,7 @@ void TDrawContext::DrawTextBox(const TChar* text, int length, const TRect& box,
 			}
 			
 			if (text > start)
-			{
-				XmbDrawImageString(sDisplay, fDrawable->GetDrawable(), fFont->GetFontSet(), fGC, h - fScroll.h + leftOffset, v + ascent - fScroll.v, (const char *)start, text - start);
-			}
+				DrawTextSegment(h - fScroll.h + leftOffset, v + ascent - fScroll.v, (const char *)start, text - start, false);
 		}
 		
 		// paint border
@@ -219,14 +519,32 @@ TCoord TDrawContext::MeasureText(const TChar* text, int length, TCoord& ascent,
 void TDrawContext::PaintRect(const TRect& r)
 {
 	if (!r.IsEmpty())
-		XFillRectangle(sDisplay, fDrawable->GetDrawable(), fGC, r.left - fScroll.h, r.top - fScroll.v, r.GetWidth(), r.GetHeight());
+	{
+		if (CanBatch())
+			AddBatchFill(r, fForeColor.GetPixel());
+		else
+		{
+			if (fBatching)
+				FlushBatch();
+
+			XFillRectangle(sDisplay, fDrawable->GetDrawable(), fGC, r.left - fScroll.h, r.top - fScroll.v, r.GetWidth(), r.GetHeight());
+		}
+	}
 }
 
 
 void TDrawContext::EraseRect(const TRect& r)
 {
-	if (!r.IsEmpty())
+	if (r.IsEmpty())
+		return;
+
+	if (CanBatch())
+		AddBatchFill(r, fBackColor.GetPixel());
+	else
 	{
+		if (fBatching)
+			FlushBatch();
+
 		TColor savedColor = fForeColor;
 		SetForeColor(fBackColor);
 		XFillRectangle(sDisplay, fDrawable->GetDrawable(), fGC, r.left - fScroll.h, r.top - fScroll.v, r.GetWidth(), r.GetHeight());
@@ -237,6 +555,9 @@ void TDrawContext::EraseRect(const TRect& r)
 
 void TDrawContext::FrameRect(const TRect& r)
 {
+	if (fBatching)
+		FlushBatch();
+
 	if (!r.IsEmpty())
 		XDrawRectangle(sDisplay, fDrawable->GetDrawable(), fGC, r.left - fScroll.h, r.top - fScroll.v, r.GetWidth(), r.GetHeight());
 }
@@ -244,17 +565,23 @@ void TDrawContext::FrameRect(const TRect& r)
 
 void TDrawContext::InvertRect(const TRect& r)
 {
+	if (fBatching)
+		FlushBatch();
+
 	if (!r.IsEmpty())
 	{
-		XSetFunction(sDisplay, fGC, GXinvert);		
+		SetFunction(GXinvert);		
 		XFillRectangle(sDisplay, fDrawable->GetDrawable(), fGC, r.left - fScroll.h, r.top - fScroll.v, r.GetWidth(), r.GetHeight());
-		XSetFunction(sDisplay, fGC, fPenMode);
+		SetFunction(fPenMode);
 	}		
 }
 
 
 void TDrawContext::CopyRect(const TDrawable* src, const TRect& srcRect, const TPoint& dest, bool applyScroll)
 {
+	if (fBatching)
+		FlushBatch();
+
 	if (!srcRect.IsEmpty())
 	{
 		if (applyScroll)
@@ -277,6 +604,9 @@ void TDrawContext::CopyRect(const TDrawable* src, const TRect& srcRect, const TP
 
 void TDrawContext::DrawPixmap(const TPixmap* pixmap, const TPoint& dest)
 {
+	if (fBatching)
+		FlushBatch();
+
 	const TRect& srcRect = pixmap->GetBounds();
 
 	if (!srcRect.IsEmpty())
@@ -292,12 +622,23 @@ void TDrawContext::DrawPixmap(const TPixmap* pixmap, const TPoint& dest)
 					srcRect.GetWidth(), srcRect.GetHeight(),
 					h, v);
 		XSetClipMask(sDisplay, fGC, None);
+		XSetClipOrigin(sDisplay, fGC, 0, 0);
+
+		// the mask replaced any clip region we had
+		if (fGCState->clip)
+		{
+			XDestroyRegion(fGCState->clip);
+			fGCState->clip = NULL;
+		}
 	}
 }
 
 
 void TDrawContext::DrawImage(const TImage* image, const TPoint& dest)
 {
+	if (fBatching)
+		FlushBatch();
+
 	TCoord h = dest.h - fScroll.h;
 	TCoord v = dest.v - fScroll.v;
 
@@ -312,6 +653,9 @@ void TDrawContext::DrawImage(const TImage* image, const TPoint& dest)
 
 void TDrawContext::DrawLine(TCoord h1, TCoord v1, TCoord h2, TCoord v2)
 {
+	if (fBatching)
+		FlushBatch();
+
 	XDrawLine(sDisplay, fDrawable->GetDrawable(), fGC, h1 - fScroll.h, v1 - fScroll.v, h2 - fScroll.h, v2 - fScroll.v);
 }
 
@@ -320,7 +664,7 @@ void TDrawContext::SetForeColor(TColor& color)
 {
 	fForeColor = color;
 	
-	XSetForeground(sDisplay, fGC, color.GetPixel());
+	SetForeground(color.GetPixel());
 }
 
 
@@ -328,20 +672,26 @@ void TDrawContext::SetBackColor(TColor& color)
 {
 	fBackColor = color;
 	
-	XSetBackground(sDisplay, fGC, color.GetPixel());
+	SetBackground(color.GetPixel());
 }
 
 
 void TDrawContext::SetTile(TPixmap* tile)
 {
-	XSetFillStyle(sDisplay, fGC, (tile ? FillTiled : FillSolid));
+	if (fBatching)
+		FlushBatch();
+
+	SetFillStyle(tile ? FillTiled : FillSolid);
 	XSetTile(sDisplay, fGC, (tile ? tile->GetPixmap() : None));
 }
 
 
 void TDrawContext::SetStipple(TPixmap* stipple)
 {
-	XSetFillStyle(sDisplay, fGC, (stipple ? FillOpaqueStippled : FillSolid));
+	if (fBatching)
+		FlushBatch();
+
+	SetFillStyle(stipple ? FillOpaqueStippled : FillSolid);
 	XSetStipple(sDisplay, fGC, (stipple ? stipple->GetPixmap() : None));
 }
 
@@ -349,6 +699,10 @@ void TDrawContext::SetStipple(TPixmap* stipple)
 void TDrawContext::SetFont(TFont* font)
 {
 	ASSERT(font);
+
+	// batched text refers to the font
+	if (fBatching && font != fFont)
+		FlushBatch();
 	
 	if (fFont)
 		fFont->RemoveRef();
@@ -361,23 +715,387 @@ void TDrawContext::SetFont(TFont* font)
 
 void TDrawContext::SetPenMode(TPenMode penMode)
 {
+	if (fBatching)
+		FlushBatch();
+
 	fPenMode = penMode;
-	XSetFunction(sDisplay, fGC, penMode);
+	SetFunction(penMode);
 }
 
 
 void TDrawContext::ClipSubWindows(bool clip)
 {
+	if (fBatching)
+		FlushBatch();
+
 	XGCValues	values;
 
 	values.subwindow_mode = (clip ? ClipByChildren : IncludeInferiors);
 	XChangeGC(sDisplay, fGC, GCSubwindowMode, &values);
+	fGCState->subwindowMode = values.subwindow_mode;
+}
+
+
+void TDrawContext::BeginBatch()
+{
+	if (!fBatchFills)
+	{
+		fBatchFills = new TDynamicArray<TBatchFill>(256);
+		fBatchTexts = new TDynamicArray<TBatchText>(256);
+	}
+
+	fBatching = true;
+}
+
+
+void TDrawContext::EndBatch()
+{
+	if (fBatching)
+	{
+		FlushBatch();
+		fBatching = false;
+	}
+}
+
+
+void TDrawContext::AddBatchFill(const TRect& r, unsigned long pixel)
+{
+	TCoord left = r.left - fScroll.h;
+	TCoord top = r.top - fScroll.v;
+
+	// extend the previous fill if this one continues it, as tabs and backgrounds along a line do
+	uint32 count = fBatchFills->GetSize();
+	if (count > 0)
+	{
+		XRectangle& last = fBatchFills->Last().rect;
+
+		if (fBatchFills->Last().pixel == pixel && last.y == top && last.height == r.GetHeight() && last.x + last.width == left)
+		{
+			last.width += r.GetWidth();
+			return;
+		}
+	}
+
+	TBatchFill	fill;
+	fill.rect.x = left;
+	fill.rect.y = top;
+	fill.rect.width = r.GetWidth();
+	fill.rect.height = r.GetHeight();
+	fill.pixel = pixel;
+	fBatchFills->InsertLast(fill);
+}
+
+
+static int CompareBatchTexts(const void* item1, const void* item2)
+{
+	const TBatchText* text1 = (const TBatchText *)item1;
+	const TBatchText* text2 = (const TBatchText *)item2;
+
+	if (text1->pixel != text2->pixel)
+		return (text1->pixel < text2->pixel ? -1 : 1);
+	if (text1->font != text2->font)
+		return (text1->font < text2->font ? -1 : 1);
+	if (text1->v != text2->v)
+		return text1->v - text2->v;
+	return text1->h - text2->h;
+}
+
+
+// all the fills are drawn before any of the text, so a fill must not cover text drawn earlier in the batch
+void TDrawContext::FlushBatch()
+{
+	ASSERT(fBatching);
+	Drawable drawable = fDrawable->GetDrawable();
+
+	// the copy of the text is done growing now
+	for (uint32 i = 0; i < fBatchTexts->GetSize(); i++)
+	{
+		TBatchText& text = (*fBatchTexts)[i];
+		text.text = fBatchChars + text.textOffset;
+	}
+
+	if (RasterizeBatch())
+	{
+		fBatchCharsLength = 0;
+		return;
+	}
+
+	uint32 count = fBatchFills->GetSize();
+	if (count > 0)
+	{
+		TBatchFill* fills = &(*fBatchFills)[0];
+
+		XRectangle* rects = (XRectangle *)malloc(count * sizeof(XRectangle));
+		ASSERT(rects);
+
+		// fills may overlap, so keep them in order and only group consecutive ones of the same color
+		uint32 i = 0;
+		while (i < count)
+		{
+			unsigned long pixel = fills[i].pixel;
+			int rectCount = 0;
+
+			while (i < count && fills[i].pixel == pixel)
+				rects[rectCount++] = fills[i++].rect;
+
+			SetForeground(pixel);
+			XFillRectangles(sDisplay, drawable, fGC, rects, rectCount);
+		}
+
+		free(rects);
+		fBatchFills->RemoveAll();
+	}
+
+	count = fBatchTexts->GetSize();
+	if (count > 0)
+	{
+		TBatchText* texts = &(*fBatchTexts)[0];
+		qsort(texts, count, sizeof(TBatchText), CompareBatchTexts);
+
+		XmbTextItem* items = (XmbTextItem *)malloc(count * sizeof(XmbTextItem));
+		ASSERT(items);
+
+		uint32 i = 0;
+		while (i < count)
+		{
+			const TBatchText& first = texts[i];
+			TCoord h = first.h;
+			int itemCount = 0;
+
+			// all runs of one color on one baseline go in a single request
+			while (i < count && texts[i].pixel == first.pixel && texts[i].font == first.font && texts[i].v == first.v)
+			{
+				XmbTextItem& item = items[itemCount++];
+				item.chars = (char *)texts[i].text;
+				item.nchars = texts[i].length;
+				item.delta = texts[i].h - h;
+				item.font_set = (itemCount == 1 ? first.font->GetFontSet() : NULL);
+
+				h = texts[i].h + texts[i].width;
+				i++;
+			}
+
+			SetForeground(first.pixel);
+			if (!RenderText(&first, itemCount))
+				XmbDrawText(sDisplay, drawable, fGC, first.h, first.v, items, itemCount);
+		}
+
+		free(items);
+		fBatchTexts->RemoveAll();
+	}
+
+	fBatchCharsLength = 0;
+
+	SetForeground(fForeColor.GetPixel());
+}
+
+
+// draws the batch into an image on the client and sends it with one XShmPutImage.
+// returns false if the batch is too small to be worth it or can't be drawn this way.
+bool TDrawContext::RasterizeBatch()
+{
+	uint32 fillCount = fBatchFills->GetSize();
+	uint32 textCount = fBatchTexts->GetSize();
+
+	if (sRasterDepth == 0 || fDrawable->GetDepth() != sRasterDepth || fillCount == 0)
+		return false;
+
+	TBatchFill* fills = &(*fBatchFills)[0];
+	TBatchText* texts = (textCount > 0 ? &(*fBatchTexts)[0] : NULL);
+
+	// the text is drawn over the fills, so they bound the whole batch
+	int left = fills[0].rect.x;
+	int top = fills[0].rect.y;
+	int right = left + fills[0].rect.width;
+	int bottom = top + fills[0].rect.height;
+	uint32 i;
+
+	for (i = 1; i < fillCount; i++)
+	{
+		const XRectangle& r = fills[i].rect;
+
+		if (r.x < left)
+			left = r.x;
+		if (r.y < top)
+			top = r.y;
+		if (r.x + r.width > right)
+			right = r.x + r.width;
+		if (r.y + r.height > bottom)
+			bottom = r.y + r.height;
+	}
+
+	// fills can run past the edges, along long lines for example
+	if (left < 0)
+		left = 0;
+	if (top < 0)
+		top = 0;
+	if (right > fDrawable->GetWidth())
+		right = fDrawable->GetWidth();
+	if (bottom > fDrawable->GetHeight())
+		bottom = fDrawable->GetHeight();
+
+	int width = right - left;
+	int height = bottom - top;
+
+	if (width <= 0 || height <= 0 || width * height < kMinRasterArea)
+		return false;
+
+	// every glyph must be available on the client
+	for (i = 0; i < textCount; i++)
+	{
+		for (int j = 0; j < texts[i].length; j++)
+		{
+			if (!texts[i].font->GetGlyphBitmap(texts[i].text[j]))
+				return false;
+		}
+	}
+
+	if (!sRasterImage || sRasterImage->GetWidth() < width || sRasterImage->GetHeight() < height)
+	{
+		TCoord imageWidth = (sRasterImage && sRasterImage->GetWidth() > width ? sRasterImage->GetWidth() : width);
+		TCoord imageHeight = (sRasterImage && sRasterImage->GetHeight() > height ? sRasterImage->GetHeight() : height);
+
+		if (sRasterImagePending)
+			XSync(sDisplay, false);
+		delete sRasterImage;
+
+		sRasterImage = new TImage(imageWidth, imageHeight);
+		sRasterImagePending = false;
+	}
+	else if (sRasterImagePending)
+	{
+		// the server may still be reading the last image out of shared memory
+		XSync(sDisplay, false);
+		sRasterImagePending = false;
+	}
+
+	char* buffer = sRasterImage->GetBuffer();
+	int rowBytes = sRasterImage->GetRowBytes();
+
+	for (i = 0; i < fillCount; i++)
+	{
+		const XRectangle& r = fills[i].rect;
+		unsigned int pixel = fills[i].pixel;
+
+		int fillLeft = (r.x > left ? r.x : left) - left;
+		int fillRight = (r.x + r.width < right ? r.x + r.width : right) - left;
+		int fillTop = (r.y > top ? r.y : top) - top;
+		int fillBottom = (r.y + r.height < bottom ? r.y + r.height : bottom) - top;
+
+		for (int v = fillTop; v < fillBottom; v++)
+		{
+			unsigned int* pixels = (unsigned int *)(buffer + v * rowBytes);
+			
+			for (int h = fillLeft; h < fillRight; h++)
+				pixels[h] = pixel;
+		}
+	}
+
+	for (i = 0; i < textCount; i++)
+	{
+		const TBatchText& text = texts[i];
+		unsigned int pixel = text.pixel;
+		int pen = text.h - left;
+
+		for (int j = 0; j < text.length; j++)
+		{
+			const TGlyphBitmap* glyph = text.font->GetGlyphBitmap(text.text[j]);
+			int glyphLeft = pen - glyph->x;
+			int glyphTop = text.v - top - glyph->y;
+
+			for (int v = 0; v < glyph->height; v++)
+			{
+				int y = glyphTop + v;
+				if (y < 0 || y >= height)
+					continue;
+
+				const unsigned char* alpha = glyph->alpha + v * glyph->width;
+				unsigned int* pixels = (unsigned int *)(buffer + y * rowBytes);
+
+				for (int h = 0; h < glyph->width; h++)
+				{
+					int x = glyphLeft + h;
+					if (alpha[h] && x >= 0 && x < width)
+						pixels[x] = pixel;
+				}
+			}
+
+			pen += glyph->advance;
+		}
+	}
+
+	// only put what the batch covers, within our clip
+	Region covered = XCreateRegion();
+	for (i = 0; i < fillCount; i++)
+		XUnionRectWithRegion(&fills[i].rect, covered, covered);
+	if (fGCState->clip)
+		XIntersectRegion(covered, fGCState->clip, covered);
+
+	XSetRegion(sDisplay, fGC, covered);
+
+#ifdef HAVE_XSHM
+	if (sRasterImage->UsingSharedMemory())
+	{
+		XShmPutImage(sDisplay, fDrawable->GetDrawable(), fGC, sRasterImage->GetImage(), 0, 0, left, top, width, height, false);
+		sRasterImagePending = true;
+	}
+	else
+#endif
+		XPutImage(sDisplay, fDrawable->GetDrawable(), fGC, sRasterImage->GetImage(), 0, 0, left, top, width, height);
+
+	if (fGCState->clip)
+		XSetRegion(sDisplay, fGC, fGCState->clip);
+	else
+		XSetClipMask(sDisplay, fGC, None);
+
+	XDestroyRegion(covered);
+
+	fBatchFills->RemoveAll();
+	fBatchTexts->RemoveAll();
+
+	return true;
 }
 
 
 void TDrawContext::Initialize(Display* display)
 {
 	sDisplay = display;
+
+#ifdef HAVE_XRENDER
+	int eventBase, errorBase;
+	int major = 0, minor = 0;
+
+	// solid fill source pictures need RENDER 0.10
+	if (XRenderQueryExtension(display, &eventBase, &errorBase) && XRenderQueryVersion(display, &major, &minor) && 
+		(major > 0 || minor >= 10))
+	{
+		int screen = DefaultScreen(display);
+		sRenderFormat = XRenderFindVisualFormat(display, DefaultVisual(display, screen));
+		sRenderDepth = DefaultDepth(display, screen);
+	}
+#endif
+
+	// client side drawing writes 32 bit TrueColor pixels, as unsigned ints in our own byte order
+	int screen = DefaultScreen(display);
+	int depth = DefaultDepth(display, screen);
+	int bitsPerPixel = 0;
+	int formatCount = 0;
+	XPixmapFormatValues* formats = XListPixmapFormats(display, &formatCount);
+
+	for (int i = 0; i < formatCount; i++)
+	{
+		if (formats[i].depth == depth)
+			bitsPerPixel = formats[i].bits_per_pixel;
+	}
+	if (formats)
+		XFree(formats);
+
+	int one = 1;
+	int byteOrder = (*(char *)&one ? LSBFirst : MSBFirst);
+
+	if (DefaultVisual(display, screen)->c_class == TrueColor && bitsPerPixel == 32 && ImageByteOrder(display) == byteOrder)
+		sRasterDepth = depth;
+
 	sDefaultFont = new TFont(_("-*-*-bold-r-normal-*-13-*-*-*-*-*-*-*"));
 	sDefaultFont->AddRef();
 }
@@ -23,8 +23,10 @@
 #include "TGeometry.h"
 #include "TColor.h"
 #include "TPixmap.h"
+#include "TDynamicArray.h"
 
 #include <X11/Xlib.h>
+#include <X11/Xutil.h>
 
 class TColor;
 class TImage;
@@ -48,6 +50,40 @@ enum TTextAlign
 	kTextAlignRight
 };
 
+// a pooled GC and the state we last set in it, so redundant requests can be skipped
+struct TGCState
+{
+	GC						gc;
+	int						depth;
+	unsigned long			foreground;
+	unsigned long			background;
+	int						function;
+	int						fillStyle;
+	int						subwindowMode;
+	Region					clip;					// NULL for no clipping
+	TGCState*				next;					// next free GC in the pool
+};
+
+// a fill or a run of text waiting in a batch, in drawable coordinates
+struct TBatchFill
+{
+	XRectangle				rect;
+	unsigned long			pixel;
+};
+
+struct TBatchText
+{
+	TCoord					h;
+	TCoord					v;
+	const char*				text;					// set from textOffset when the batch is flushed
+	uint32					textOffset;				// in the batch's copy of the text
+	int						length;
+	TCoord					width;
+	TFont*					font;
+	unsigned long			pixel;
+	TColor					color;
+};
+
 class TDrawContext
 {
 public:
@@ -69,6 +105,12 @@ public:
 	void					DrawImage(const TImage* image, const TPoint& dest);
 
 	void					DrawLine(TCoord h1, TCoord y1, TCoord h2, TCoord y2);
+
+	// while batching, text and solid fills are collected and sent grouped by color when the batch is flushed.
+	// text passed to DrawText must stay valid until then.
+	void					BeginBatch();
+	void					EndBatch();
+	void					FlushBatch();
 	
 	inline GC				GetGC() const { return fGC; }
 
@@ -104,8 +146,25 @@ public:
 protected:
 	void					Initialize(TDrawable* drawable);		
 
+	void					SetForeground(unsigned long pixel);
+	void					SetBackground(unsigned long pixel);
+	void					SetFunction(int function);
+	void					SetFillStyle(int fillStyle);
+	void					SetClip(TRegion* clip);
+
+	TCoord					DrawTextSegment(TCoord h, TCoord v, const char* text, int length, bool measure);
+	void					AddBatchFill(const TRect& r, unsigned long pixel);
+	inline bool				CanBatch() const { return (fBatching && fGCState->function == GXcopy && fGCState->fillStyle == FillSolid); }
+	bool					CanRender() const;
+	bool					RenderText(const TBatchText* texts, int count);
+	bool					RasterizeBatch();
+
+	static TGCState*		AcquireGC(Drawable drawable, int depth);
+	static void				ReleaseGC(TGCState* state);
+
 protected:
 	GC						fGC;
+	TGCState*				fGCState;
 	TDrawable*				fDrawable;
 	TPoint					fPen;
 	const TPoint&			fScroll;
@@ -113,9 +172,20 @@ protected:
 	TFont*					fFont;
 	TColor					fForeColor;
 	TColor					fBackColor;
+	bool					fBatching;
+	TDynamicArray<TBatchFill>*	fBatchFills;
+	TDynamicArray<TBatchText>*	fBatchTexts;
+	char*					fBatchChars;			// the text is copied, as callers may draw from temporary strings
+	uint32					fBatchCharsLength;
+	uint32					fBatchCharsSize;
+#ifdef HAVE_XRENDER
+	XID						fPicture;				// XRender picture for the drawable, created on first use
+#endif
 
 	static Display*			sDisplay;
 	static TFont*			sDefaultFont;
+	static TGCState*		sFreeGCs;
+	static int				sFreeGCCount;
 };
 
 #endif // __TDrawContext__
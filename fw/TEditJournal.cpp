@@ -0,0 +1,356 @@
+// ========================================================================================
+//	TEditJournal.cpp			   Copyright (C) 2001-2009 Mike Voydanoff. All rights reserved.
+// ========================================================================================
+/*
+	This program is free software; you can redistribute it and/or
+	modify it under the terms of the GNU General Public License
+	as published by the Free Software Foundation; either version 2
+	of the License, or (at your option) any later version.
+	
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+	
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "FWCommon.h"
+
+#include "TEditJournal.h"
+#include "TException.h"
+#include "TApplication.h"
+
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+const char		kJournalMagic[4] = { 'Z', 'J', 'N', 'L' };
+const uint32	kJournalVersion = 1;
+const TTime		kJournalWriteTime = 1000;
+const TTime		kJournalSyncTime = 10000;
+const uint32	kMaxBufferedJournal = 64 * 1024;		// write out early if this much is pending
+const uint32	kMaxUnsyncedJournal = 1024 * 1024;		// sync early if this much is written
+
+struct JournalHeader
+{
+	char		magic[4];
+	uint32		version;
+	uint32		baseSize;				// size of the file the edits apply to
+	TFileTime	baseModification;		// and its modification time
+};
+
+struct JournalRecord
+{
+	uint32		offset;
+	uint32		deleteLength;
+	uint32		insertLength;			// followed by insertLength characters
+};
+
+
+TEditJournal::TEditJournal(const TFile& file)
+	:	fFile(file),
+		fBaseSize(0),
+		fBaseModification(0),
+		fBuffer(NULL),
+		fBufferLength(0),
+		fBufferSize(0),
+		fNeedsSync(false),
+		fLastSyncTime(0),
+		fUnsyncedLength(0),
+		fFailed(false)
+{
+	GetJournalFile(fFile, fJournal);
+	SetIdleFrequency(kJournalWriteTime);
+}
+
+
+TEditJournal::~TEditJournal()
+{
+	if (fJournal.IsOpen())
+		Flush(true);
+
+	fJournal.Close();
+	free(fBuffer);
+}
+
+
+void TEditJournal::Begin()
+{
+	// any old journal no longer applies
+	Discard();
+
+	GetFileStamp(fFile, fBaseSize, fBaseModification);
+	fFailed = false;
+}
+
+
+void TEditJournal::Continue()
+{
+	fJournal.Close();
+	fBufferLength = 0;
+	fFailed = false;
+
+	try
+	{
+		fJournal.Open(false, false, false);
+		fJournal.SetPosition(fJournal.GetFileSize());
+	}
+	catch (TSystemError* error)
+	{
+		delete error;
+		Begin();
+	}
+}
+
+
+void TEditJournal::Discard()
+{
+	EnableIdling(false);
+	fJournal.Close();
+	fBufferLength = 0;
+	fNeedsSync = false;
+
+	unlink(fJournal.GetPath());
+}
+
+
+void TEditJournal::OpenJournal()
+{
+	JournalHeader header;
+	memcpy(header.magic, kJournalMagic, sizeof(header.magic));
+	header.version = kJournalVersion;
+	header.baseSize = fBaseSize;
+	header.baseModification = fBaseModification;
+
+	try
+	{
+		fJournal.Open(false, true, true);
+		fJournal.Write(&header, sizeof(header));
+		fLastSyncTime = gApplication->GetCurrentTime();
+		fUnsyncedLength = 0;
+	}
+	catch (TSystemError* error)
+	{
+		// journaling is best effort, editing continues without it
+		delete error;
+		fJournal.Close();
+		fFailed = true;
+	}
+}
+
+
+void TEditJournal::RecordEdit(STextOffset offset, STextOffset deleteLength, const TChar* text, STextOffset length)
+{
+	if (fFailed)
+		return;
+
+	// the journal file is not created until there is something to put in it
+	if (!fJournal.IsOpen())
+	{
+		OpenJournal();
+		if (fFailed)
+			return;
+	}
+
+	uint32 recordLength = sizeof(JournalRecord) + length * sizeof(TChar);
+
+	if (fBufferLength + recordLength > fBufferSize)
+	{
+		fBufferSize = fBufferLength + recordLength + 4096;
+		fBuffer = (char *)realloc(fBuffer, fBufferSize);
+		ASSERT(fBuffer);
+	}
+
+	JournalRecord record;
+	record.offset = offset;
+	record.deleteLength = deleteLength;
+	record.insertLength = length;
+	memcpy(fBuffer + fBufferLength, &record, sizeof(record));
+	memcpy(fBuffer + fBufferLength + sizeof(record), text, length * sizeof(TChar));
+	fBufferLength += recordLength;
+
+	fNeedsSync = true;
+
+	if (fBufferLength > kMaxBufferedJournal)
+		Flush(false);
+
+	EnableIdling(true);
+}
+
+
+void TEditJournal::Flush(bool sync)
+{
+	if (fFailed || !fJournal.IsOpen())
+		return;
+
+	try
+	{
+		if (fBufferLength > 0)
+		{
+			fJournal.Write(fBuffer, fBufferLength);
+			fUnsyncedLength += fBufferLength;
+			fBufferLength = 0;
+		}
+
+		if (sync && fNeedsSync)
+		{
+			fsync(fJournal.GetFileDescriptor());
+			fNeedsSync = false;
+			fLastSyncTime = gApplication->GetCurrentTime();
+			fUnsyncedLength = 0;
+		}
+	}
+	catch (TSystemError* error)
+	{
+		delete error;
+		fJournal.Close();
+		fFailed = true;
+	}
+}
+
+
+void TEditJournal::DoIdle()
+{
+	Flush(false);
+
+	if (fNeedsSync && (gApplication->GetCurrentTime() - fLastSyncTime >= kJournalSyncTime || fUnsyncedLength >= kMaxUnsyncedJournal))
+		Flush(true);
+
+	// keep coming back until what was written is synced
+	if (!fNeedsSync || fFailed)
+		EnableIdling(false);
+}
+
+
+bool TEditJournal::CanRecover(TFile& file)
+{
+	TFile journal;
+	GetJournalFile(file, journal);
+
+	if (!journal.Exists() || journal.GetFileSize() <= sizeof(JournalHeader))
+		return false;
+
+	JournalHeader header;
+
+	try
+	{
+		journal.Open(true, false, false);
+		journal.Read(&header, sizeof(header));
+		journal.Close();
+	}
+	catch (TSystemError* error)
+	{
+		delete error;
+		return false;
+	}
+
+	// only replay over the version of the file the journal was started against
+	uint32 baseSize;
+	TFileTime baseModification;
+	GetFileStamp(file, baseSize, baseModification);
+
+	return (memcmp(header.magic, kJournalMagic, sizeof(header.magic)) == 0 && header.version == kJournalVersion &&
+			header.baseSize == baseSize && header.baseModification == baseModification);
+}
+
+
+bool TEditJournal::Recover(TFile& file, TChar*& ioText, STextOffset& ioLength)
+{
+	if (!CanRecover(file) || file.GetFileSize() != ioLength)
+		return false;
+
+	TFile journal;
+	GetJournalFile(file, journal);
+
+	uint32 journalLength = journal.GetFileSize();
+	char* data = (char *)malloc(journalLength);
+	ASSERT(data);
+
+	try
+	{
+		journal.Open(true, false, false);
+		journal.Read(data, journalLength);
+		journal.Close();
+	}
+	catch (TSystemError* error)
+	{
+		delete error;
+		free(data);
+		return false;
+	}
+
+	TChar* text = ioText;
+	STextOffset length = ioLength;
+	bool recovered = false;
+
+	const char* next = data + sizeof(JournalHeader);
+	const char* end = data + journalLength;
+
+	// a record cut short by a crash ends the replay
+	while (next + sizeof(JournalRecord) <= end)
+	{
+		JournalRecord record;
+		memcpy(&record, next, sizeof(record));
+		const TChar* inserted = (const TChar *)(next + sizeof(record));
+
+		if (next + sizeof(record) + record.insertLength * sizeof(TChar) > end ||
+			record.offset > length || record.deleteLength > length - record.offset)
+			break;
+
+		STextOffset newLength = length - record.deleteLength + record.insertLength;
+
+		if (newLength > length)
+		{
+			text = (TChar *)realloc(text, newLength * sizeof(TChar));
+			ASSERT(text);
+		}
+
+		STextOffset tail = record.offset + record.deleteLength;
+		memmove(text + record.offset + record.insertLength, text + tail, (length - tail) * sizeof(TChar));
+		memcpy(text + record.offset, inserted, record.insertLength * sizeof(TChar));
+		length = newLength;
+		recovered = true;
+
+		next += sizeof(record) + record.insertLength * sizeof(TChar);
+	}
+
+	free(data);
+
+	ioText = text;
+	ioLength = length;
+	return recovered;
+}
+
+
+void TEditJournal::GetJournalFile(const TFile& file, TFile& journal)
+{
+	TString path;
+	file.GetDirectory(path);
+	path += ".";
+	path += file.GetFileName();
+	path += ".journal";
+
+	journal.Specify(path);
+}
+
+
+void TEditJournal::GetFileStamp(TFile& file, uint32& size, TFileTime& modification)
+{
+	size = 0;
+	modification = 0;
+
+	if (file.Exists())
+	{
+		TFileTime access, statusChange;
+		file.GetFileTimes(access, modification, statusChange);
+		size = file.GetFileSize();
+	}
+}
@@ -0,0 +1,78 @@
+// ========================================================================================
+//	TEditJournal.h			   Copyright (C) 2001-2009 Mike Voydanoff. All rights reserved.
+// ========================================================================================
+/*
+	This program is free software; you can redistribute it and/or
+	modify it under the terms of the GNU General Public License
+	as published by the Free Software Foundation; either version 2
+	of the License, or (at your option) any later version.
+	
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+	
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*/
+
+#ifndef __TEditJournal__
+#define __TEditJournal__
+
+#include "TIdler.h"
+#include "TFile.h"
+#include "TTextLayout.h"
+
+
+// Append-only log of the edits made to a document since it was last saved.
+// Each record is the offset, the number of characters deleted and the characters inserted.
+// Records are buffered in memory and written out when idle, so a journaled edit only costs a memcpy.
+// Since fsync can stall on slow disks, the writes are only synced every so often or once enough has built up.
+// The journal file is created next to the file it describes on the first edit
+// and is removed when the document is closed.
+
+class TEditJournal : public TIdler
+{
+public:
+							TEditJournal(const TFile& file);
+	virtual					~TEditJournal();
+
+	inline const TFile&		GetFile() const { return fFile; }
+
+	void					Begin();				// start a new journal against the file as it is on disk
+	void					Continue();				// keep appending to the existing journal after recovering from it
+	void					Discard();				// remove the journal file
+
+	void					RecordEdit(STextOffset offset, STextOffset deleteLength, const TChar* text, STextOffset length);
+	void					Flush(bool sync);
+
+	// returns true if there is a journal that was started against the file as it is now on disk
+	static bool				CanRecover(TFile& file);
+
+	// replays the journal over text, which must contain the file as it is on disk
+	static bool				Recover(TFile& file, TChar*& ioText, STextOffset& ioLength);
+
+protected:
+	virtual void			DoIdle();
+
+	void					OpenJournal();
+
+	static void				GetJournalFile(const TFile& file, TFile& journal);
+	static void				GetFileStamp(TFile& file, uint32& size, TFileTime& modification);
+
+protected:
+	TFile					fFile;
+	TFile					fJournal;
+	uint32					fBaseSize;				// size and modification time of the file when the journal was started
+	TFileTime				fBaseModification;
+	char*					fBuffer;
+	uint32					fBufferLength;
+	uint32					fBufferSize;
+	bool					fNeedsSync;
+	TTime					fLastSyncTime;
+	uint32					fUnsyncedLength;		// written since the last fsync
+	bool					fFailed;				// stop journaling after the first write error
+};
+
+#endif // __TEditJournal__
@@ -27,6 +27,13 @@
 #include "TApplication.h"
 
 #include <stdlib.h>
+#include <string.h>
+
+#include <X11/Xutil.h>
+
+#ifdef HAVE_XRENDER
+#include <X11/extensions/Xrender.h>
+#endif
 
 
 TFont::TFont(const char* fontNameList)
@@ -38,15 +45,155 @@ TFont::TFont(const char* fontNameList)
 
 	fFontSet = XCreateFontSet(gApplication->GetDisplay(), fontNameList, &missing, &missingCount, &defString);
 	ASSERT(fFontSet);
+
+	memset(fGlyphs, 0, sizeof(fGlyphs));
+
+#ifdef HAVE_XRENDER
+	fGlyphSet = 0;
+	memset(fGlyphLoaded, 0, sizeof(fGlyphLoaded));
+#endif
 }
 
 
 TFont::~TFont()
 {
+	for (int i = 0; i < 128; i++)
+	{
+		if (fGlyphs[i])
+		{
+			free(fGlyphs[i]->alpha);
+			delete fGlyphs[i];
+		}
+	}
+
+#ifdef HAVE_XRENDER
+	if (fGlyphSet)
+		XRenderFreeGlyphSet(gApplication->GetDisplay(), fGlyphSet);
+#endif
+
 	XFreeFontSet(gApplication->GetDisplay(), fFontSet);
 }
 
 
+const TGlyphBitmap* TFont::GetGlyphBitmap(char c)
+{
+	if (c < ' ' || c > '~')
+		return NULL;
+
+	TGlyphBitmap* glyph = fGlyphs[(int)c];
+
+	if (!glyph)
+	{
+		glyph = new TGlyphBitmap;
+		RasterizeGlyph(c, *glyph);
+		fGlyphs[(int)c] = glyph;
+	}
+
+	return glyph;
+}
+
+
+// draws the glyph from the core font into a bitmap and reads it back, once per glyph
+void TFont::RasterizeGlyph(char c, TGlyphBitmap& glyph)
+{
+	Display* display = gApplication->GetDisplay();
+
+	XRectangle	ink;
+	glyph.advance = XmbTextExtents(fFontSet, &c, 1, &ink, NULL);
+	glyph.x = -ink.x;
+	glyph.y = -ink.y;
+	glyph.width = ink.width;
+	glyph.height = ink.height;
+	glyph.alpha = (unsigned char *)calloc(ink.width * ink.height + 1, 1);
+	ASSERT(glyph.alpha);
+
+	if (ink.width > 0 && ink.height > 0)
+	{
+		Pixmap pixmap = XCreatePixmap(display, gApplication->GetRootWindow(), ink.width, ink.height, 1);
+		GC gc = XCreateGC(display, pixmap, 0, NULL);
+
+		XSetForeground(display, gc, 0);
+		XFillRectangle(display, pixmap, gc, 0, 0, ink.width, ink.height);
+		XSetForeground(display, gc, 1);
+		XmbDrawString(display, pixmap, fFontSet, gc, -ink.x, -ink.y, &c, 1);
+
+		XImage* image = XGetImage(display, pixmap, 0, 0, ink.width, ink.height, 1, XYPixmap);
+
+		if (image)
+		{
+			for (int v = 0; v < ink.height; v++)
+				for (int h = 0; h < ink.width; h++)
+					glyph.alpha[v * ink.width + h] = (XGetPixel(image, h, v) ? 0xFF : 0);
+
+			XDestroyImage(image);
+		}
+
+		XFreeGC(display, gc);
+		XFreePixmap(display, pixmap);
+	}
+}
+
+
+#ifdef HAVE_XRENDER
+
+bool TFont::GetGlyphSet(const char* text, int length, XID& glyphSet)
+{
+	for (int i = 0; i < length; i++)
+	{
+		if (text[i] < ' ' || text[i] > '~')
+			return false;
+	}
+
+	if (!fGlyphSet)
+	{
+		Display* display = gApplication->GetDisplay();
+		fGlyphSet = XRenderCreateGlyphSet(display, XRenderFindStandardFormat(display, PictStandardA8));
+	}
+
+	for (int i = 0; i < length; i++)
+	{
+		if (!fGlyphLoaded[(int)text[i]])
+			LoadGlyph(text[i]);
+	}
+
+	glyphSet = fGlyphSet;
+	return true;
+}
+
+
+// uploads a glyph to the glyph set
+void TFont::LoadGlyph(char c)
+{
+	const TGlyphBitmap* glyph = GetGlyphBitmap(c);
+	ASSERT(glyph);
+
+	XGlyphInfo	info;
+	info.width = glyph->width;
+	info.height = glyph->height;
+	info.x = glyph->x;
+	info.y = glyph->y;
+	info.xOff = glyph->advance;
+	info.yOff = 0;
+
+	// A8 rows are padded to 4 bytes
+	int rowBytes = (glyph->width + 3) & ~3;
+	int dataSize = rowBytes * glyph->height;
+	char* data = (char *)calloc(dataSize + 4, 1);
+	ASSERT(data);
+
+	for (int v = 0; v < glyph->height; v++)
+		memcpy(data + v * rowBytes, glyph->alpha + v * glyph->width, glyph->width);
+
+	Glyph id = (unsigned char)c;
+	XRenderAddGlyphs(gApplication->GetDisplay(), fGlyphSet, &id, &info, 1, data, dataSize);
+	free(data);
+
+	fGlyphLoaded[(int)c] = true;
+}
+
+#endif // HAVE_XRENDER
+
+
 TCoord TFont::MeasureText(const TChar* text, int length) const
 {
 	if (length == 0)
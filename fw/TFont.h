@@ -26,6 +26,17 @@
 #include <X11/Xlib.h>
 
 
+// a glyph rasterized on the client, for drawing text without the server's fonts
+struct TGlyphBitmap
+{
+	TCoord					x;						// position of the origin in the bitmap
+	TCoord					y;
+	TCoord					width;
+	TCoord					height;
+	TCoord					advance;
+	unsigned char*			alpha;					// width * height coverage values
+};
+
 class TFont : public TReferenceCounted
 {
 public:
@@ -36,11 +47,31 @@ public:
 
 	inline XFontSet			GetFontSet() const { return fFontSet; }
 
+	// returns NULL for anything other than printable ASCII
+	const TGlyphBitmap*		GetGlyphBitmap(char c);
+
+#ifdef HAVE_XRENDER
+	// returns the server side glyph set for XRender, after making sure it holds the glyphs in text.
+	// only printable ASCII is cached, returns false if text has anything else.
+	bool					GetGlyphSet(const char* text, int length, XID& glyphSet);
+#endif
+
 protected:
 	virtual					~TFont();
 
+	void					RasterizeGlyph(char c, TGlyphBitmap& glyph);
+
+#ifdef HAVE_XRENDER
+	void					LoadGlyph(char c);
+#endif
+
 protected:
 	XFontSet				fFontSet;
+	TGlyphBitmap*			fGlyphs[128];			// created on first use
+#ifdef HAVE_XRENDER
+	XID						fGlyphSet;
+	bool					fGlyphLoaded[128];
+#endif
 };
 
 #endif // __TFont__
@@ -0,0 +1,230 @@
+// ========================================================================================
+//	TGridSelection.cpp			   Copyright (C) 2001-2009 Mike Voydanoff. All rights reserved.
+// ========================================================================================
+/*
+	This program is free software; you can redistribute it and/or
+	modify it under the terms of the GNU General Public License
+	as published by the Free Software Foundation; either version 2
+	of the License, or (at your option) any later version.
+	
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+	
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "FWCommon.h"
+
+#include "TGridSelection.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+
+TGridSelection::TGridSelection()
+	:	fRanges(NULL),
+		fCount(0),
+		fSize(0)
+{
+}
+
+
+TGridSelection::~TGridSelection()
+{
+	free(fRanges);
+}
+
+
+uint32 TGridSelection::ColumnMask(int left, int right)
+{
+	ASSERT(left >= 0 && right <= kMaxColumns);
+
+	uint32 mask = 0;
+	for (int column = left; column < right; column++)
+		mask |= ((uint32)1 << column);
+
+	return mask;
+}
+
+
+bool TGridSelection::Contains(int row, int column) const
+{
+	ASSERT(column >= 0 && column < kMaxColumns);
+
+	int index = Find(row);
+	return (index < fCount && fRanges[index].top <= row && (fRanges[index].columns & ((uint32)1 << column)));
+}
+
+
+bool TGridSelection::GetFirst(int& outRow, int& outColumn) const
+{
+	if (fCount == 0)
+		return false;
+
+	outRow = fRanges[0].top;
+	outColumn = 0;
+	while (!(fRanges[0].columns & ((uint32)1 << outColumn)))
+		outColumn++;
+
+	return true;
+}
+
+
+bool TGridSelection::GetRowBounds(int& outTop, int& outBottom) const
+{
+	if (fCount == 0)
+		return false;
+
+	outTop = fRanges[0].top;
+	outBottom = fRanges[fCount - 1].bottom;
+	return true;
+}
+
+
+void TGridSelection::Select(int top, int bottom, uint32 columns)
+{
+	if (top < bottom && columns != 0)
+		Change(top, bottom, columns, true);
+}
+
+
+void TGridSelection::Unselect(int top, int bottom, uint32 columns)
+{
+	if (top < bottom && columns != 0 && fCount > 0)
+		Change(top, bottom, columns, false);
+}
+
+
+void TGridSelection::RemoveAll()
+{
+	fCount = 0;
+}
+
+
+// returns the index of the first range that ends after row
+int TGridSelection::Find(int row) const
+{
+	int low = 0;
+	int high = fCount;
+
+	while (low < high)
+	{
+		int middle = (low + high) / 2;
+		if (fRanges[middle].bottom <= row)
+			low = middle + 1;
+		else
+			high = middle;
+	}
+
+	return low;
+}
+
+
+// splits the range containing row so that one starts at row,
+// and returns the index of the first range that starts at or after row
+int TGridSelection::Split(int row)
+{
+	int index = Find(row);
+
+	if (index < fCount && fRanges[index].top < row)
+	{
+		Range range = fRanges[index];
+		range.top = row;
+		fRanges[index].bottom = row;
+		Replace(index + 1, 0, &range, 1);
+		index++;
+	}
+
+	return index;
+}
+
+
+void TGridSelection::Change(int top, int bottom, uint32 columns, bool select)
+{
+	int first = Split(top);
+	int last = Split(bottom);
+
+	// the ranges from first to last now lie within top and bottom.
+	// build their replacement, with new ranges for the gaps between them when selecting.
+	Range* ranges = (Range *)malloc((2 * (last - first) + 1) * sizeof(Range));
+	ASSERT(ranges);
+	int count = 0;
+	int row = top;
+
+	for (int i = first; i <= last; i++)
+	{
+		int gapEnd = (i < last ? fRanges[i].top : bottom);
+
+		if (select && row < gapEnd)
+		{
+			ranges[count].top = row;
+			ranges[count].bottom = gapEnd;
+			ranges[count].columns = columns;
+			count++;
+		}
+
+		if (i < last)
+		{
+			ranges[count] = fRanges[i];
+			if (select)
+				ranges[count].columns |= columns;
+			else
+				ranges[count].columns &= ~columns;
+			count++;
+			row = fRanges[i].bottom;
+		}
+	}
+
+	Replace(first, last - first, ranges, count);
+	free(ranges);
+
+	// drop empty ranges and merge neighbors that touch and have the same columns,
+	// including the ones just outside the change
+	int start = (first > 0 ? first - 1 : 0);
+	int end = first + count + 1;
+	if (end > fCount)
+		end = fCount;
+
+	int dest = start;
+	for (int i = start; i < end; i++)
+	{
+		if (fRanges[i].columns == 0)
+			continue;
+
+		if (dest > start && fRanges[dest - 1].bottom == fRanges[i].top && fRanges[dest - 1].columns == fRanges[i].columns)
+			fRanges[dest - 1].bottom = fRanges[i].bottom;
+		else
+			fRanges[dest++] = fRanges[i];
+	}
+
+	if (dest < end)
+		Replace(dest, end - dest, NULL, 0);
+}
+
+
+// replaces count ranges at index with newCount ranges
+void TGridSelection::Replace(int index, int count, const Range* ranges, int newCount)
+{
+	int newTotal = fCount - count + newCount;
+
+	if (newTotal > fSize)
+	{
+		fSize = newTotal + fSize / 2 + 8;
+		fRanges = (Range *)realloc(fRanges, fSize * sizeof(Range));
+		ASSERT(fRanges);
+	}
+
+	memmove(fRanges + index + newCount, fRanges + index + count, (fCount - index - count) * sizeof(Range));
+	if (newCount > 0)
+		memcpy(fRanges + index, ranges, newCount * sizeof(Range));
+
+	fCount = newTotal;
+}
@@ -0,0 +1,69 @@
+// ========================================================================================
+//	TGridSelection.h			   Copyright (C) 2001-2009 Mike Voydanoff. All rights reserved.
+// ========================================================================================
+/*
+	This program is free software; you can redistribute it and/or
+	modify it under the terms of the GNU General Public License
+	as published by the Free Software Foundation; either version 2
+	of the License, or (at your option) any later version.
+	
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+	
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*/
+
+#ifndef __TGridSelection__
+#define __TGridSelection__
+
+
+// The selected cells of a TGridView, as a sorted list of row ranges.
+// Each range has a bit mask of the columns that are selected in all of its rows,
+// so selecting every row of a long list takes a single range.
+// Finding the range for a row is a binary search.
+
+class TGridSelection
+{
+public:
+	enum { kMaxColumns = 32 };
+
+							TGridSelection();
+							~TGridSelection();
+
+	bool					Contains(int row, int column) const;
+	inline bool				IsEmpty() const { return (fCount == 0); }
+
+	bool					GetFirst(int& outRow, int& outColumn) const;
+	bool					GetRowBounds(int& outTop, int& outBottom) const;	// from the first selected row to after the last
+
+	// rows top to bottom, columns as a mask from ColumnMask
+	void					Select(int top, int bottom, uint32 columns);
+	void					Unselect(int top, int bottom, uint32 columns);
+	void					RemoveAll();
+
+	static uint32			ColumnMask(int left, int right);
+
+protected:
+	struct Range
+	{
+		int					top;
+		int					bottom;
+		uint32				columns;
+	};
+
+	int						Find(int row) const;
+	int						Split(int row);
+	void					Change(int top, int bottom, uint32 columns, bool select);
+	void					Replace(int index, int count, const Range* ranges, int newCount);
+
+protected:
+	Range*					fRanges;
+	int						fCount;
+	int						fSize;
+};
+
+#endif // __TGridSelection__
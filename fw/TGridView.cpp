@@ -28,6 +28,27 @@
 #include "TRegion.h"
 
 #include <X11/keysym.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+// returns the first index whose end is past position, or count if there is none
+static int SearchOffsets(const TCoord* offsets, int count, TCoord position)
+{
+	int low = 0;
+	int high = count;
+
+	while (low < high)
+	{
+		int middle = (low + high) / 2;
+		if (offsets[middle + 1] <= position)
+			low = middle + 1;
+		else
+			high = middle;
+	}
+
+	return low;
+}
 
 
 TGridView::TGridView(TWindow* parent, const TRect& bounds)
@@ -35,7 +56,11 @@ TGridView::TGridView(TWindow* parent, const TRect& bounds)
 		fLastCellClick(-1, -1),
 		fMultiSelect(false),
 		fTrackingMouse(false),
-		fMouseTrackingIdler(NULL)
+		fMouseTrackingIdler(NULL),
+		fRowOffsets(NULL),
+		fColumnOffsets(NULL),
+		fOffsetRowCount(-1),
+		fOffsetColumnCount(-1)
 {
 }
 
@@ -43,6 +68,8 @@ TGridView::TGridView(TWindow* parent, const TRect& bounds)
 TGridView::~TGridView()
 {
 	delete fMouseTrackingIdler;
+	free(fRowOffsets);
+	free(fColumnOffsets);
 }
 
 
@@ -61,8 +88,13 @@ void TGridView::Draw(TRegion* clip)
 
 	TDrawContext context(this, clip);
 
+	// cells are sent together, and drawn on the client when they cover enough of the view
+	context.BeginBatch();
+
 	TRect	r(0, 0, GetColumnCount(), GetRowCount());
 	DrawCellRange(context, r, clip);
+
+	context.EndBatch();
 }
 
 
@@ -87,8 +119,39 @@ void TGridView::RedrawCell(int row, int column)
 }
 
 
-void TGridView::DrawCellRange(TDrawContext& context, const TRect& range, TRegion* clip)
+void TGridView::DrawCellRange(TDrawContext& context, const TRect& cellRange, TRegion* clip)
 {
+	// only visit the cells that can be seen
+	TRect	visible;
+	GetVisibleBounds(visible);
+
+	if (clip)
+	{
+		TRect	clipBounds;
+		clip->GetBounds(clipBounds);
+		clipBounds.Offset(fScroll.h, fScroll.v);
+		visible.IntersectWith(clipBounds);
+	}
+
+	if (visible.IsEmpty())
+		return;
+
+	TRect	range(cellRange);
+
+	int first = FindRow(visible.top);
+	int last = FindRow(visible.bottom - 1) + 1;
+	if (range.top < first)
+		range.top = first;
+	if (range.bottom > last)
+		range.bottom = last;
+
+	first = FindColumn(visible.left);
+	last = FindColumn(visible.right - 1) + 1;
+	if (range.left < first)
+		range.left = first;
+	if (range.right > last)
+		range.right = last;
+
 	if (range.top < range.bottom && range.left < range.right)
 	{
 		TRect	bounds;
@@ -124,38 +187,158 @@ void TGridView::DrawCellRange(TDrawContext& context, const TRect& range, TRegion
 
 void TGridView::GetCellBounds(int row, int column, TRect& bounds) const
 {
-	// inefficient - but you can override if you want
-
 	ASSERT(row >= 0 && row < GetRowCount());
 	ASSERT(column >= 0 && column < GetColumnCount());	
 
-	TCoord h = 0;
-	TCoord v = 0;
+	bounds.Set(GetColumnLeft(column), GetRowTop(row), GetColumnLeft(column + 1), GetRowTop(row + 1));
+}
 
-	int i;
-	for (i = 0; i < row; i++)
-		v += GetRowHeight(i);
-		
-	for (i = 0; i < column; i++)
-		h += GetColumnWidth(i);
 
-	bounds.Set(h, v, h + GetColumnWidth(column), v + GetRowHeight(row));
+void TGridView::ComputeContentSize()
+{
+	// row heights and column widths may have changed, not just their number
+	ComputeRowOffsets();
+	ComputeColumnOffsets();
+	UpdateContentSize();
 }
 
 
-void TGridView::ComputeContentSize()
+void TGridView::UpdateContentSize()
+{
+	ValidateGeometry();
+
+	if (fOffsetRowCount > 0 && fOffsetColumnCount > 0)
+		SetContentSize(TPoint(fColumnOffsets[fOffsetColumnCount], fRowOffsets[fOffsetRowCount]));
+	else
+		SetContentSize(gZeroPoint);
+}
+
+
+// for subclasses that insert rows into a long list, to avoid measuring every row again
+void TGridView::RowsInserted(int row, int count)
 {
 	int rows = GetRowCount();
-	int columns = GetColumnCount();
 
-	if (rows > 0 && columns > 0)
+	if (fOffsetRowCount != rows - count)
 	{
-		TRect bounds;
-		GetCellBounds(rows - 1, columns - 1, bounds);
-		SetContentSize(TPoint(bounds.right, bounds.bottom));
+		ComputeContentSize();
+		return;
 	}
-	else
-		SetContentSize(gZeroPoint);
+
+	ASSERT(row >= 0 && row <= fOffsetRowCount);
+
+	fRowOffsets = (TCoord *)realloc(fRowOffsets, (rows + 1) * sizeof(TCoord));
+	ASSERT(fRowOffsets);
+
+	// move the rows below down, then measure the new ones
+	memmove(fRowOffsets + row + count, fRowOffsets + row, (fOffsetRowCount - row + 1) * sizeof(TCoord));
+
+	TCoord oldTop = fRowOffsets[row + count];
+	
+	for (int i = row; i < row + count; i++)
+		fRowOffsets[i + 1] = fRowOffsets[i] + GetRowHeight(i);
+
+	TCoord delta = fRowOffsets[row + count] - oldTop;
+	for (int i = row + count + 1; i <= rows; i++)
+		fRowOffsets[i] += delta;
+
+	fOffsetRowCount = rows;
+	UpdateContentSize();
+}
+
+
+void TGridView::RowsDeleted(int row, int count)
+{
+	int rows = GetRowCount();
+
+	if (fOffsetRowCount != rows + count)
+	{
+		ComputeContentSize();
+		return;
+	}
+
+	ASSERT(row >= 0 && row + count <= fOffsetRowCount);
+
+	TCoord delta = fRowOffsets[row + count] - fRowOffsets[row];
+
+	memmove(fRowOffsets + row, fRowOffsets + row + count, (fOffsetRowCount - row - count + 1) * sizeof(TCoord));
+
+	for (int i = row; i <= rows; i++)
+		fRowOffsets[i] -= delta;
+
+	fOffsetRowCount = rows;
+	UpdateContentSize();
+}
+
+
+TCoord TGridView::GetRowTop(int row) const
+{
+	ValidateGeometry();
+	ASSERT(row >= 0 && row <= fOffsetRowCount);
+
+	return fRowOffsets[row];
+}
+
+
+TCoord TGridView::GetColumnLeft(int column) const
+{
+	ValidateGeometry();
+	ASSERT(column >= 0 && column <= fOffsetColumnCount);
+
+	return fColumnOffsets[column];
+}
+
+
+int TGridView::FindRow(TCoord v) const
+{
+	ValidateGeometry();
+	return SearchOffsets(fRowOffsets, fOffsetRowCount, v);
+}
+
+
+int TGridView::FindColumn(TCoord h) const
+{
+	ValidateGeometry();
+	return SearchOffsets(fColumnOffsets, fOffsetColumnCount, h);
+}
+
+
+void TGridView::ValidateGeometry() const
+{
+	if (fOffsetRowCount != GetRowCount())
+		ComputeRowOffsets();
+	if (fOffsetColumnCount != GetColumnCount())
+		ComputeColumnOffsets();
+}
+
+
+void TGridView::ComputeRowOffsets() const
+{
+	int rows = GetRowCount();
+
+	fRowOffsets = (TCoord *)realloc(fRowOffsets, (rows + 1) * sizeof(TCoord));
+	ASSERT(fRowOffsets);
+
+	fRowOffsets[0] = 0;
+	for (int i = 0; i < rows; i++)
+		fRowOffsets[i + 1] = fRowOffsets[i] + GetRowHeight(i);
+
+	fOffsetRowCount = rows;
+}
+
+
+void TGridView::ComputeColumnOffsets() const
+{
+	int columns = GetColumnCount();
+
+	fColumnOffsets = (TCoord *)realloc(fColumnOffsets, (columns + 1) * sizeof(TCoord));
+	ASSERT(fColumnOffsets);
+
+	fColumnOffsets[0] = 0;
+	for (int i = 0; i < columns; i++)
+		fColumnOffsets[i + 1] = fColumnOffsets[i] + GetColumnWidth(i);
+
+	fOffsetColumnCount = columns;
 }
 
 
@@ -193,26 +376,26 @@ void TGridView::ClearLastClick()
 
 void TGridView::SelectCellRange(TRect range, bool select, bool multiple)
 {
-	int row, column;
-	for (row = range.top; row < range.bottom; row++)
+	if (select)
 	{
-		for (column = range.left; column < range.right; column++)
+		// a row at a time, since AllowCellSelect may depend on what is already selected
+		for (int row = range.top; row < range.bottom; row++)
 		{
-			TRect	r(column, row, column + 1, row + 1);
-			
-			if (select)
+			uint32 columns = 0;
+
+			for (int column = range.left; column < range.right; column++)
 			{
 				if (AllowCellSelect(row, column, multiple))
-					fSelection.Union(r);
-			}
-			else
-			{
-				TRegion	temp(r);
-				fSelection.Difference(&temp);
+					columns |= TGridSelection::ColumnMask(column, column + 1);
 			}
+
+			fSelection.Select(row, row + 1, columns);
 		}
 	}
+	else
+		fSelection.Unselect(range.top, range.bottom, TGridSelection::ColumnMask(range.left, range.right));
 
+	// only the visible part of the range is drawn
 	if (IsCreated())
 	{
 		TDrawContext	context(this);
@@ -223,14 +406,7 @@ void TGridView::SelectCellRange(TRect range, bool select, bool multiple)
 
 void TGridView::SelectAll()
 {
-	for (int row = 0; row < GetRowCount(); row++)
-	{
-		for (int column = 0; column < GetColumnCount(); column++)
-		{
-			if (!CellSelected(row, column))
-				SelectCell(row, column);
-		}
-	}
+	SelectCellRange(TRect(0, 0, GetColumnCount(), GetRowCount()), true, false);
 	
 	DoCommand(this, this, kSelectionChangedCommandID);
 }
@@ -238,12 +414,16 @@ void TGridView::SelectAll()
 
 void TGridView::UnselectAll()
 {
-	for (int row = 0; row < GetRowCount(); row++)
+	int top, bottom;
+
+	if (fSelection.GetRowBounds(top, bottom))
 	{
-		for (int column = 0; column < GetColumnCount(); column++)
+		fSelection.RemoveAll();
+
+		if (IsCreated())
 		{
-			if (CellSelected(row, column))
-				UnselectCell(row, column);
+			TDrawContext	context(this);
+			DrawCellRange(context, TRect(0, top, GetColumnCount(), bottom));
 		}
 	}
 	
@@ -253,24 +433,14 @@ void TGridView::UnselectAll()
 
 bool TGridView::CellSelected(int row, int column) const
 {
-	return fSelection.Contains(TPoint(column, row));
+	return fSelection.Contains(row, column);
 }
 
 
 bool TGridView::GetFirstSelectedCell(int& row, int& column) const
 {	
-	for (int i = 0; i < GetRowCount(); i++)
-	{
-		for (int j = 0; j < GetColumnCount(); j++)
-		{
-			if (CellSelected(i, j))
-			{
-				row = i;
-				column = j;
-				return true;
-			}
-		}
-	}
+	if (fSelection.GetFirst(row, column))
+		return true;
 	
 	row = column = -1;
 	return false;
@@ -283,28 +453,13 @@ bool TGridView::FindCell(const TPoint& point, int& outRow, int& outColumn) const
 		point.v < 0 || point.v >= fContentSize.v)
 		return false;
 
-	TCoord h = 0;
-	TCoord v = 0;
+	int column = FindColumn(point.h);
+	if (column < GetColumnCount())
+		outColumn = column;
 
-	for (int column = 0; column < GetColumnCount(); column++)
-	{
-		h += GetColumnWidth(column);
-		if (h > point.h)
-		{
-			outColumn = column;
-			break;
-		}
-	}
-
-	for (int row = 0; row < GetRowCount(); row++)
-	{
-		v += GetRowHeight(row);
-		if (v > point.v)
-		{
-			outRow = row;
-			break;
-		}
-	}
+	int row = FindRow(point.v);
+	if (row < GetRowCount())
+		outRow = row;
 
 	return true;
 }
@@ -697,16 +852,13 @@ TCoord TGridView::GetPageIncrement(TScrollDirection direction) const
 void TGridView::ScrollSelectionIntoView()
 {
 	// only works with single selection!
-	for (int i = 0; i < GetRowCount(); i++)
-		for (int j = 0; j < GetColumnCount(); j++)
-			if (CellSelected(i, j))
-			{
-				TRect bounds;
-				GetCellBounds(i, j, bounds);
-				ScrollIntoView(bounds);
-				
-				break;
-			}
+	int row, column;
+	if (GetFirstSelectedCell(row, column))
+	{
+		TRect bounds;
+		GetCellBounds(row, column, bounds);
+		ScrollIntoView(bounds);
+	}
 }
 
 
@@ -715,41 +867,38 @@ void TGridView::GetVisibleCells(TRect& cells) const
 	TRect bounds;
 	GetVisibleBounds(bounds);
 	cells.Set(-1, -1, -1, -1);
-	
-	TCoord h = 0;
-	TCoord v = 0;
 
-	for (int column = 0; column < GetColumnCount(); column++)
+	int columns = GetColumnCount();
+	int rows = GetRowCount();
+
+	// right and bottom are the first cells past the visible bounds, after left and top
+	int column = FindColumn(bounds.left);
+	if (column < columns)
 	{
-		h += GetColumnWidth(column);
-		if (h > bounds.left && cells.left == -1)
-		{
-			cells.left = column;
-		}
-		else if (h > bounds.right && cells.right == -1)
-		{
+		cells.left = column;
+
+		column = FindColumn(bounds.right);
+		if (column == cells.left)
+			column++;
+		if (column < columns)
 			cells.right = column;
-			break;
-		}
 	}
 
-	for (int row = 0; row < GetRowCount(); row++)
+	int row = FindRow(bounds.top);
+	if (row < rows)
 	{
-		v += GetRowHeight(row);
-		if (v > bounds.top && cells.top == -1)
-		{
-			cells.top = row;
-		}
-		else if (v > bounds.bottom && cells.bottom == -1)
-		{
+		cells.top = row;
+
+		row = FindRow(bounds.bottom);
+		if (row == cells.top)
+			row++;
+		if (row < rows)
 			cells.bottom = row;
-			break;
-		}
 	}
 
 	if (cells.right == -1)
-		cells.right = GetColumnCount() - 1;
+		cells.right = columns - 1;
 	if (cells.bottom == -1)
-		cells.bottom = GetRowCount() - 1;
+		cells.bottom = rows - 1;
 }
 
@@ -23,6 +23,7 @@
 #include "TMouseTrackingIdler.h"
 #include "TView.h"
 #include "TRegion.h"
+#include "TGridSelection.h"
 
 
 class TGridView : public TView
@@ -89,16 +90,35 @@ protected:
 	virtual					~TGridView();
 
 	void					ComputeContentSize();
+	void					UpdateContentSize();
+	void					RowsInserted(int row, int count);
+	void					RowsDeleted(int row, int count);
 	void					DrawCellRange(TDrawContext& context, const TRect& range, TRegion* clip = NULL);
 
+	TCoord					GetRowTop(int row) const;				// row can be GetRowCount() for the bottom of the last row
+	TCoord					GetColumnLeft(int column) const;
+	int						FindRow(TCoord v) const;				// returns GetRowCount() if past the last row
+	int						FindColumn(TCoord h) const;
+
+	void					ValidateGeometry() const;
+	void					ComputeRowOffsets() const;
+	void					ComputeColumnOffsets() const;
+
 protected:
-	TRegion					fSelection;
+	TGridSelection			fSelection;
 	TPoint					fLastCellClick;
 	bool					fMultiSelect;
 	bool					fTrackingMouse;
 	TPoint					fStartCell;			// starting cell for for mouse tracking
 	TPoint					fTrackingCell;
 	TMouseTrackingIdler*	fMouseTrackingIdler;
+
+	// running totals of the row heights and column widths, so finding a cell is a binary search.
+	// rebuilt by ComputeContentSize, or when the number of rows or columns changes behind our back.
+	mutable TCoord*			fRowOffsets;
+	mutable TCoord*			fColumnOffsets;
+	mutable int				fOffsetRowCount;
+	mutable int				fOffsetColumnCount;
 };
 
 #endif // __TGridView__
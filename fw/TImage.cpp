@@ -42,6 +42,18 @@
 #define USE_SHM 1
 #endif
 
+#ifdef USE_SHM
+// set once the server refuses to attach our segments (a remote display, for instance)
+static bool sShmUnavailable = false;
+static bool sShmAttachFailed = false;
+
+static int ShmAttachErrorHandler(Display* /*display*/, XErrorEvent* /*event*/)
+{
+	sShmAttachFailed = true;
+	return 0;
+}
+#endif // USE_SHM
+
 TImage::TImage(TCoord width, TCoord height)
 	:	fImage(NULL),
 		fBuffer(NULL),
@@ -53,18 +65,14 @@ TImage::TImage(TCoord width, TCoord height)
 	int screen = gApplication->GetDefaultScreen();
 	fDepth = DefaultDepth(display, screen);
 
-	XVisualInfo	visualInfo;
-	if (! XMatchVisualInfo(display, screen, 16, TrueColor, &visualInfo))
-	{
-		ASSERT(0);
-	}
+	Visual* visual = DefaultVisual(display, screen);
 
 #ifdef USE_SHM	
 	memset(&fShmInfo, 0, sizeof(fShmInfo));
 	
-	if (XShmQueryExtension(display))
+	if (!sShmUnavailable && XShmQueryExtension(display))
 	{
-		fImage = XShmCreateImage(display, visualInfo.visual, fDepth,
+		fImage = XShmCreateImage(display, visual, fDepth,
 								 ZPixmap, NULL, &fShmInfo, width, height);
 
 		if (fImage)
@@ -84,13 +92,32 @@ TImage::TImage(TCoord width, TCoord height)
 			
 				if (fShmInfo.shmaddr == (char *)-1)
 				{
+					shmctl(fShmInfo.shmid, IPC_RMID, NULL);
+					fImage->data = fBuffer = NULL;
 					XDestroyImage(fImage);
 					fImage = NULL;
 				}
 				else
 				{
+					// the server reports a failed attach asynchronously, so trap it here
+					// rather than letting the default handler exit
+					sShmAttachFailed = false;
+					XErrorHandler oldHandler = XSetErrorHandler(ShmAttachErrorHandler);
 					XShmAttach(display, &fShmInfo);
 					XSync(display, false);
+					XSetErrorHandler(oldHandler);
+
+					// the segment goes away once both sides have detached
+					shmctl(fShmInfo.shmid, IPC_RMID, NULL);
+
+					if (sShmAttachFailed)
+					{
+						sShmUnavailable = true;
+						shmdt(fShmInfo.shmaddr);
+						fImage->data = fBuffer = NULL;
+						XDestroyImage(fImage);
+						fImage = NULL;
+					}
 				}		
 			}			 
 		}
@@ -103,10 +130,11 @@ TImage::TImage(TCoord width, TCoord height)
 	}
 	else
 	{
-		fRowBytes = (((width * fDepth) / 8) * 4 + 3) / 4;	// round up to nearest 4 bytes
-		fBuffer = (char*)malloc(height * fRowBytes);
-		fImage = XCreateImage(display, visualInfo.visual, fDepth, ZPixmap, 0,
-	    						fBuffer, width, height, 32, fRowBytes);
+		// let Xlib work out the row size for the visual's pixel format
+		fImage = XCreateImage(display, visual, fDepth, ZPixmap, 0,
+	    						NULL, width, height, 32, 0);
+		fRowBytes = fImage->bytes_per_line;
+		fImage->data = fBuffer = (char*)malloc(height * fRowBytes);
 	    fUsingShm = false;
 	}
 }
@@ -114,14 +142,19 @@ TImage::TImage(TCoord width, TCoord height)
 
 TImage::~TImage()
 {
+	// we free the buffer ourselves
 	if (fImage)
+	{
+		fImage->data = NULL;
 		XDestroyImage(fImage);
+	}
 
 #ifdef USE_SHM 
 	if (fUsingShm)
 	{
 		XShmDetach(gApplication->GetDisplay(), &fShmInfo);
 		shmdt(fShmInfo.shmaddr);
+		fBuffer = NULL;
 	}
 #endif // USE_SHM
 
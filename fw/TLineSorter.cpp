@@ -0,0 +1,360 @@
+// ========================================================================================
+//	TLineSorter.cpp			   Copyright (C) 2001-2009 Mike Voydanoff. All rights reserved.
+// ========================================================================================
+/*
+	This program is free software; you can redistribute it and/or
+	modify it under the terms of the GNU General Public License
+	as published by the Free Software Foundation; either version 2
+	of the License, or (at your option) any later version.
+	
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+	
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "FWCommon.h"
+
+#include "TLineSorter.h"
+#include "TException.h"
+#include "TString.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <regex.h>
+#include <unistd.h>
+
+#ifdef HAVE_LIBPTHREAD
+#include <pthread.h>
+#endif
+
+
+const uint32	kInsertionSortCount = 16;			// below this, insertion sort is faster than merging
+const uint32	kParallelSortCount = 50000;			// below this, starting a thread is not worth it
+const int		kMaxSortThreads = 8;
+
+
+TLineSorter::TLineSorter(const TChar* text, int flags, int column)
+	:	fText(text),
+		fFlags(flags),
+		fColumn(column)
+{
+}
+
+
+void TLineSorter::Sort(STextRange* lines, uint32 count)
+{
+	if (count < 2)
+		return;
+
+	SortLine* sortLines = (SortLine *)malloc(count * sizeof(SortLine));
+	SortLine* temp = (SortLine *)malloc(count * sizeof(SortLine));
+	ASSERT(sortLines && temp);
+
+	// keys are found once up front rather than on every comparison
+	for (uint32 i = 0; i < count; i++)
+	{
+		sortLines[i].line = lines[i];
+		GetKey(sortLines[i]);
+	}
+
+	int threads = 1;
+#ifdef HAVE_LIBPTHREAD
+	if (count >= kParallelSortCount)
+	{
+		long processors = sysconf(_SC_NPROCESSORS_ONLN);
+		threads = (processors < 1 ? 1 : (processors > kMaxSortThreads ? kMaxSortThreads : processors));
+	}
+#endif
+
+	MergeSort(sortLines, temp, count, threads);
+
+	for (uint32 i = 0; i < count; i++)
+		lines[i] = sortLines[i].line;
+
+	free(sortLines);
+	free(temp);
+}
+
+
+void TLineSorter::MergeSort(SortLine* lines, SortLine* temp, uint32 count, int threads)
+{
+	if (count <= kInsertionSortCount)
+	{
+		for (uint32 i = 1; i < count; i++)
+		{
+			SortLine line = lines[i];
+			uint32 j = i;
+
+			while (j > 0 && Compare(line, lines[j - 1]) < 0)
+			{
+				lines[j] = lines[j - 1];
+				j--;
+			}
+
+			lines[j] = line;
+		}
+
+		return;
+	}
+
+	uint32 leftCount = count / 2;
+	bool sorted = false;
+
+#ifdef HAVE_LIBPTHREAD
+	if (threads > 1 && count >= kParallelSortCount)
+	{
+		// sort the left half on a new thread and the right half on this one
+		SortTask task;
+		task.sorter = this;
+		task.lines = lines;
+		task.temp = temp;
+		task.count = leftCount;
+		task.threads = threads / 2;
+
+		pthread_t thread;
+		if (pthread_create(&thread, NULL, SortThread, &task) == 0)
+		{
+			MergeSort(lines + leftCount, temp + leftCount, count - leftCount, threads - threads / 2);
+			pthread_join(thread, NULL);
+			sorted = true;
+		}
+	}
+#endif
+
+	if (!sorted)
+	{
+		MergeSort(lines, temp, leftCount, 1);
+		MergeSort(lines + leftCount, temp + leftCount, count - leftCount, 1);
+	}
+
+	Merge(lines, temp, leftCount, count);
+}
+
+
+void TLineSorter::Merge(SortLine* lines, SortLine* temp, uint32 leftCount, uint32 count)
+{
+	// already in order
+	if (Compare(lines[leftCount], lines[leftCount - 1]) >= 0)
+		return;
+
+	memcpy(temp, lines, leftCount * sizeof(SortLine));
+
+	uint32 left = 0;
+	uint32 right = leftCount;
+	uint32 dest = 0;
+
+	// take from the left on ties to keep the sort stable
+	while (left < leftCount && right < count)
+	{
+		if (Compare(lines[right], temp[left]) < 0)
+			lines[dest++] = lines[right++];
+		else
+			lines[dest++] = temp[left++];
+	}
+
+	while (left < leftCount)
+		lines[dest++] = temp[left++];
+}
+
+
+void* TLineSorter::SortThread(void* data)
+{
+	SortTask* task = (SortTask *)data;
+	task->sorter->MergeSort(task->lines, task->temp, task->count, task->threads);
+	return NULL;
+}
+
+
+int TLineSorter::Compare(const SortLine& line1, const SortLine& line2) const
+{
+	int result = 0;
+
+	if (fFlags & kNumeric)
+	{
+		if (line1.number < line2.number)
+			result = -1;
+		else if (line1.number > line2.number)
+			result = 1;
+	}
+
+	if (result == 0)
+	{
+		STextOffset length = (line1.keyLength < line2.keyLength ? line1.keyLength : line2.keyLength);
+
+		if (fFlags & kCaseInsensitive)
+		{
+			for (STextOffset i = 0; i < length && result == 0; i++)
+				result = tolower((unsigned char)line1.key[i]) - tolower((unsigned char)line2.key[i]);
+		}
+		else
+			result = memcmp(line1.key, line2.key, length * sizeof(TChar));
+
+		if (result == 0)
+			result = (line1.keyLength < line2.keyLength ? -1 : (line1.keyLength > line2.keyLength ? 1 : 0));
+	}
+
+	return (fFlags & kReverse ? -result : result);
+}
+
+
+void TLineSorter::GetKey(SortLine& sortLine) const
+{
+	const TChar* key = fText + sortLine.line.start;
+	const TChar* end = fText + sortLine.line.end;
+
+	if (fColumn > 0)
+	{
+		// skip to the start of the field
+		while (key < end && isspace((unsigned char)*key))
+			key++;
+
+		for (int column = 1; column < fColumn && key < end; column++)
+		{
+			while (key < end && !isspace((unsigned char)*key))
+				key++;
+			while (key < end && isspace((unsigned char)*key))
+				key++;
+		}
+	}
+
+	sortLine.key = key;
+	sortLine.keyLength = end - key;
+	sortLine.number = (fFlags & kNumeric ? ParseNumber(key, end - key) : 0.0);
+}
+
+
+// lines are not null terminated, so strtod can't be used.  lines without a number sort as 0.
+double TLineSorter::ParseNumber(const TChar* text, STextOffset length)
+{
+	const TChar* end = text + length;
+
+	while (text < end && isspace((unsigned char)*text))
+		text++;
+
+	bool negative = false;
+	if (text < end && (*text == '-' || *text == '+'))
+		negative = (*text++ == '-');
+
+	double result = 0.0;
+	while (text < end && isdigit((unsigned char)*text))
+		result = result * 10.0 + (*text++ - '0');
+
+	if (text < end && *text == '.')
+	{
+		double scale = 0.1;
+		for (text++; text < end && isdigit((unsigned char)*text); text++)
+		{
+			result += (*text - '0') * scale;
+			scale *= 0.1;
+		}
+	}
+
+	return (negative ? -result : result);
+}
+
+
+uint32 TLineSorter::Unique(const TChar* text, STextRange* lines, uint32 count)
+{
+	if (count < 2)
+		return count;
+
+	// open addressed hash table of indices into the lines already kept
+	uint32 tableSize = 16;
+	while (tableSize < count * 2)
+		tableSize <<= 1;
+
+	const uint32 kEmpty = ~(uint32)0;
+	uint32* table = (uint32 *)malloc(tableSize * sizeof(uint32));
+	ASSERT(table);
+	memset(table, 0xFF, tableSize * sizeof(uint32));
+
+	uint32 kept = 0;
+
+	for (uint32 i = 0; i < count; i++)
+	{
+		const TChar* line = text + lines[i].start;
+		STextOffset length = lines[i].end - lines[i].start;
+
+		uint32 hash = 2166136261U;
+		for (STextOffset j = 0; j < length; j++)
+			hash = (hash ^ (unsigned char)line[j]) * 16777619U;
+
+		uint32 slot = hash & (tableSize - 1);
+		bool duplicate = false;
+
+		while (table[slot] != kEmpty)
+		{
+			const STextRange& other = lines[table[slot]];
+			if (other.end - other.start == length && memcmp(text + other.start, line, length * sizeof(TChar)) == 0)
+			{
+				duplicate = true;
+				break;
+			}
+
+			slot = (slot + 1) & (tableSize - 1);
+		}
+
+		if (!duplicate)
+		{
+			lines[kept] = lines[i];
+			table[slot] = kept++;
+		}
+	}
+
+	free(table);
+	return kept;
+}
+
+
+uint32 TLineSorter::Filter(const TChar* text, STextRange* lines, uint32 count, const TChar* pattern, bool keepMatches)
+{
+	regex_t regex;
+	int error = regcomp(&regex, pattern, REG_EXTENDED | REG_NOSUB);
+
+	if (error != 0)
+	{
+		char message[256];
+		regerror(error, &regex, message, sizeof(message));
+		throw new TProgramError(message);
+	}
+
+	// regexec needs each line to end in a null
+	TChar* buffer = NULL;
+	STextOffset bufferSize = 0;
+	uint32 kept = 0;
+
+	for (uint32 i = 0; i < count; i++)
+	{
+		STextOffset length = lines[i].end - lines[i].start;
+
+		if (length + 1 > bufferSize)
+		{
+			bufferSize = (length + 1) * 2;
+			buffer = (TChar *)realloc(buffer, bufferSize * sizeof(TChar));
+			ASSERT(buffer);
+		}
+
+		memcpy(buffer, text + lines[i].start, length * sizeof(TChar));
+		buffer[length] = 0;
+
+		bool matches = (regexec(&regex, buffer, 0, NULL, 0) == 0);
+
+		if (matches == keepMatches)
+			lines[kept++] = lines[i];
+	}
+
+	free(buffer);
+	regfree(&regex);
+
+	return kept;
+}
@@ -0,0 +1,84 @@
+// ========================================================================================
+//	TLineSorter.h			   Copyright (C) 2001-2009 Mike Voydanoff. All rights reserved.
+// ========================================================================================
+/*
+	This program is free software; you can redistribute it and/or
+	modify it under the terms of the GNU General Public License
+	as published by the Free Software Foundation; either version 2
+	of the License, or (at your option) any later version.
+	
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+	
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*/
+
+#ifndef __TLineSorter__
+#define __TLineSorter__
+
+#include "TTextLayout.h"
+
+
+// Sorts, dedupes and filters lines given as ranges into a text buffer.
+// Large sorts are split across threads, with each half merge sorted
+// in parallel and then merged.
+
+class TLineSorter
+{
+public:
+	enum
+	{
+		kCaseInsensitive	= 1,
+		kNumeric			= 2,
+		kReverse			= 4
+	};
+
+							TLineSorter(const TChar* text, int flags = 0, int column = 0);
+
+	// the sort is stable.  column is the 1 based whitespace separated field to sort by, 0 for the whole line.
+	void					Sort(STextRange* lines, uint32 count);
+
+	// removes all but the first of lines that are the same and returns the new count
+	static uint32			Unique(const TChar* text, STextRange* lines, uint32 count);
+
+	// removes lines that match the extended regular expression pattern (or that don't, if keepMatches is true)
+	// and returns the new count.  throws TProgramError if the pattern is not valid.
+	static uint32			Filter(const TChar* text, STextRange* lines, uint32 count, const TChar* pattern, bool keepMatches);
+
+protected:
+	struct SortLine
+	{
+		STextRange			line;
+		const TChar*		key;
+		STextOffset			keyLength;
+		double				number;
+	};
+
+	struct SortTask
+	{
+		TLineSorter*		sorter;
+		SortLine*			lines;
+		SortLine*			temp;
+		uint32				count;
+		int					threads;
+	};
+
+	void					MergeSort(SortLine* lines, SortLine* temp, uint32 count, int threads);
+	void					Merge(SortLine* lines, SortLine* temp, uint32 leftCount, uint32 count);
+	int						Compare(const SortLine& line1, const SortLine& line2) const;
+	void					GetKey(SortLine& sortLine) const;
+
+	static void*			SortThread(void* data);
+	static double			ParseNumber(const TChar* text, STextOffset length);
+
+protected:
+	const TChar*			fText;
+	int						fFlags;
+	int						fColumn;
+};
+
+#endif // __TLineSorter__
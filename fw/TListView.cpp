@@ -52,9 +52,7 @@ int TListView::GetColumnCount() const
 
 int TListView::GetFirstSelectedRow() const
 {
-	for (int i = 0; i < GetRowCount(); i++)
-		if (CellSelected(i, 0))
-			return i;
-
-	return -1;
+	int row, column;
+	GetFirstSelectedCell(row, column);
+	return row;
 }
@@ -141,10 +141,9 @@ bool TRegion::Intersects(const TRect& rect) const
 }
 
 
-
-
-
-
-
-
-
+void TRegion::GetBounds(TRect& bounds) const
+{
+	XRectangle r;
+	XClipBox(fRegion, &r);
+	bounds.Set(r.x, r.y, r.x + r.width, r.y + r.height);
+}
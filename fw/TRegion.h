@@ -48,6 +48,7 @@ public:
 	bool					Contains(const TPoint& point) const;
 	bool					Contains(const TRect& rect) const;
 	bool					Intersects(const TRect& rect) const;
+	void					GetBounds(TRect& bounds) const;
 
 	inline Region		 	GetRegion() const { return fRegion; }
 
@@ -41,6 +41,7 @@ struct LineRec
 	TCoord			ascent;
 	TCoord			height;
 	TCoord			width;
+	bool			modified;		// changed since ClearModifiedLines
 };
 
 
@@ -79,7 +80,9 @@ TTextLayout::TTextLayout(TFont* font, const TPoint& inset, int spacesPerTab, boo
 		fLineWrap(lineWrap),
 		fLinesInsertedProc(NULL),
 		fLinesDeletedProc(NULL),
-		fLineChangeClientData(NULL)
+		fLineChangeClientData(NULL),
+		fTextChangedProc(NULL),
+		fTextChangeClientData(NULL)
 {
 	ASSERT(font);
 	font->AddRef();
@@ -104,6 +107,8 @@ TTextLayout::~TTextLayout()
 
 void TTextLayout::SetText(TChar* text, STextOffset length, bool ownsData)
 {
+	STextOffset oldLength = fTextLength;
+
 	if (fText)
 	{
 		free(fText);
@@ -130,7 +135,10 @@ void TTextLayout::SetText(TChar* text, STextOffset length, bool ownsData)
 		fTextLength = length;
 
 		RecalcLineBreaks();
+		ClearModifiedLines();
 	}
+
+	TextChanged(0, oldLength, fTextLength);
 }
 
 
@@ -197,6 +205,45 @@ const TChar* TTextLayout::GetLineText(uint32 line, STextOffset& outLength, bool
 }
 
 
+STextRange* TTextLayout::GetLineRanges(STextOffset start, STextOffset end, uint32& outCount) const
+{
+	ASSERT(start <= end && end <= fTextLength);
+
+	const TChar* text = fText + start;
+	const TChar* textEnd = fText + end;
+
+	// a last line without a line ending is still a line
+	uint32 count = CountLineBreaks(text, textEnd);
+	if (start < end && textEnd[-1] != kLineEnd10 && textEnd[-1] != kLineEnd13)
+		++count;
+
+	STextRange* ranges = (STextRange *)malloc((count > 0 ? count : 1) * sizeof(STextRange));
+	ASSERT(ranges);
+
+	for (uint32 i = 0; i < count; i++)
+	{
+		const TChar* lineEnd = FindLineBreak(text, textEnd);
+		const TChar* next = (lineEnd ? lineEnd : textEnd);
+
+		if (lineEnd)
+		{
+			--lineEnd;
+			if (*lineEnd == kLineEnd10 && lineEnd > text && lineEnd[-1] == kLineEnd13)
+				--lineEnd;
+		}
+		else
+			lineEnd = textEnd;
+
+		ranges[i].start = text - fText;
+		ranges[i].end = lineEnd - fText;
+		text = next;
+	}
+
+	outCount = count;
+	return ranges;
+}
+
+
 LineRec& TTextLayout::GetLineRec(uint32 line, bool ignoreWrappedLines) const
 {
 	if (ignoreWrappedLines && fLineWrap)
@@ -499,7 +546,9 @@ void TTextLayout::ReplaceText(STextOffset start, STextOffset end, const TChar* t
 	if (!fText)
 	{
 		RecalcLineBreaks();
+		fLineBreaks[0].modified = true;
 		outRedrawLinesStart = outRedrawLinesEnd = 0;
+		TextChanged(start, end - start, length);
 		return;
 	}
 	
@@ -526,6 +575,7 @@ void TTextLayout::ReplaceText(STextOffset start, STextOffset end, const TChar* t
 		int32 textDiff = length - (end - start);
 		uint32 changeOffset = (start + length > end ? start + length : end);
 		RecalcWrappedLineBreaks(startLine, textDiff, changeOffset, outRedrawLinesEnd);
+		MarkModifiedLines(startLine, OffsetToLine(start + length));
 	}
 	else
 	{
@@ -586,28 +636,8 @@ void TTextLayout::ReplaceText(STextOffset start, STextOffset end, const TChar* t
 		
 		for (line = startLine; line <= endLine; line++)
 		{	
-			const TChar* text = fText + rec->textOffset;
-			int32 length = fTextLength - rec->textOffset;
-			for (int32 i=0; i<length; i++)
-			{
-				if (text[i] == kLineEnd10 || text[i] == kLineEnd13)
-				{
-					length = i;
-					break;
-				}
-			}	
-	
-			if (length)
-			{
-				rec->width = MeasureText(text, length, rec->ascent, rec->height, 0);
-			}
-			else
-			{
-				// height of an empty line
-				fFont->MeasureText("W", 1, rec->ascent, rec->height);
-				rec->width = 0;
-			}
-			
+			MeasureLine(*rec);
+			rec->modified = true;
 			rec->vertOffset = vertOffset;
 			vertOffset += rec->height;
 			
@@ -621,6 +651,8 @@ void TTextLayout::ReplaceText(STextOffset start, STextOffset end, const TChar* t
 		}
 	}
 
+	TextChanged(start, end - start, length);
+
 #if 0
 	// validate
 	if (fText)
@@ -653,6 +685,329 @@ void TTextLayout::ReplaceText(STextOffset start, STextOffset end, const TChar* t
 }
 
 
+// replaces each of the ranges with the same text
+void TTextLayout::ReplaceRanges(const STextRange* ranges, uint32 count, const TChar* text, STextOffset length,
+								uint32& outRedrawLinesStart, uint32& outRedrawLinesEnd)
+{
+	const TChar** texts = (const TChar **)malloc(count * sizeof(TChar *));
+	STextOffset* lengths = (STextOffset *)malloc(count * sizeof(STextOffset));
+	ASSERT(texts && lengths);
+
+	for (uint32 i = 0; i < count; i++)
+	{
+		texts[i] = text;
+		lengths[i] = length;
+	}
+
+	ReplaceRanges(ranges, count, texts, lengths, outRedrawLinesStart, outRedrawLinesEnd);
+
+	free(texts);
+	free(lengths);
+}
+
+
+// replaces each of the ranges with its own text in one pass over the text and the line records.
+// ranges must be sorted and must not overlap.
+void TTextLayout::ReplaceRanges(const STextRange* ranges, uint32 count, const TChar* const* texts, const STextOffset* lengths,
+								uint32& outRedrawLinesStart, uint32& outRedrawLinesEnd)
+{
+	ASSERT(count > 0);
+
+	bool changesLines = (fMultiLine && fLineWrap);
+	STextOffset deleted = 0;
+	STextOffset inserted = 0;
+	uint32 i;
+
+	for (i = 0; i < count; i++)
+	{
+		ASSERT(ranges[i].start <= ranges[i].end && ranges[i].end <= fTextLength);
+		ASSERT(i == 0 || ranges[i - 1].end <= ranges[i].start);
+
+		deleted += ranges[i].end - ranges[i].start;
+		inserted += lengths[i];
+
+		if (!changesLines && fMultiLine && (i == 0 || texts[i] != texts[i - 1]) && CountLineBreaks(texts[i], texts[i] + lengths[i]) > 0)
+			changesLines = true;
+		
+		// a \r just before the range may join a \n after it into one line break
+		if (!changesLines && fMultiLine && (CountLineBreaks(fText + ranges[i].start, fText + ranges[i].end) > 0 ||
+											(ranges[i].start > 0 && fText[ranges[i].start - 1] == kLineEnd13)))
+			changesLines = true;
+	}
+
+	uint32 startLine = OffsetToLine(ranges[0].start);
+	STextOffset newLength = fTextLength - deleted + inserted;
+
+	STextOffset changeStart = ranges[0].start;
+	STextOffset changeLength = ranges[count - 1].end - changeStart;
+	STextOffset newChangeLength = changeLength + newLength - fTextLength;
+
+	if (newLength == 0)
+	{
+		free(fText);
+		fText = NULL;
+		fTextLength = 0;
+		RecalcLineBreaks();
+		fLineBreaks[0].modified = true;
+		outRedrawLinesStart = outRedrawLinesEnd = 0;
+		TextChanged(changeStart, changeLength, newChangeLength);
+		return;
+	}
+
+	// build the new text in one pass
+	TChar* newText = (TChar *)malloc(newLength * sizeof(TChar));
+	ASSERT(newText);
+
+	TChar* dest = newText;
+	STextOffset copied = 0;
+
+	// fText is NULL while there is no text yet
+	for (i = 0; i < count; i++)
+	{
+		if (ranges[i].start > copied)
+			memcpy(dest, fText + copied, ranges[i].start - copied);
+		dest += ranges[i].start - copied;
+		memcpy(dest, texts[i], lengths[i]);
+		dest += lengths[i];
+		copied = ranges[i].end;
+	}
+
+	if (fTextLength > copied)
+		memcpy(dest, fText + copied, fTextLength - copied);
+
+	STextOffset oldLength = fTextLength;
+	free(fText);
+	fText = newText;
+	fTextLength = newLength;
+
+	if (changesLines)
+	{
+		RecalcRangeLineBreaks(ranges, count, lengths, startLine, changeStart + newChangeLength, outRedrawLinesStart, outRedrawLinesEnd);
+		TextChanged(changeStart, changeLength, newChangeLength);
+		return;
+	}
+
+	// otherwise just shift the line records, measuring only the lines that were edited
+	int32 textDelta = 0;
+	TCoord vertDelta = 0;
+	uint32 range = 0;
+	uint32 lastEditedLine = startLine;
+	LineRec* rec = &fLineBreaks[startLine];
+
+	for (uint32 line = startLine; line < fLineCount; line++, rec++)
+	{
+		STextOffset nextLine = (line < fLineCount - 1 ? rec[1].textOffset : oldLength + 1);
+		bool edited = false;
+
+		rec->textOffset += textDelta;
+		rec->vertOffset += vertDelta;
+		
+		while (range < count && ranges[range].start < nextLine)
+		{
+			textDelta += lengths[range] - (ranges[range].end - ranges[range].start);
+			range++;
+			edited = true;
+		}
+
+		if (edited)
+		{
+			TCoord oldHeight = rec->height;
+			MeasureLine(*rec);
+			rec->modified = true;
+			vertDelta += rec->height - oldHeight;
+			lastEditedLine = line;
+		}
+		else if (range == count && textDelta == 0 && vertDelta == 0)
+			break;
+	}
+
+	outRedrawLinesStart = startLine;
+	outRedrawLinesEnd = lastEditedLine;
+
+	TextChanged(changeStart, changeLength, newChangeLength);
+}
+
+
+// rebuilds the line records from startLine once ReplaceRanges has replaced the text, so line breaks
+// may have come and gone. without line wrap, only the lines next to an edit are measured again.
+// editEnd is where the last replacement ends in the new text.
+void TTextLayout::RecalcRangeLineBreaks(const STextRange* ranges, uint32 count, const STextOffset* lengths, uint32 startLine, STextOffset editEnd,
+										uint32& outRedrawLinesStart, uint32& outRedrawLinesEnd)
+{
+	// the line break ahead of the first edit may have joined up with its replacement
+	if (startLine > 0 && fLineBreaks[startLine].textOffset == ranges[0].start)
+		startLine--;
+
+	// then move the old line records to where their text is now, so they line up with the new lines
+	int32 textDelta = 0;
+	uint32 range = 0;
+	uint32 i;
+
+	for (uint32 line = startLine + 1; line < fLineCount; line++)
+	{
+		LineRec& rec = fLineBreaks[line];
+
+		while (range < count && ranges[range].end <= rec.textOffset)
+		{
+			textDelta += lengths[range] - (ranges[range].end - ranges[range].start);
+			range++;
+		}
+
+		// a line starting inside a replaced range now starts after its replacement
+		if (range < count && ranges[range].start < rec.textOffset)
+			rec.textOffset = ranges[range].start + textDelta + lengths[range];
+		else
+			rec.textOffset += textDelta;
+	}
+
+	if (fLineWrap)
+	{
+		// find the real beginning of the line
+		while (startLine > 0)
+		{
+			TChar ch = fText[fLineBreaks[startLine].textOffset - 1];
+
+			if (ch != '\n' && ch != '\r')
+				startLine--;
+			else
+				break;
+		}
+
+		outRedrawLinesStart = startLine;
+
+		// the old records have been moved already, so the text after the edits is where they say
+		RecalcWrappedLineBreaks(startLine, 0, editEnd, outRedrawLinesEnd);
+	}
+	else
+	{
+		LineRec* oldLineBreaks = fLineBreaks;
+		uint32 oldLineCount = fLineCount;
+		fLineBreaks = (LineRec *)malloc((startLine + 1) * sizeof(LineRec));
+		ASSERT(fLineBreaks);
+		memcpy(fLineBreaks, oldLineBreaks, startLine * sizeof(LineRec));
+		fLineCount = startLine;
+
+		const TChar* textEnd = fText + fTextLength;
+		STextOffset lineStart = oldLineBreaks[startLine].textOffset;
+		TCoord vertOffset = (startLine > 0 ? fLineBreaks[startLine - 1].vertOffset + fLineBreaks[startLine - 1].height : 0);
+		uint32 oldLine = startLine;
+
+		textDelta = 0;
+		range = 0;
+
+		for (;;)
+		{
+			const TChar* nextLine = FindLineBreak(fText + lineStart, textEnd);
+			STextOffset lineEnd = (nextLine ? nextLine - fText : fTextLength);
+
+			while (oldLine + 1 < oldLineCount && oldLineBreaks[oldLine + 1].textOffset <= lineStart)
+				oldLine++;
+
+			const LineRec* oldRec = (oldLineBreaks[oldLine].textOffset == lineStart ? &oldLineBreaks[oldLine] : NULL);
+
+			// skip the replacements that end before the line break ahead of this line
+			while (range < count && ranges[range].start + textDelta + lengths[range] + 1 < lineStart)
+			{
+				textDelta += lengths[range] - (ranges[range].end - ranges[range].start);
+				range++;
+			}
+
+			// past the last replacement the old records only need moving down
+			if (range == count && oldRec)
+			{
+				uint32 tailCount = oldLineCount - oldLine;
+				TCoord vertDelta = vertOffset - oldRec->vertOffset;
+
+				fLineBreaks = (LineRec *)realloc(fLineBreaks, (fLineCount + tailCount) * sizeof(LineRec));
+				ASSERT(fLineBreaks);
+				memcpy(fLineBreaks + fLineCount, oldRec, tailCount * sizeof(LineRec));
+
+				for (i = fLineCount; i < fLineCount + tailCount; i++)
+					fLineBreaks[i].vertOffset += vertDelta;
+
+				fLineCount += tailCount;
+				break;
+			}
+
+			// a replacement touching the line or either of its line breaks may change how it measures
+			bool edited = (range < count && ranges[range].start + textDelta <= lineEnd);
+
+			NewLineBreak(lineStart);
+			LineRec& rec = fLineBreaks[fLineCount - 1];
+
+			if (oldRec && !edited)
+				rec = *oldRec;
+			else
+			{
+				MeasureLine(rec);
+				rec.modified = (oldRec ? oldRec->modified : true);
+			}
+
+			rec.vertOffset = vertOffset;
+			vertOffset += rec.height;
+
+			if (!nextLine)
+				break;
+
+			lineStart = nextLine - fText;
+		}
+
+		outRedrawLinesStart = startLine;
+		outRedrawLinesEnd = (fLineCount != oldLineCount ? fLineCount - 1 : OffsetToLine(editEnd));
+
+		free(oldLineBreaks);
+	}
+
+	// then mark the lines holding the replacements, with line wrap from the real beginning of the line like ReplaceText
+	textDelta = 0;
+
+	for (i = 0; i < count; i++)
+	{
+		STextOffset start = ranges[i].start + textDelta;
+		uint32 line = OffsetToLine(start);
+
+		while (fLineWrap && line > 0)
+		{
+			TChar ch = fText[fLineBreaks[line].textOffset - 1];
+
+			if (ch != '\n' && ch != '\r')
+				line--;
+			else
+				break;
+		}
+
+		MarkModifiedLines(line, OffsetToLine(start + lengths[i]));
+		textDelta += lengths[i] - (ranges[i].end - ranges[i].start);
+	}
+}
+
+
+void TTextLayout::MeasureLine(LineRec& rec)
+{
+	const TChar* text = fText + rec.textOffset;
+	int32 length = fTextLength - rec.textOffset;
+	for (int32 i=0; i<length; i++)
+	{
+		if (text[i] == kLineEnd10 || text[i] == kLineEnd13)
+		{
+			length = i;
+			break;
+		}
+	}	
+
+	if (length)
+	{
+		rec.width = MeasureText(text, length, rec.ascent, rec.height, 0);
+	}
+	else
+	{
+		// height of an empty line
+		fFont->MeasureText("W", 1, rec.ascent, rec.height);
+		rec.width = 0;
+	}
+}
+
+
 void TTextLayout::ComputeContentSize(TPoint& contentSize)
 {
 	TCoord contentWidth = 1;	// minimum one pixel wide for insertion point
@@ -879,13 +1234,23 @@ void TTextLayout::SetLineEndingFormat(TLineEndingFormat format, ShiftTextProc sh
 		// adjust text size again
 		fText = (TChar *)realloc(fText, textLength);
 		ASSERT(fText);
+
+		STextOffset oldLength = fTextLength;
 		fTextLength = textLength;
+		TextChanged(0, oldLength, textLength);
 	}
 
 	fLineEndingFormat = format;
 }
 
 
+void TTextLayout::TextChanged(STextOffset offset, STextOffset oldLength, STextOffset newLength)
+{
+	if (fTextChangedProc)
+		fTextChangedProc(this, offset, oldLength, newLength, fTextChangeClientData);
+}
+
+
 void TTextLayout::NewLineBreak(STextOffset offset)
 {
 	fLineBreaks = (LineRec *)realloc(fLineBreaks, (fLineCount + 1) * sizeof(LineRec));
@@ -899,6 +1264,7 @@ void TTextLayout::NewLineBreak(STextOffset offset)
 	rec.ascent = 0;
 	rec.height = 0;
 	rec.width = 0;
+	rec.modified = false;
 	fLineCount++;
 
 	ASSERT(fMultiLine || fLineCount == 1);
@@ -922,11 +1288,10 @@ void TTextLayout::NewLineBreak(STextOffset offset, TCoord vertOffset, TCoord asc
 
 void TTextLayout::RecalcLineBreaks()
 {
-	if (fLineBreaks)
-	{
-		free(fLineBreaks);
-		fLineBreaks = NULL;
-	}
+	// the old line records are kept until the modified lines are carried over
+	LineRec* oldLineBreaks = fLineBreaks;
+	uint32 oldLineCount = fLineCount;
+	fLineBreaks = NULL;
 	fLineCount = 0;
 
 	bool foundLineBreak = false;
@@ -1064,6 +1429,13 @@ void TTextLayout::RecalcLineBreaks()
 		rec.width = 0;
 		rec.vertOffset = 0;
 	}
+
+	if (oldLineBreaks)
+	{
+		if (oldLineCount > 0)
+			CopyModifiedLines(oldLineBreaks, oldLineCount, 0, 0, 0);
+		free(oldLineBreaks);
+	}
 }
 
 
@@ -1172,6 +1544,9 @@ void TTextLayout::RecalcWrappedLineBreaks(uint32 startLine, int32 textDiff, uint
 	}
 
 	outRedrawLinesEnd = fLineCount - 1;
+
+	// text from the end of the edit on moved by textDiff
+	CopyModifiedLines(oldLineBreaks, oldLineCount, startLine, (textDiff >= 0 ? changeOffset : changeOffset + textDiff), textDiff);
 	
 	if (fLineCount == oldLineCount)
 	{
@@ -1194,6 +1569,101 @@ void TTextLayout::RecalcWrappedLineBreaks(uint32 startLine, int32 textDiff, uint
 }
 
 
+bool TTextLayout::IsLineModified(uint32 line) const
+{
+	ASSERT(line < fLineCount);
+	return fLineBreaks[line].modified;
+}
+
+
+void TTextLayout::ClearModifiedLines()
+{
+	for (uint32 line = 0; line < fLineCount; line++)
+		fLineBreaks[line].modified = false;
+}
+
+
+// finds the first line of the next (or previous) block of modified lines
+bool TTextLayout::FindModifiedLine(uint32 line, bool forward, uint32& outLine) const
+{
+	if (line >= fLineCount)
+		return false;
+
+	if (forward)
+	{
+		// skip the rest of the block we are in
+		while (line < fLineCount && fLineBreaks[line].modified)
+			line++;
+		while (line < fLineCount && !fLineBreaks[line].modified)
+			line++;
+
+		if (line == fLineCount)
+			return false;
+	}
+	else
+	{
+		while (line > 0 && fLineBreaks[line].modified)
+			line--;
+		while (line > 0 && !fLineBreaks[line].modified)
+			line--;
+
+		if (!fLineBreaks[line].modified)
+			return false;
+
+		while (line > 0 && fLineBreaks[line - 1].modified)
+			line--;
+	}
+
+	outLine = line;
+	return true;
+}
+
+
+// marks startLine through endLine and, with line wrap, the rest of the last line's paragraph
+void TTextLayout::MarkModifiedLines(uint32 startLine, uint32 endLine)
+{
+	ASSERT(startLine <= endLine && endLine < fLineCount);
+
+	for (uint32 line = startLine; line <= endLine; line++)
+		fLineBreaks[line].modified = true;
+
+	if (fLineWrap)
+	{
+		for (uint32 line = endLine + 1; line < fLineCount; line++)
+		{
+			TChar ch = fText[fLineBreaks[line].textOffset - 1];
+			if (ch == kLineEnd10 || ch == kLineEnd13)
+				break;
+			
+			fLineBreaks[line].modified = true;
+		}
+	}
+}
+
+
+// sets the modified flags of the line records from startLine on from the records before they were recalculated.
+// text at or after editEnd is at its old offset plus textDelta.
+void TTextLayout::CopyModifiedLines(const LineRec* oldLineBreaks, uint32 oldLineCount, uint32 startLine, STextOffset editEnd, int32 textDelta)
+{
+	uint32 oldLine = (startLine < oldLineCount ? startLine : oldLineCount - 1);
+
+	for (uint32 line = startLine; line < fLineCount; line++)
+	{
+		// lines inside the edit are marked by the caller, but must not map past the lines after it
+		STextOffset offset = fLineBreaks[line].textOffset;
+		if (offset >= editEnd)
+			offset -= textDelta;
+		else if (offset > editEnd - textDelta)
+			offset = editEnd - textDelta;
+
+		while (oldLine + 1 < oldLineCount && oldLineBreaks[oldLine + 1].textOffset <= offset)
+			oldLine++;
+
+		fLineBreaks[line].modified = oldLineBreaks[oldLine].modified;
+	}
+}
+
+
 void TTextLayout::SetLineWrap(bool lineWrap, TCoord width)
 {
 	if (lineWrap != fLineWrap)
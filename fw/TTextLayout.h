@@ -29,11 +29,18 @@ class TTextLayout;
 
 typedef uint32 STextOffset;
 
+struct STextRange
+{
+	STextOffset		start;
+	STextOffset		end;
+};
+
 struct LineRec;
 
 typedef void (* ShiftTextProc)(STextOffset offset, int shift, void* callbackData);
 typedef void (* LinesInsertedProc)(TTextLayout* layout, uint32 line, uint32 count, void* clientData);
 typedef void (* LinesDeletedProc)(TTextLayout* layout, uint32 line, uint32 count, void* clientData);
+typedef void (* TextChangedProc)(TTextLayout* layout, STextOffset offset, STextOffset oldLength, STextOffset newLength, void* clientData);
 
 
 class TTextLayout
@@ -56,12 +63,19 @@ public:
 	TCoord						LineToVertOffset(uint32 line) const;
 	uint32						VertOffsetToLine(TCoord vertOffset) const;
 
+	// returns a malloc'ed array with the text of each line between start and end, excluding line endings
+	STextRange*					GetLineRanges(STextOffset start, STextOffset end, uint32& outCount) const;
+
 	STextOffset					LineToOffset(uint32 line, bool ignoreWrappedLines = false) const;
 	uint32						OffsetToLine(STextOffset offset, bool ignoreWrappedLines = false) const;
 	uint32						OffsetToColumn(STextOffset offset) const;
 
 	void						ReplaceText(STextOffset offset, STextOffset endOffset, const TChar* text, STextOffset length,
 											uint32& outRedrawLinesStart, uint32& outRedrawLinesEnd);
+	void						ReplaceRanges(const STextRange* ranges, uint32 count, const TChar* text, STextOffset length,
+											  uint32& outRedrawLinesStart, uint32& outRedrawLinesEnd);
+	void						ReplaceRanges(const STextRange* ranges, uint32 count, const TChar* const* texts, const STextOffset* lengths,
+											  uint32& outRedrawLinesStart, uint32& outRedrawLinesEnd);
 
 	inline const TChar*			GetText() const { return fText; }
 	inline STextOffset			GetTextLength() const { return fTextLength; }
@@ -94,6 +108,11 @@ public:
 	const TChar*				GetLineEndingString() const;
 	void						SetLineEndingFormat(TLineEndingFormat format, ShiftTextProc shiftTextCallback, void* shiftTextCallbackData);
 	
+	// lines changed since the last call to ClearModifiedLines
+	bool						IsLineModified(uint32 line) const;
+	void						ClearModifiedLines();
+	bool						FindModifiedLine(uint32 line, bool forward, uint32& outLine) const;
+
 	inline bool					HasLineWrap() const { return fLineWrap; }
 	void						SetLineWrap(bool lineWrap, TCoord width);
 	void						SetWidth(TCoord width);
@@ -101,6 +120,11 @@ public:
 	inline void					SetLineChangeCallbacks(LinesInsertedProc insertProc, LinesDeletedProc deleteProc, void* clientData)
 										{ fLinesInsertedProc = insertProc; fLinesDeletedProc = deleteProc; fLineChangeClientData = clientData; }
 
+	// called whenever oldLength characters at offset are replaced by newLength others.
+	// the callback comes after the change, so the layout already holds the new text and lines.
+	inline void					SetTextChangeCallback(TextChangedProc proc, void* clientData)
+										{ fTextChangedProc = proc; fTextChangeClientData = clientData; }
+
 protected:
 	void						NewLineBreak(STextOffset offset);
 	void						NewLineBreak(STextOffset offset, TCoord vertOffset, TCoord ascent, TCoord height, TCoord width);	// this variant fills in values for previous line
@@ -108,10 +132,16 @@ protected:
 	LineRec* 					InsertLineRecs(uint32 line, uint32 count);
 	void						DeleteLineRecs(uint32 line, uint32 count);
 	void						RecalcLineBreaks();
+	void						MeasureLine(LineRec& rec);
 	void						RecalcWrappedLineBreaks(uint32 startLine, int32 textDiff, uint32 changeOffset, uint32& outRedrawLinesEnd);
+	void						RecalcRangeLineBreaks(const STextRange* ranges, uint32 count, const STextOffset* lengths, uint32 startLine, STextOffset editEnd,
+													  uint32& outRedrawLinesStart, uint32& outRedrawLinesEnd);
+	void						MarkModifiedLines(uint32 startLine, uint32 endLine);
+	void						CopyModifiedLines(const LineRec* oldLineBreaks, uint32 oldLineCount, uint32 startLine, STextOffset editEnd, int32 textDelta);
 	LineRec&					GetLineRec(uint32 line, bool ignoreWrappedLines) const;
 
 	void						OffsetLinesBelow(uint32 line, STextOffset textDelta, TCoord vertDelta);
+	void						TextChanged(STextOffset offset, STextOffset oldLength, STextOffset newLength);
 	
 	bool 						BalanceLeft(const TChar* text, STextOffset& outStart, STextOffset& outEnd, TChar balanceChar, bool stopAtLineBreak, bool excludeEdges) const;
 	bool 						BalanceRight(const TChar* text, STextOffset& outStart, STextOffset& outEnd, TChar balanceChar, bool stopAtLineBreak, bool excludeEdges) const;
@@ -135,6 +165,8 @@ protected:
 	LinesInsertedProc			fLinesInsertedProc;
 	LinesDeletedProc			fLinesDeletedProc;
 	void*						fLineChangeClientData;
+	TextChangedProc				fTextChangedProc;
+	void*						fTextChangeClientData;
 };
 
 inline TCoord TTextLayout::MeasureText(const TChar* text, int length, TCoord leftInset) const
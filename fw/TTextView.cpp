@@ -26,6 +26,8 @@
 #include "TTextView.h"
 #include "TTextLayout.h"
 #include "TDrawContext.h"
+#include "TEditJournal.h"
+#include "TLineSorter.h"
 #include "TFont.h"
 #include "TFWCursors.h"
 #include "TMenu.h"
@@ -37,6 +39,7 @@
 #include "TNumericEntryBehavior.h"
 #include "TTopLevelWindow.h"
 #include "TInputContext.h"
+#include "TException.h"
 
 #include "intl.h"
 
@@ -92,6 +95,10 @@ TTextView::TTextView(TWindow* parent, const TRect& bounds, TFont* font, bool mod
 		fFilterTabAndCR(false),
 		fHideInsertionPointWhenNotTarget(false),
 		fCursorHidden(false),
+		fShowModifiedLines(false),
+		fExtraSelections(256),
+		fTrackingColumns(false),
+		fEditJournal(NULL),
 		fMouseTrackingIdler(NULL)
 {
 	ASSERT(font);
@@ -99,6 +106,9 @@ TTextView::TTextView(TWindow* parent, const TRect& bounds, TFont* font, bool mod
 
 	SetIdleFrequency(kCursorBlinkTime);
 
+	// lines are erased before they are drawn, so draw updates offscreen to avoid flicker
+	SetDoubleBuffered(true);
+
 	// assume tab is 4 spaces wide by default
 	int tabLength = (fSpacesPerTab > 0 ? fSpacesPerTab : 4);
 	fLayout = new TTextLayout(font, TPoint(fInset.left, fInset.top), tabLength, multiLine, fLineWrap);
@@ -144,6 +154,7 @@ void TTextView::SetText(TChar* text, STextOffset length, bool ownsData)
 		length = Tstrlen(text);
 
 	fLayout->SetText(text, length, ownsData);
+	fExtraSelections.RemoveAll();
 
 	if (length < fSelectionEnd)
 		fSelectionStart = fSelectionEnd = 0;
@@ -156,7 +167,28 @@ void TTextView::SetText(TChar* text, STextOffset length, bool ownsData)
 
 void TTextView::Draw(TRegion* clip)
 {
-	DoDraw(FirstVisibleLine(), LastVisibleLine(), clip);
+	uint32 startLine = FirstVisibleLine();
+	uint32 endLine = LastVisibleLine();
+
+	// only draw the lines that intersect the update region
+	if (clip)
+	{
+		TRect bounds;
+		clip->GetBounds(bounds);
+		bounds.Offset(fScroll);
+
+		uint32 line = fLayout->VertOffsetToLine(bounds.top);
+		if (line > 0)
+			line--;
+		if (line > startLine)
+			startLine = line;
+
+		line = fLayout->VertOffsetToLine(bounds.bottom);
+		if (line < endLine)
+			endLine = line;
+	}
+
+	DoDraw(startLine, endLine, clip);
 }
 
 
@@ -184,7 +216,8 @@ void TTextView::DoDraw(uint32 startLine, uint32 endLine, TRegion* clip)
 {
 	TDrawContext	context(this, clip);
 
-	DrawTextRange(context, fLayout->LineToOffset(startLine), fLayout->LineToOffset(endLine) + 1, clip);
+	uint32 lastLine = fLayout->OffsetToLine(fLayout->LineToOffset(endLine) + 1);
+	RedrawLines(startLine, lastLine, false, clip);
 	DrawInsertionPoint(context);
 
 	// special case empty text - need to erase a one pixel line
@@ -282,13 +315,23 @@ void TTextView::DoMouseDown(const TPoint& point, TMouseButton button, TModifierS
 		int clickCount = GetClickCount();
 		fTrackingClickCount = clickCount;
 
+		if (!(state & ControlMask) || !fMultiLine)
+			ClearExtraSelections();
+
 		if (clickCount == 1)
 		{
 			STextOffset offset = fLayout->PointToOffset(point);
 
 			fUpDownHorizOffset = -1;
 
-			if (state & ShiftMask)
+			if ((state & ControlMask) && fMultiLine)
+			{
+				// control click adds a caret, control drag selects a rectangle
+				AddSelection(offset, offset);
+				fColumnAnchor = fColumnPoint = point;
+				fTrackingColumns = true;
+			}
+			else if (state & ShiftMask)
 			{
 				if (offset < fSelectionStart)
 				{
@@ -395,6 +438,7 @@ void TTextView::DoMouseUp(const TPoint& point, TMouseButton button, TModifierSta
 	if (button == kLeftButton)
 	{
 		fTrackingClickCount = 0;
+		fTrackingColumns = false;
 		
 		if (fMouseTrackingIdler)
 		{
@@ -413,7 +457,15 @@ void TTextView::DoMouseMoved(const TPoint& point, TModifierState state)
 		fCursorHidden = false;
 	}
 	
-	if (fTrackingClickCount > 0)
+	if (fTrackingColumns)
+	{
+		if (point.h != fColumnPoint.h || point.v != fColumnPoint.v)
+		{
+			fColumnPoint = point;
+			SelectColumns(fColumnAnchor, point);
+		}
+	}
+	else if (fTrackingClickCount > 0)
 	{
 		STextOffset	selectionStart = fSelectionStart;		// initialize to default values in case we don't want to change selection.
 		STextOffset	selectionEnd = fSelectionEnd;
@@ -501,14 +553,14 @@ void TTextView::DoMouseMoved(const TPoint& point, TModifierState state)
 			SetSelection(selectionStart, selectionEnd, false);
 	
 			if (selectionStart < oldStart)
-				DrawTextRange(context, selectionStart, oldStart);
+				InvalidateTextRange(selectionStart, oldStart);
 			else
-				DrawTextRange(context, oldStart, selectionStart);
+				InvalidateTextRange(oldStart, selectionStart);
 				
 			if (selectionEnd > oldEnd)
-				DrawTextRange(context, oldEnd, selectionEnd);
+				InvalidateTextRange(oldEnd, selectionEnd);
 			else
-				DrawTextRange(context, selectionEnd, oldEnd);
+				InvalidateTextRange(selectionEnd, oldEnd);
 
 			// draw insertion point if necessary
 			if (fSelectionStart == fSelectionEnd)
@@ -531,6 +583,9 @@ bool TTextView::DoKeyDown(KeySym key, TModifierState state, const char* string)
 		}
 	}
 
+	if (HasExtraSelections() && DoMultipleSelectionKeyDown(key, state, string))
+		return true;
+
 	// ignore return in single line edit fields
 	// ignore Control and Mod1 keys
 	if (key == XK_Escape ||
@@ -545,22 +600,26 @@ bool TTextView::DoKeyDown(KeySym key, TModifierState state, const char* string)
 	switch (key)
 	{
 		case XK_Left:
-			LeftArrowKey(state);
+			for (int count = 1 + CollectKeyRepeats(); count > 0; count--)
+				LeftArrowKey(state);
 			ScrollSelectionIntoView(true);
 			break;
 
 		case XK_Right:
-			RightArrowKey(state);
+			for (int count = 1 + CollectKeyRepeats(); count > 0; count--)
+				RightArrowKey(state);
 			ScrollSelectionIntoView(true);
 			break;
 
 		case XK_Up:
-			UpArrowKey(state);
+			for (int count = 1 + CollectKeyRepeats(); count > 0; count--)
+				UpArrowKey(state);
 			ScrollSelectionIntoView(true);
 			break;
 			
 		case XK_Down:
-			DownArrowKey(state);
+			for (int count = 1 + CollectKeyRepeats(); count > 0; count--)
+				DownArrowKey(state);
 			ScrollSelectionIntoView(true);
 			break;
 
@@ -585,7 +644,7 @@ bool TTextView::DoKeyDown(KeySym key, TModifierState state, const char* string)
  			if (fModifiable)
 			{
 				HideCursor();
-				Delete((key == XK_Delete), true);
+				Delete((key == XK_Delete), true, 1 + CollectKeyRepeats());
 				ScrollSelectionIntoView();
 			}
 			break;
@@ -609,6 +668,21 @@ bool TTextView::DoKeyDown(KeySym key, TModifierState state, const char* string)
 					else if (key == XK_Tab && fSpacesPerTab > 0 && 
 						(state & ShiftMask) == 0)   // insert a real tab if shift key is pressed
 						InsertTabSpaces();
+					else if (string[1] == 0 && isprint((unsigned char)string[0]))
+					{
+						// a held down key is inserted as one edit with one redraw
+						int count = 1 + CollectKeyRepeats();
+
+						if (count > 1)
+						{
+							char* repeatString = new char[count];
+							memset(repeatString, string[0], count);
+							ReplaceSelection(repeatString, count, true, true, true);
+							delete[] repeatString;
+						}
+						else
+							ReplaceSelection(string, 1, true, true, true);
+					}
 					else
 						ReplaceSelection(string, strlen(string), true, true, true);
 
@@ -623,6 +697,77 @@ bool TTextView::DoKeyDown(KeySym key, TModifierState state, const char* string)
 }
 
 
+// typing, deleting and moving apply to all the selections at once
+bool TTextView::DoMultipleSelectionKeyDown(KeySym key, TModifierState state, const char* string)
+{
+	// menu shortcuts are left to DoCommand
+	if (IsModifierKey(key) ||
+		((state & (ControlMask | Mod1Mask)) && key != XK_Left && key != XK_Right && key != XK_Up && key != XK_Down))
+		return false;
+
+	switch (key)
+	{
+		case XK_Escape:
+			ClearExtraSelections();
+			return true;
+
+		case XK_Left:
+		case XK_Right:
+			if (state & (ShiftMask | ControlMask | Mod1Mask))
+				break;
+			MoveSelections(key == XK_Right, 1 + CollectKeyRepeats());
+			ScrollSelectionIntoView(true);
+			return true;
+
+		case XK_BackSpace:
+		case XK_Delete:
+			if (!fModifiable)
+				break;
+			HideCursor();
+			DeleteSelections(key == XK_Delete, 1 + CollectKeyRepeats());
+			ScrollSelectionIntoView();
+			return true;
+
+		default:
+			if (!fModifiable || !string[0] || (fFilterTabAndCR && (key == XK_Tab || key == XK_Return || key == XK_KP_Enter)))
+				break;
+
+			HideCursor();
+
+			if (string[0] == kLineEnd10 || string[0] == kLineEnd13)
+			{
+				const TChar* lineEnding = fLayout->GetLineEndingString();
+				ReplaceSelections(lineEnding, strlen(lineEnding), false);
+			}
+			else if (string[1] == 0 && isprint((unsigned char)string[0]))
+			{
+				int count = 1 + CollectKeyRepeats();
+				char* repeatString = new char[count];
+				memset(repeatString, string[0], count);
+				ReplaceSelections(repeatString, count, true);
+				delete[] repeatString;
+			}
+			else
+				ReplaceSelections(string, strlen(string), true);
+
+			ScrollSelectionIntoView();
+			return true;
+	}
+
+	// anything else only applies to the main selection
+	ClearExtraSelections();
+	return false;
+}
+
+
+// removes queued auto-repeats of the key being handled and returns how many there were
+int TTextView::CollectKeyRepeats()
+{
+	TTopLevelWindow* topLevel = GetTopLevelWindow();
+	return (topLevel ? topLevel->CollectKeyRepeats() : 0);
+}
+
+
 bool TTextView::IsTargetable() const
 {
 	return true;
@@ -749,8 +894,15 @@ void TTextView::InsertTabSpaces()
 
 void TTextView::InsertText(STextOffset location, const TChar* text, STextOffset length, UndoType undoType)
 {
+	ClearExtraSelections();
 	SaveUndoMouseCopy(location, length, undoType);
 
+	if (fEditJournal)
+		fEditJournal->RecordEdit(location, 0, text, length);
+
+	LineEdit lineEdit;
+	bool lineEditOnly = BeginLineEdit(location, location, text, length, lineEdit);
+
 	uint32 redrawStart, redrawEnd;
 	fLayout->ReplaceText(location, location, text, length, redrawStart, redrawEnd);
 
@@ -758,7 +910,7 @@ void TTextView::InsertText(STextOffset location, const TChar* text, STextOffset
 		SetSelection(location + length);
 	ComputeContentSize();
 
-	if (IsVisible())
+	if (IsVisible() && !(lineEditOnly && InvalidateLineEdit(lineEdit, location, location + length)))
 	{
 		uint32 firstVisible = FirstVisibleLine();
 		uint32 lastVisible = LastVisibleLine();
@@ -768,7 +920,7 @@ void TTextView::InsertText(STextOffset location, const TChar* text, STextOffset
 		if (redrawEnd > lastVisible)
 			redrawEnd = lastVisible;
 	
-		RedrawLines(redrawStart, redrawEnd, true);
+		InvalidateLines(redrawStart, redrawEnd, true);
 	}
 
 	HandleCommand(this, this, kDataModifiedCommandID);
@@ -777,20 +929,29 @@ void TTextView::InsertText(STextOffset location, const TChar* text, STextOffset
 
 void TTextView::ReplaceSelection(const TChar* text, STextOffset length, bool saveUndo, bool selectAfter, bool accumulateTyping)
 {
+	ClearExtraSelections();
+
 	if (saveUndo)
 		SaveUndo(fSelectionStart, fSelectionStart + length, accumulateTyping, false);
 
+	if (fEditJournal)
+		fEditJournal->RecordEdit(fSelectionStart, fSelectionEnd - fSelectionStart, text, length);
+
+	STextOffset start = fSelectionStart;
+	LineEdit lineEdit;
+	bool lineEditOnly = BeginLineEdit(start, fSelectionEnd, text, length, lineEdit);
+
 	uint32 redrawStart, redrawEnd;
-	fLayout->ReplaceText(fSelectionStart, fSelectionEnd, text, length, redrawStart, redrawEnd);
+	fLayout->ReplaceText(start, fSelectionEnd, text, length, redrawStart, redrawEnd);
 
 	if (selectAfter)
-		SetSelection(fSelectionStart + length, fSelectionStart + length, false);
+		SetSelection(start + length, start + length, false);
 	else
-		SetSelection(fSelectionStart, fSelectionStart + length, false);
+		SetSelection(start, start + length, false);
 
 	ComputeContentSize();
 
-	if (IsVisible())
+	if (IsVisible() && !(lineEditOnly && InvalidateLineEdit(lineEdit, start, start + length)))
 	{
 		uint32 firstVisible = FirstVisibleLine();
 		uint32 lastVisible = LastVisibleLine();
@@ -800,7 +961,7 @@ void TTextView::ReplaceSelection(const TChar* text, STextOffset length, bool sav
 		if (redrawEnd > lastVisible)
 			redrawEnd = lastVisible;
 	
-		RedrawLines(redrawStart, redrawEnd, true);
+		InvalidateLines(redrawStart, redrawEnd, true);
 	}
 	
 	fAccumulateTyping = accumulateTyping;
@@ -809,18 +970,33 @@ void TTextView::ReplaceSelection(const TChar* text, STextOffset length, bool sav
 }
 
 
-void TTextView::Delete(bool forward, bool accumulateDeletion)
+void TTextView::Delete(bool forward, bool accumulateDeletion, int count)
 {	
-	if (fSelectionStart == fSelectionEnd)
+	ClearExtraSelections();
+
+	// a selection counts as the first deletion, the rest extend past its edge
+	// so everything is removed in one edit with one undo record
+	if (fSelectionStart != fSelectionEnd)
+		count--;
+
+	for (; count > 0; count--)
 	{
-		if (forward && fSelectionStart < GetTextLength())
+		if (forward && fSelectionEnd < GetTextLength())
 			fLayout->NextCharacter(fSelectionEnd);
 		else if (!forward && fSelectionStart > 0)
 			fLayout->PreviousCharacter(fSelectionStart);
+		else
+			break;
 	}
 
 	SaveUndo(fSelectionStart, fSelectionStart, false, accumulateDeletion);
 
+	if (fEditJournal)
+		fEditJournal->RecordEdit(fSelectionStart, fSelectionEnd - fSelectionStart, "", 0);
+
+	LineEdit lineEdit;
+	bool lineEditOnly = BeginLineEdit(fSelectionStart, fSelectionEnd, "", 0, lineEdit);
+
 	uint32 redrawStart, redrawEnd;
 	fLayout->ReplaceText(fSelectionStart, fSelectionEnd, "", 0, redrawStart, redrawEnd);
 	
@@ -828,7 +1004,7 @@ void TTextView::Delete(bool forward, bool accumulateDeletion)
 
 	ComputeContentSize();
 
-	if (IsVisible())
+	if (IsVisible() && !(lineEditOnly && InvalidateLineEdit(lineEdit, fSelectionStart, fSelectionStart)))
 	{
 		uint32 firstVisible = FirstVisibleLine();
 		uint32 lastVisible = LastVisibleLine();
@@ -838,7 +1014,7 @@ void TTextView::Delete(bool forward, bool accumulateDeletion)
 		if (redrawEnd > lastVisible)
 			redrawEnd = lastVisible;
 	
-		RedrawLines(redrawStart, redrawEnd, true);
+		InvalidateLines(redrawStart, redrawEnd, true);
 	}
 
 	fAccumulateDeletion = accumulateDeletion;
@@ -847,6 +1023,284 @@ void TTextView::Delete(bool forward, bool accumulateDeletion)
 }
 
 
+void TTextView::AddSelection(STextOffset start, STextOffset end)
+{
+	TDynamicArray<STextRange> selections(256);
+	uint32 mainIndex;
+	GetSelections(selections, mainIndex);
+
+	// the new selection becomes the main one and replaces any it touches
+	fExtraSelections.RemoveAll();
+	for (uint32 i = 0; i < selections.GetSize(); i++)
+	{
+		STextRange& range = selections[i];
+		if (range.end < start || end < range.start)
+			fExtraSelections.InsertLast(range);
+	}
+
+	SetSelection(start, end, false);
+	Redraw();
+}
+
+
+void TTextView::ClearExtraSelections()
+{
+	if (HasExtraSelections())
+	{
+		fExtraSelections.RemoveAll();
+		if (IsVisible())
+			Redraw();
+	}
+}
+
+
+void TTextView::SelectColumns(const TPoint& anchor, const TPoint& point)
+{
+	TCoord left = (anchor.h < point.h ? anchor.h : point.h);
+	TCoord right = (anchor.h < point.h ? point.h : anchor.h);
+	uint32 anchorLine = fLayout->VertOffsetToLine(anchor.v);
+	uint32 pointLine = fLayout->VertOffsetToLine(point.v);
+	uint32 startLine = (anchorLine < pointLine ? anchorLine : pointLine);
+	uint32 endLine = (anchorLine < pointLine ? pointLine : anchorLine);
+
+	// one selection per line, the line under the mouse is the main one
+	STextRange main = { 0, 0 };
+	fExtraSelections.RemoveAll();
+
+	for (uint32 line = startLine; line <= endLine; line++)
+	{
+		TCoord v = fLayout->LineToVertOffset(line);
+		STextRange range;
+		range.start = fLayout->PointToOffset(TPoint(left, v));
+		range.end = fLayout->PointToOffset(TPoint(right, v));
+
+		if (line == pointLine)
+			main = range;
+		else
+			fExtraSelections.InsertLast(range);
+	}
+
+	SetSelection(main.start, main.end, false);
+	Redraw();
+	ScrollSelectionIntoView(true);
+}
+
+
+void TTextView::GetSelections(TDynamicArray<STextRange>& selections, uint32& outMainIndex) const
+{
+	STextRange main;
+	main.start = fSelectionStart;
+	main.end = fSelectionEnd;
+
+	uint32 count = fExtraSelections.GetSize();
+	uint32 i = 0;
+
+	while (i < count && fExtraSelections[i].start < main.start)
+		selections.InsertLast(fExtraSelections[i++]);
+
+	outMainIndex = selections.GetSize();
+	selections.InsertLast(main);
+
+	while (i < count)
+		selections.InsertLast(fExtraSelections[i++]);
+}
+
+
+void TTextView::GetSelectionsText(TString& string)
+{
+	TDynamicArray<STextRange> selections(256);
+	uint32 mainIndex;
+	GetSelections(selections, mainIndex);
+
+	const TChar* text = GetText();
+	const TChar* lineEnding = fLayout->GetLineEndingString();
+	string.SetEmpty();
+
+	for (uint32 i = 0; i < selections.GetSize(); i++)
+	{
+		STextRange& range = selections[i];
+		if (range.start == range.end)
+			continue;
+
+		if (string.GetLength() > 0)
+			string += lineEnding;
+		string.Append(text + range.start, range.end - range.start);
+	}
+}
+
+
+void TTextView::ReplaceSelections(const TChar* text, STextOffset length, bool accumulateTyping)
+{
+	TDynamicArray<STextRange> selections(256);
+	uint32 mainIndex;
+	GetSelections(selections, mainIndex);
+
+	ReplaceRanges(selections, mainIndex, text, length, accumulateTyping);
+}
+
+
+void TTextView::DeleteSelections(bool forward, int count)
+{
+	TDynamicArray<STextRange> selections(256);
+	uint32 mainIndex;
+	GetSelections(selections, mainIndex);
+
+	// carets delete the characters next to them and selections count as the first deletion,
+	// which may make neighbouring ranges overlap
+	TDynamicArray<STextRange> ranges(256);
+	uint32 rangesMainIndex = 0;
+	STextOffset textLength = GetTextLength();
+
+	for (uint32 i = 0; i < selections.GetSize(); i++)
+	{
+		STextRange range = selections[i];
+
+		for (int j = (range.start == range.end ? 0 : 1); j < count; j++)
+		{
+			if (forward && range.end < textLength)
+				fLayout->NextCharacter(range.end);
+			else if (!forward && range.start > 0)
+				fLayout->PreviousCharacter(range.start);
+			else
+				break;
+		}
+
+		if (ranges.GetSize() > 0 && range.start < ranges.Last().end)
+		{
+			STextRange& last = ranges.Last();
+			if (range.end > last.end)
+				last.end = range.end;
+		}
+		else
+			ranges.InsertLast(range);
+
+		if (i == mainIndex)
+			rangesMainIndex = ranges.GetSize() - 1;
+	}
+
+	ReplaceRanges(ranges, rangesMainIndex, "", 0, false);
+}
+
+
+void TTextView::MoveSelections(bool forward, int count)
+{
+	TDynamicArray<STextRange> selections(256);
+	uint32 mainIndex;
+	GetSelections(selections, mainIndex);
+
+	STextOffset textLength = GetTextLength();
+	STextOffset mainCaret = 0;
+	fExtraSelections.RemoveAll();
+
+	for (uint32 i = 0; i < selections.GetSize(); i++)
+	{
+		// like the arrow keys, a range collapses to its start or end
+		STextRange& range = selections[i];
+		STextOffset caret;
+
+		if (range.start < range.end)
+			caret = (forward ? range.end : range.start);
+		else
+		{
+			caret = range.start;
+			for (int j = 0; j < count; j++)
+			{
+				if (forward && caret < textLength)
+					fLayout->NextCharacter(caret);
+				else if (!forward && caret > 0)
+					fLayout->PreviousCharacter(caret);
+			}
+		}
+
+		if (i == mainIndex)
+			mainCaret = caret;
+		else if (fExtraSelections.GetSize() == 0 || fExtraSelections.Last().start != caret)
+		{
+			STextRange newRange = { caret, caret };
+			fExtraSelections.InsertLast(newRange);
+		}
+	}
+
+	// drop an extra caret that ran into the main one
+	for (uint32 i = 0; i < fExtraSelections.GetSize(); i++)
+	{
+		if (fExtraSelections[i].start == mainCaret)
+		{
+			fExtraSelections.RemoveAt(i);
+			break;
+		}
+	}
+
+	SetSelection(mainCaret, mainCaret, false);
+	Redraw();
+}
+
+
+// replaces each of the sorted, non-overlapping ranges with text as a single edit
+void TTextView::ReplaceRanges(const TDynamicArray<STextRange>& ranges, uint32 mainIndex, const TChar* text, STextOffset length, bool accumulateTyping)
+{
+	uint32 count = ranges.GetSize();
+	ASSERT(count > 0 && mainIndex < count);
+
+	STextOffset mainCaret = 0;
+	STextOffset shift = 0;
+
+	for (uint32 i = 0; i <= mainIndex; i++)
+	{
+		mainCaret = ranges[i].start + shift + length;
+		shift += length - (ranges[i].end - ranges[i].start);
+	}
+
+	SaveUndoRanges(ranges, length, mainCaret, accumulateTyping);
+
+	if (fEditJournal)
+	{
+		for (uint32 i = count; i > 0; i--)
+			fEditJournal->RecordEdit(ranges[i - 1].start, ranges[i - 1].end - ranges[i - 1].start, text, length);
+	}
+
+	uint32 redrawStart, redrawEnd;
+	fLayout->ReplaceRanges(&ranges[0], count, text, length, redrawStart, redrawEnd);
+
+	// every selection becomes a caret after its replacement
+	fExtraSelections.RemoveAll();
+	shift = 0;
+
+	for (uint32 i = 0; i < count; i++)
+	{
+		STextOffset caret = ranges[i].start + shift + length;
+		shift += length - (ranges[i].end - ranges[i].start);
+
+		if (i != mainIndex && caret != mainCaret &&
+			(fExtraSelections.GetSize() == 0 || fExtraSelections.Last().start != caret))
+		{
+			STextRange range = { caret, caret };
+			fExtraSelections.InsertLast(range);
+		}
+	}
+
+	SetSelection(mainCaret, mainCaret, false);
+	ComputeContentSize();
+
+	if (IsVisible())
+	{
+		uint32 firstVisible = FirstVisibleLine();
+		uint32 lastVisible = LastVisibleLine();
+		
+		if (redrawStart < firstVisible)
+			redrawStart = firstVisible;
+		if (redrawEnd > lastVisible)
+			redrawEnd = lastVisible;
+	
+		InvalidateLines(redrawStart, redrawEnd, true);
+	}
+
+	fAccumulateTyping = accumulateTyping;
+
+	HandleCommand(this, this, kDataModifiedCommandID);
+}
+
+
 void TTextView::ShiftSelectionLeft()
 {
 	ExtendSelectionToLines();
@@ -958,48 +1412,150 @@ void TTextView::ExtendSelectionToLines()
 }
 
 
-bool TTextView::FindString(const TChar* searchString, bool caseSensitive, bool forward, bool wrap, bool wholeWord)
+void TTextView::SortLines(int flags, int column)
 {
-	const TChar* text = GetText();
-	STextOffset textLength = GetTextLength();
-	STextOffset searchLength = Tstrlen(searchString);
-	ASSERT(searchLength > 0);
+	uint32 count;
+	STextRange* lines = GetSelectedLines(count);
 
-	if (searchLength > textLength)
-		return false;
+	TLineSorter sorter(GetText(), flags, column);
+	sorter.Sort(lines, count);
+	ReplaceSelectedLines(lines, count);
 
-	STextOffset start;
+	free(lines);
+}
 
-	if (forward)
+
+void TTextView::UniqueLines()
+{
+	uint32 count;
+	STextRange* lines = GetSelectedLines(count);
+
+	uint32 newCount = TLineSorter::Unique(GetText(), lines, count);
+	if (newCount < count)
+		ReplaceSelectedLines(lines, newCount);
+
+	free(lines);
+}
+
+
+void TTextView::FilterLines(const TChar* pattern, bool keepMatches)
+{
+	uint32 count;
+	STextRange* lines = GetSelectedLines(count);
+
+	uint32 newCount;
+
+	try
 	{
-		start = fSelectionEnd;
+		newCount = TLineSorter::Filter(GetText(), lines, count, pattern, keepMatches);
 	}
-	else
+	catch (TProgramError*)
 	{
-		start = fSelectionStart;
+		// a bad pattern is reported by the event loop
+		free(lines);
+		throw;
 	}
-		
-	STextOffset offset = start;
-	bool wrappedOnce = false;
-	bool firstTime = true;
 
-	while (1)
-	{
-		if (forward)
-		{
-			if (!firstTime)
-				fLayout->NextCharacter(offset);
+	if (newCount < count)
+		ReplaceSelectedLines(lines, newCount);
 
-			if (offset + searchLength - 1 >= textLength)
-			{
-				if (wrap && !wrappedOnce)
-				{
-					offset = 0;
-					wrappedOnce = true;
-				}
-				else
-					break;
-			}
+	free(lines);
+}
+
+
+STextRange* TTextView::GetSelectedLines(uint32& outCount)
+{
+	if (fSelectionStart == fSelectionEnd)
+		SetSelection(0, GetTextLength());
+	else
+		ExtendSelectionToLines();
+
+	return fLayout->GetLineRanges(fSelectionStart, fSelectionEnd, outCount);
+}
+
+
+// replaces the selection with lines, which point into the current text, as one edit
+void TTextView::ReplaceSelectedLines(const STextRange* lines, uint32 count)
+{
+	const TChar* text = GetText();
+	const TChar* lineEnding = fLayout->GetLineEndingString();
+	STextOffset lineEndingLength = Tstrlen(lineEnding);
+
+	// keep the line ending after the last line only if there was one before
+	bool trailingLineEnd = (fSelectionStart < fSelectionEnd &&
+							(text[fSelectionEnd - 1] == kLineEnd10 || text[fSelectionEnd - 1] == kLineEnd13));
+
+	STextOffset length = 0;
+	for (uint32 i = 0; i < count; i++)
+		length += lines[i].end - lines[i].start + lineEndingLength;
+	if (count > 0 && !trailingLineEnd)
+		length -= lineEndingLength;
+
+	TChar* newText = (TChar *)malloc((length > 0 ? length : 1) * sizeof(TChar));
+	ASSERT(newText);
+	TChar* dest = newText;
+
+	for (uint32 i = 0; i < count; i++)
+	{
+		STextOffset lineLength = lines[i].end - lines[i].start;
+		memcpy(dest, text + lines[i].start, lineLength * sizeof(TChar));
+		dest += lineLength;
+
+		if (i < count - 1 || trailingLineEnd)
+		{
+			memcpy(dest, lineEnding, lineEndingLength * sizeof(TChar));
+			dest += lineEndingLength;
+		}
+	}
+
+	ASSERT(dest == newText + length);
+	ReplaceSelection(newText, length, true, false);
+	free(newText);
+}
+
+
+bool TTextView::FindString(const TChar* searchString, bool caseSensitive, bool forward, bool wrap, bool wholeWord)
+{
+	const TChar* text = GetText();
+	STextOffset textLength = GetTextLength();
+	STextOffset searchLength = Tstrlen(searchString);
+	ASSERT(searchLength > 0);
+
+	if (searchLength > textLength)
+		return false;
+
+	STextOffset start;
+
+	if (forward)
+	{
+		start = fSelectionEnd;
+	}
+	else
+	{
+		start = fSelectionStart;
+	}
+		
+	STextOffset offset = start;
+	bool wrappedOnce = false;
+	bool firstTime = true;
+
+	while (1)
+	{
+		if (forward)
+		{
+			if (!firstTime)
+				fLayout->NextCharacter(offset);
+
+			if (offset + searchLength - 1 >= textLength)
+			{
+				if (wrap && !wrappedOnce)
+				{
+					offset = 0;
+					wrappedOnce = true;
+				}
+				else
+					break;
+			}
 		}
 		else
 		{
@@ -1518,7 +2074,7 @@ void TTextView::SelectLine(uint32 line)
 }
 
 
-void TTextView::DrawTextRange(TDrawContext& context, STextOffset startOffset, STextOffset endOffset, TRegion* clip)
+void TTextView::InvalidateTextRange(STextOffset startOffset, STextOffset endOffset)
 {
 	ASSERT(startOffset <= endOffset);
 	if (startOffset == endOffset)
@@ -1527,7 +2083,200 @@ void TTextView::DrawTextRange(TDrawContext& context, STextOffset startOffset, ST
 	uint32	startLine = fLayout->OffsetToLine(startOffset);
 	uint32	endLine = fLayout->OffsetToLine(endOffset);
 	
-	RedrawLines(startLine, endLine, false, clip);
+	InvalidateLines(startLine, endLine, false);
+}
+
+
+// the lines are drawn by the next TWindow::ProcessUpdates, 
+// so several edits in one pass through the event loop only draw once
+void TTextView::InvalidateLines(uint32 startLine, uint32 endLine, bool showInsertionPoint)
+{
+	uint32 lineCount = fLayout->GetLineCount();
+
+	if (lineCount > 0 && startLine < lineCount)
+	{
+		if (endLine >= lineCount)
+			endLine = lineCount - 1;
+
+		TRect	border;
+		GetScrollableBounds(border);
+		border.Offset(fScroll);
+
+		// full width, to include the margin and the area past the end of the lines
+		TRect	r(border.left, fLayout->LineToVertOffset(startLine), border.right, 
+				  fLayout->LineToVertOffset(endLine) + fLayout->GetLineHeight(endLine));
+		r.IntersectWith(border);
+		Invalidate(r);
+	}
+
+	if (showInsertionPoint)
+		InvalidateInsertionPoint();
+}
+
+
+void TTextView::InvalidateInsertionPoint()
+{
+	// the insertion point is drawn along with the text
+	fInsertionPointOn = true;
+	if (IdlingEnabled())
+		Sleep(kCursorBlinkTime);	// reset idle timer
+
+	if (fSelectionStart == fSelectionEnd)
+	{
+		TPoint p;
+		uint32 line = fLayout->OffsetToPoint(fSelectionStart, p);
+		Invalidate(TRect(p.h - 1, p.v - fLayout->GetLineAscent(line), p.h, p.v));
+	}
+}
+
+
+// called before replacing start..end with text.
+// returns true if the edit stays within one visible line, 
+// so InvalidateLineEdit can move the rest of the line instead of redrawing it.
+bool TTextView::BeginLineEdit(STextOffset start, STextOffset end, const TChar* text, STextOffset length, LineEdit& edit)
+{
+	// the selection and the insertion point must not be drawn in the part that moves
+	if (!IsVisible() || fObscured || fLayout->HasLineWrap() || fExtraSelections.GetSize() > 0 ||
+		fSelectionStart < start || fSelectionEnd > end || !CanMoveLineTail(start, end, text, length))
+		return false;
+
+	edit.fLine = fLayout->OffsetToLine(start);
+	if (edit.fLine < FirstVisibleLine() || edit.fLine > LastVisibleLine())
+		return false;
+
+	TPoint p;
+	fLayout->OffsetToPoint(end, p);
+	edit.fTailH = p.h;
+
+	TRect r;
+	fLayout->GetLineBounds(edit.fLine, r);
+	edit.fRight = r.right;
+	edit.fHeight = r.GetHeight();
+
+	return true;
+}
+
+
+// start..end is the new text of an edit started with BeginLineEdit.
+// only the characters around the edit are redrawn.  the text after them is copied
+// to its new position, so typing in a long line does not redraw the rest of it.
+bool TTextView::InvalidateLineEdit(const LineEdit& edit, STextOffset start, STextOffset end)
+{
+	if (fSelectionStart < start || fSelectionEnd > end)
+		return false;
+
+	uint32 line = fLayout->OffsetToLine(start);
+	if (line != edit.fLine || fLayout->GetLineHeight(line) != edit.fHeight)
+		return false;
+
+	const TChar* text;
+	STextOffset lineLength;
+	TCoord vertOffset, ascent, height;	
+	fLayout->GetLine(line, text, lineLength, vertOffset, ascent, height);
+	STextOffset lineStart = fLayout->LineToOffset(line);
+
+	TPoint p;
+	fLayout->OffsetToPoint(end, p);
+	TCoord delta = p.h - edit.fTailH;
+
+	// tabs after the edit only keep their width if it moves by whole tab stops
+	TCoord tabWidth = fLayout->GetTabWidth();
+	bool move = (delta != 0);
+	if (move && tabWidth > 0 && delta % tabWidth != 0 && 
+		memchr(text + (end - lineStart), '\t', lineLength - (end - lineStart)))
+		move = false;
+
+	ExtendLineEditDamage(start, end);
+
+	TRect lineBounds;
+	fLayout->GetLineBounds(line, lineBounds);
+
+	TRect	border;
+	GetScrollableBounds(border);
+	border.Offset(fScroll);
+
+	fLayout->OffsetToPoint(start, p);
+	TCoord left = p.h - 1;		// include the insertion point before the edit
+	TCoord right = (lineBounds.right > edit.fRight ? lineBounds.right : edit.fRight);
+
+	fLayout->OffsetToPoint(end, p);
+	TCoord tailH = p.h;
+
+	TRect	damage(left, lineBounds.top, (delta == 0 ? tailH : right), lineBounds.bottom);
+
+	if (move)
+	{
+		// the part of the old line that is still visible once it has moved
+		TRect	dest(tailH, lineBounds.top, edit.fRight + delta, lineBounds.bottom);
+		dest.IntersectWith(border);
+		TRect	src(dest);
+		src.Offset(-delta, 0);
+		src.IntersectWith(border);
+		dest = src;
+		dest.Offset(delta, 0);
+
+		if (!src.IsEmpty())
+		{
+			src.Offset(-fScroll.h, -fScroll.v);
+			dest.Offset(-fScroll.h, -fScroll.v);
+
+			// damage not drawn yet moves along with the pixels we copy
+			if (fUpdateRegion)
+			{
+				TRegion	moved(src);
+				moved.Intersect(fUpdateRegion);
+				moved.Offset(delta, 0);
+				fUpdateRegion->Union(&moved);
+			}
+
+			TDrawContext	context(this);
+			context.CopyRect(this, src, TPoint(dest.left, dest.top), false);
+
+			dest.Offset(fScroll);
+			damage.right = dest.left;
+
+			TRect	r(dest.right, lineBounds.top, right, lineBounds.bottom);
+			r.IntersectWith(border);
+			if (!r.IsEmpty())
+				Invalidate(r);
+		}
+	}
+
+	damage.IntersectWith(border);
+	if (!damage.IsEmpty())
+		Invalidate(damage);
+
+	if (fShowModifiedLines)
+	{
+		TRect	margin(0, lineBounds.top, fInset.left, lineBounds.bottom);
+		margin.IntersectWith(border);
+		if (!margin.IsEmpty())
+			Invalidate(margin);
+	}
+
+	InvalidateInsertionPoint();
+	return true;
+}
+
+
+bool TTextView::CanMoveLineTail(STextOffset start, STextOffset end, const TChar* text, STextOffset length) const
+{
+	const TChar* oldText = GetText() + start;
+
+	for (STextOffset i = 0; i < end - start; i++)
+		if (oldText[i] == '\n' || oldText[i] == '\r')
+			return false;
+
+	for (STextOffset i = 0; i < length; i++)
+		if (text[i] == '\n' || text[i] == '\r')
+			return false;
+
+	return true;
+}
+
+
+void TTextView::ExtendLineEditDamage(STextOffset& ioStart, STextOffset& ioEnd) const
+{
 }
 
 void TTextView::DrawLine(uint32 line, TDrawContext& context, TCoord rightEdge)
@@ -1541,14 +2290,25 @@ void TTextView::DrawLine(uint32 line, TDrawContext& context, TCoord rightEdge)
 	STextOffset lineStart = fLayout->LineToOffset(line);
 	STextOffset lineEnd = lineStart + lineLength;
 
-	bool hilited = (fSelectionStart <= lineStart && lineStart < fSelectionEnd);
-	if (context.GetDepth() < 8)
+	if (fShowModifiedLines)
 	{
-		context.SetForeColor(hilited ? fBackColor : fForeColor);
-		context.SetBackColor(hilited ? fForeColor : fBackColor);		
+		TRect margin(0, vertOffset + fInset.top, fInset.left - 1, vertOffset + fInset.top + height);
+
+		if (fLayout->IsLineModified(line))
+		{
+			context.SetForeColor(kOrangeColor);
+			context.PaintRect(margin);
+		}
+		else
+		{
+			context.SetBackColor(fBackColor);
+			context.EraseRect(margin);
+		}
 	}
-	else
-		context.SetBackColor(hilited ? gApplication->GetHiliteColor() : fBackColor);
+
+	STextOffset selectionStart, selectionEnd;
+	bool hilited = (NextSelection(lineStart, lineStart + 1, selectionStart, selectionEnd) && selectionStart == lineStart);
+	SetTextColors(context, hilited);
 		
 	context.MoveTo(fInset.left, vertOffset + ascent + fInset.top);
 
@@ -1557,46 +2317,106 @@ void TTextView::DrawLine(uint32 line, TDrawContext& context, TCoord rightEdge)
 	TRect	r(context.GetPen().h - 1, top, context.GetPen().h, top + fLayout->GetLineHeight(line));
 	context.EraseRect(r);
 	
-	if (lineLength > 0)
-	{		
-		if (fSelectionStart == fSelectionEnd || fSelectionStart >= lineEnd || fSelectionEnd <= lineStart)
-		{
-			DrawText(text, lineLength, context);
-		}
-		else
+	// draw the line in runs that are either entirely inside or outside the selections
+	STextOffset offset = lineStart;
+	while (offset < lineEnd)
+	{
+		STextOffset runEnd = lineEnd;
+		bool selected = false;
+
+		if (NextSelection(offset, lineEnd, selectionStart, selectionEnd))
 		{
-			int32 length = fSelectionStart - lineStart;
-			if (length > 0)
+			if (selectionStart > offset)
+				runEnd = selectionStart;
+			else
 			{
-				DrawText(text, length, context);
-				lineStart = fSelectionStart;
-				text += length;
-				
-				if (context.GetDepth() < 8)
-				{
-					context.SetForeColor(fBackColor);
-					context.SetBackColor(fForeColor);
-				}
-				else
-					context.SetBackColor(gApplication->GetHiliteColor());
+				selected = true;
+				if (selectionEnd < lineEnd)
+					runEnd = selectionEnd;
 			}
+		}
+
+		if (selected != hilited)
+		{
+			SetTextColors(context, selected);
+			hilited = selected;
+		}
+
+		DrawText(text + (offset - lineStart), runEnd - offset, context);
+		offset = runEnd;
+	}
+
+	// a selection that stops at the end of the line does not extend to the right edge
+	if (hilited && lineLength > 0 && selectionEnd == lineEnd)
+		SetTextColors(context, false);
+
+	EraseRightEdge(line, context, rightEdge, lineEnd);
+}
+
+
+void TTextView::SetTextColors(TDrawContext& context, bool hilited)
+{
+	if (context.GetDepth() < 8)
+	{
+		context.SetForeColor(hilited ? fBackColor : fForeColor);
+		context.SetBackColor(hilited ? fForeColor : fBackColor);		
+	}
+	else
+	{
+		context.SetForeColor(fForeColor);
+		context.SetBackColor(hilited ? gApplication->GetHiliteColor() : fBackColor);
+	}
+}
+
 
-			STextOffset end = (lineEnd < fSelectionEnd ? lineEnd : fSelectionEnd);
-			length = end - lineStart;
-			DrawText(text, length, context);
-			lineStart = end;
-			text += length;
+// finds the first non-empty selection ending after offset and starting before limit,
+// clipped to start no earlier than offset
+bool TTextView::NextSelection(STextOffset offset, STextOffset limit, STextOffset& outStart, STextOffset& outEnd) const
+{
+	bool found = false;
+
+	if (fSelectionStart < fSelectionEnd && offset < fSelectionEnd && fSelectionStart < limit)
+	{
+		outStart = fSelectionStart;
+		outEnd = fSelectionEnd;
+		found = true;
+	}
 
-			if (lineStart < lineEnd)
+	uint32 count = fExtraSelections.GetSize();
+	if (count > 0)
+	{
+		// the extra selections do not overlap, so their ends are sorted too
+		uint32 low = 0;
+		uint32 high = count;
+		while (low < high)
+		{
+			uint32 middle = (low + high) / 2;
+			if (fExtraSelections[middle].end <= offset)
+				low = middle + 1;
+			else
+				high = middle;
+		}
+
+		for (uint32 i = low; i < count && fExtraSelections[i].start < limit; i++)
+		{
+			const STextRange& range = fExtraSelections[i];
+			if (range.start < range.end)
 			{
-				context.SetForeColor(fForeColor);
-				context.SetBackColor(fBackColor);
-				DrawText(text, lineEnd - lineStart, context);
+				if (!found || range.start < outStart)
+				{
+					outStart = range.start;
+					outEnd = range.end;
+					found = true;
+				}
+				break;
 			}
 		}
 	}
 
-	EraseRightEdge(line, context, rightEdge, lineEnd);
+	if (found && outStart < offset)
+		outStart = offset;
+
+	return found;
 }
 
 
@@ -1654,9 +2474,14 @@ void TTextView::RedrawLines(uint32 startLine, uint32 endLine, bool showHideInser
 	if (rightEdge < fScroll.h + GetWidth())
 		rightEdge = fScroll.h + GetWidth();
 
+	// send the lines as a few requests per color rather than several per run
+	context.BeginBatch();
+
 	for (uint32 line = startLine; line <= endLine; line++)
 		DrawLine(line, context, rightEdge);
 
+	context.EndBatch();
+
 	if (showHideInsertionPoint)
 		ShowInsertionPoint(context);
 }
@@ -1731,30 +2556,59 @@ uint32 TTextView::LastVisibleLine() const
 void TTextView::DrawInsertionPoint(TDrawContext& context)
 {
 	ASSERT(fLayout);
+
+	// clip to our text area
+	TRect	border;
+	GetScrollableBounds(border);
+	border.Offset(fScroll);
 	
 	if (fSelectionStart == fSelectionEnd)
+		DrawCaret(context, fSelectionStart, border);
+
+	uint32 count = fExtraSelections.GetSize();
+	if (count > 0)
 	{
-		TPoint p;
-		uint32 line = fLayout->OffsetToPoint(fSelectionStart, p);
-		
-		TRect	r(p.h - 1, p.v - fLayout->GetLineAscent(line), p.h, p.v);
-		
-		// clip to our text area
-		TRect	border;
-		GetScrollableBounds(border);
-		border.Offset(fScroll);
-		r.IntersectWith(border);
-		
-		if (!r.IsEmpty())
+		// only the carets on visible lines need drawing
+		STextOffset first = fLayout->LineToOffset(FirstVisibleLine());
+		STextOffset last = fLayout->LineToOffset(LastVisibleLine() + 1);
+
+		uint32 low = 0;
+		uint32 high = count;
+		while (low < high)
 		{
-			if (fInsertionPointOn)
-			{
-				context.SetForeColor(kRedColor);
-				context.PaintRect(r);
-			}
+			uint32 middle = (low + high) / 2;
+			if (fExtraSelections[middle].start < first)
+				low = middle + 1;
 			else
-				context.EraseRect(r);
+				high = middle;
+		}
+
+		for (uint32 i = low; i < count && fExtraSelections[i].start <= last; i++)
+		{
+			if (fExtraSelections[i].start == fExtraSelections[i].end)
+				DrawCaret(context, fExtraSelections[i].start, border);
+		}
+	}
+}
+
+
+void TTextView::DrawCaret(TDrawContext& context, STextOffset offset, const TRect& border)
+{
+	TPoint p;
+	uint32 line = fLayout->OffsetToPoint(offset, p);
+	
+	TRect	r(p.h - 1, p.v - fLayout->GetLineAscent(line), p.h, p.v);
+	r.IntersectWith(border);
+	
+	if (!r.IsEmpty())
+	{
+		if (fInsertionPointOn)
+		{
+			context.SetForeColor(kRedColor);
+			context.PaintRect(r);
 		}
+		else
+			context.EraseRect(r);
 	}
 }
 
@@ -1812,26 +2666,26 @@ void TTextView::SetSelection(STextOffset start, STextOffset end, bool redraw)
 			{
 				if (oldEnd <= start || end <= oldStart)
 				{
-					DrawTextRange(context, oldStart, oldEnd);
-					DrawTextRange(context, start, end);
+					InvalidateTextRange(oldStart, oldEnd);
+					InvalidateTextRange(start, end);
 				}
 				else
 				{
 					if (oldStart == oldEnd)
-						DrawTextRange(context, start, end);
+						InvalidateTextRange(start, end);
 					else if (start == end)
-						DrawTextRange(context, oldStart, oldEnd);
+						InvalidateTextRange(oldStart, oldEnd);
 					else
 					{
 						if (start < oldStart)
-							DrawTextRange(context, start, oldStart);
+							InvalidateTextRange(start, oldStart);
 						else if (oldStart < start)
-							DrawTextRange(context, oldStart, start);
+							InvalidateTextRange(oldStart, start);
 				
 						if (end < oldEnd)
-							DrawTextRange(context, end, oldEnd);
+							InvalidateTextRange(end, oldEnd);
 						else if (oldEnd < end)
-							DrawTextRange(context, oldEnd, end);
+							InvalidateTextRange(oldEnd, end);
 					}
 				}
 	
@@ -1903,7 +2757,7 @@ void TTextView::DoSetupMenu(TMenu* menu)
 	if (HasRedo())
 		menu->EnableCommand(kRedoCommandID);
 
-	if (fSelectionStart < fSelectionEnd)
+	if (fSelectionStart < fSelectionEnd || HasExtraSelections())
 	{
 		menu->EnableCommand(kFindSelectionCommandID);
 	
@@ -1927,6 +2781,18 @@ void TTextView::DoSetupMenu(TMenu* menu)
 	{
 		menu->EnableCommand(kShiftLeftCommandID);
 		menu->EnableCommand(kShiftRightCommandID);
+
+		if (fMultiLine)
+		{
+			menu->EnableCommand(kSortLinesCommandID);
+			menu->EnableCommand(kSortLinesNumericallyCommandID);
+			menu->EnableCommand(kSortLinesIgnoringCaseCommandID);
+			menu->EnableCommand(kSortLinesByColumnCommandID);
+			menu->EnableCommand(kSortLinesReversedCommandID);
+			menu->EnableCommand(kUniqueLinesCommandID);
+			menu->EnableCommand(kKeepMatchingLinesCommandID);
+			menu->EnableCommand(kDeleteMatchingLinesCommandID);
+		}
 	
 		TLineEndingFormat lineEndingFormat = fLayout->GetLineEndingFormat();
 	
@@ -1938,12 +2804,76 @@ void TTextView::DoSetupMenu(TMenu* menu)
 	if (fMultiLine)
 		menu->EnableCommand(kGotoLineCommandID);
 
+	if (fShowModifiedLines)
+	{
+		menu->EnableCommand(kNextChangeCommandID);
+		menu->EnableCommand(kPreviousChangeCommandID);
+	}
+
 	TView::DoSetupMenu(menu);
 }
 
 
 bool TTextView::DoCommand(TCommandHandler* sender, TCommandHandler* receiver, TCommandID command)
 {
+	if (HasExtraSelections())
+	{
+		switch (command)
+		{
+			case kCutCommandID:
+			case kCopyCommandID:
+			{
+				// the selections are copied one per line
+				TString text;
+				GetSelectionsText(text);
+				if (text.GetLength() > 0)
+					TClipboard::CopyData(XA_STRING, (const unsigned char *)(const TChar *)text, text.GetLength());
+
+				if (command == kCutCommandID && fModifiable)
+				{
+					ReplaceSelections("", 0, false);
+					ScrollSelectionIntoView();
+				}
+				return true;
+			}
+
+			case kClearCommandID:
+				if (fModifiable)
+				{
+					ReplaceSelections("", 0, false);
+					ScrollSelectionIntoView();
+				}
+				return true;
+
+			case kPasteCommandID:
+			{
+				const unsigned char* data;
+				uint32 length;
+				
+				if (fModifiable && TClipboard::GetData(XA_STRING, data, length))
+				{
+					TString	temp((const TChar*)data, length);
+					TLineEndingFormat format;
+					if (temp.GetLineEndingFormat(format) && format != fLayout->GetLineEndingFormat())
+						temp.SetLineEndingFormat(fLayout->GetLineEndingFormat());
+
+					ReplaceSelections(temp, temp.GetLength(), false);
+					ScrollSelectionIntoView();
+				}
+				return true;
+			}
+
+			case kSelectAllCommandID:
+			case kBalanceSelectionCommandID:
+			case kGotoLineCommandID:
+				ClearExtraSelections();
+				break;
+
+			default:
+				break;
+		}
+	}
+
 	switch (command)
 	{
 		case kUndoCommandID:
@@ -1962,7 +2892,7 @@ bool TTextView::DoCommand(TCommandHandler* sender, TCommandHandler* receiver, TC
 				TString	fileName(fLayout->GetText() + fSelectionStart, fSelectionEnd - fSelectionStart);
 				const char* colon = strchr(fileName, ':');
 				int line = 0;
-				if (colon && isdigit(colon[1]))
+				if (colon && isdigit((unsigned char)colon[1]))
 				{
 					line = atoi(colon + 1);
 					fileName.Set(fileName, colon - fileName);
@@ -2063,6 +2993,56 @@ bool TTextView::DoCommand(TCommandHandler* sender, TCommandHandler* receiver, TC
 			ShiftSelectionRight();
 			return true;
 
+		case kSortLinesCommandID:
+			SortLines(0);
+			ScrollSelectionIntoView();
+			return true;
+
+		case kSortLinesNumericallyCommandID:
+			SortLines(TLineSorter::kNumeric);
+			ScrollSelectionIntoView();
+			return true;
+
+		case kSortLinesIgnoringCaseCommandID:
+			SortLines(TLineSorter::kCaseInsensitive);
+			ScrollSelectionIntoView();
+			return true;
+
+		case kSortLinesReversedCommandID:
+			SortLines(TLineSorter::kReverse);
+			ScrollSelectionIntoView();
+			return true;
+
+		case kSortLinesByColumnCommandID:
+		{
+			TString	columnString;
+			if (TCommonDialogs::TextEntryDialog(_("Column Number:"), _("Sort Lines by Column"), GetTopLevelWindow(), columnString, new TNumericEntryBehavior) && columnString.GetLength() > 0)
+			{
+				int column = columnString.AsInteger();
+				SortLines(0, (column > 0 ? column : 1));
+				ScrollSelectionIntoView();
+			}
+			return true;
+		}
+
+		case kUniqueLinesCommandID:
+			UniqueLines();
+			ScrollSelectionIntoView();
+			return true;
+
+		case kKeepMatchingLinesCommandID:
+		case kDeleteMatchingLinesCommandID:
+		{
+			TString	pattern;
+			const TChar* title = (command == kKeepMatchingLinesCommandID ? _("Keep Lines Matching") : _("Delete Lines Matching"));
+			if (TCommonDialogs::TextEntryDialog(_("Lines Matching:"), title, GetTopLevelWindow(), pattern) && pattern.GetLength() > 0)
+			{
+				FilterLines(pattern, command == kKeepMatchingLinesCommandID);
+				ScrollSelectionIntoView();
+			}
+			return true;
+		}
+
 		case kUnixFormatCommandID:
 			SetLineEndingFormat(kUnixLineEndingFormat);
 			return true;
@@ -2095,6 +3075,11 @@ bool TTextView::DoCommand(TCommandHandler* sender, TCommandHandler* receiver, TC
 			return true;
 		}
 
+		case kNextChangeCommandID:
+		case kPreviousChangeCommandID:
+			GotoChange(command == kNextChangeCommandID);
+			return true;
+
 		case kFocusAcquiredCommandID:
 			if (fInputContext)
 			{
@@ -2181,16 +3166,52 @@ void TTextView::SetLineEndingFormat(TLineEndingFormat format)
 {
 	ASSERT(format == kUnixLineEndingFormat || format == kDOSLineEndingFormat || format == kMacLineEndingFormat);
 
+	STextOffset oldLength = GetTextLength();
 	fLayout->SetLineEndingFormat(format, AdjustOffsetsCallback, this);
 
+	// journal the conversion as a replacement of the whole text
+	if (fEditJournal)
+		fEditJournal->RecordEdit(0, oldLength, GetText(), GetTextLength());
+
 	TListIterator<UndoRedoData> iter(fUndoRedoList);
 	UndoRedoData* undoRedoData;
+	int index = 0;
 
 	while ((undoRedoData = iter.Next()) != NULL)
 	{
-		int oldLength = undoRedoData->fText.GetLength();
-		undoRedoData->fText.SetLineEndingFormat(format);
-		undoRedoData->fOldEnd += (undoRedoData->fText.GetLength() - oldLength);
+		if (undoRedoData->fRangeCount > 0)
+		{
+			// each range's text is converted on its own, so the ranges still say where it is.
+			// fText holds the old text of the ranges until the edit is undone.
+			bool undone = (index > fUndoRedoIndex);
+			const TChar* piece = undoRedoData->fText;
+			TString text;
+
+			for (uint32 i = 0; i < undoRedoData->fRangeCount; i++)
+			{
+				UndoRange& range = undoRedoData->fRanges[i];
+				STextOffset& end = (undone ? range.fNewEnd : range.fOldEnd);
+				STextOffset start = (undone ? range.fNewStart : range.fOldStart);
+
+				TString converted;
+				converted.Set(piece, end - start);
+				converted.SetLineEndingFormat(format);
+				piece += end - start;
+
+				end = start + converted.GetLength();
+				text += converted;
+			}
+
+			undoRedoData->fText = text;
+		}
+		else
+		{
+			int oldLength = undoRedoData->fText.GetLength();
+			undoRedoData->fText.SetLineEndingFormat(format);
+			undoRedoData->fOldEnd += (undoRedoData->fText.GetLength() - oldLength);
+		}
+
+		index++;
 	}
 
 	HandleCommand(this, this, kDataModifiedCommandID);
@@ -2212,6 +3233,10 @@ void TTextView::SaveUndo(STextOffset newSelectionStart, STextOffset newSelection
 	if (!accumulateDeletion)	
 		fAccumulateDeletion = false;
 		
+	// only SaveUndoRanges extends an edit of several selections
+	if (fUndoRedoIndex >= 0 && fUndoRedoList[fUndoRedoIndex]->fRangeCount > 0)
+		fAccumulateTyping = fAccumulateDeletion = false;
+
 	if (fAccumulateTyping)
 	{
 		ASSERT(fUndoRedoIndex >= 0);
@@ -2244,6 +3269,78 @@ void TTextView::SaveUndo(STextOffset newSelectionStart, STextOffset newSelection
 }
 
 
+// saves an edit of several selections as a single undo step holding every range and the text it had
+void TTextView::SaveUndoRanges(const TDynamicArray<STextRange>& ranges, STextOffset length, STextOffset newSelection, bool accumulateTyping)
+{
+	uint32 count = ranges.GetSize();
+	uint32 i;
+
+	if (accumulateTyping && fAccumulateTyping && fUndoRedoIndex >= 0 && fUndoRedoIndex == fUndoRedoList.GetSize() - 1)
+	{
+		// more typing inside the text each range of the last edit put in extends it
+		UndoRedoData* data = fUndoRedoList[fUndoRedoIndex];
+		bool extend = (data->fRangeCount == count);
+
+		for (i = 0; i < count && extend; i++)
+			extend = (data->fRanges[i].fNewStart <= ranges[i].start && ranges[i].end <= data->fRanges[i].fNewEnd);
+
+		if (extend)
+		{
+			STextOffset shift = 0;
+
+			for (i = 0; i < count; i++)
+			{
+				UndoRange& range = data->fRanges[i];
+				STextOffset delta = length - (ranges[i].end - ranges[i].start);
+
+				range.fNewStart += shift;
+				range.fNewEnd += shift + delta;
+				shift += delta;
+			}
+
+			data->fNewEnd = data->fRanges[count - 1].fNewEnd;
+			data->fNewSelectionStart = data->fNewSelectionEnd = newSelection;
+			return;
+		}
+	}
+
+	// delete any redo data
+	for (int j = fUndoRedoList.GetSize() - 1; j > fUndoRedoIndex; j--)
+		fUndoRedoList.DeleteAt(j);
+
+	if (fSavedUndoRedoIndex > fUndoRedoIndex)
+		fSavedUndoRedoIndex = -2;		// we can no longer undo/redo to saved version of document. 
+
+	fAccumulateTyping = fAccumulateDeletion = false;
+
+	UndoRedoData* data = new UndoRedoData(ranges[0].start, ranges[count - 1].end, ranges[0].start, ranges[0].start,
+										  fSelectionStart, fSelectionEnd, kNormal);
+	data->fRanges = (UndoRange *)malloc(count * sizeof(UndoRange));
+	ASSERT(data->fRanges);
+	data->fRangeCount = count;
+
+	STextOffset shift = 0;
+
+	for (i = 0; i < count; i++)
+	{
+		UndoRange& range = data->fRanges[i];
+		range.fOldStart = ranges[i].start;
+		range.fOldEnd = ranges[i].end;
+		range.fNewStart = ranges[i].start + shift;
+		range.fNewEnd = range.fNewStart + length;
+		shift += length - (ranges[i].end - ranges[i].start);
+	}
+
+	GetRangesText(&ranges[0], count, data->fText);
+	data->fNewEnd = data->fRanges[count - 1].fNewEnd;
+	data->fNewSelectionStart = data->fNewSelectionEnd = newSelection;
+
+	fUndoRedoList.InsertLast(data);
+	++fUndoRedoIndex;
+	ASSERT(fUndoRedoIndex == fUndoRedoList.GetSize() - 1);
+}
+
+
 // this variant only used for mouse copy
 void TTextView::SaveUndoMouseCopy(STextOffset offset, STextOffset length, UndoType undoType)
 {
@@ -2268,17 +3365,23 @@ void TTextView::Undo()
 {
 	ASSERT(HasUndo());
 	
+	ClearExtraSelections();
 	UndoRedoData* data = fUndoRedoList[fUndoRedoIndex];
 
-	SetSelection(data->fNewStart, data->fNewEnd);
-	TString newText;
-	GetSelectedText(newText);
-	ReplaceSelection(data->fText, data->fText.GetLength(), false, true);
+	if (data->fRangeCount > 0)
+		ReplaceUndoRanges(data, true);
+	else
+	{
+		SetSelection(data->fNewStart, data->fNewEnd);
+		TString newText;
+		GetSelectedText(newText);
+		ReplaceSelection(data->fText, data->fText.GetLength(), false, true);
+		data->fText = newText;
+	}
+
 	SetSelection(data->fOldSelectionStart, data->fOldSelectionEnd);
 	AnchorSelection();
 
-	data->fText = newText;
-
 	--fUndoRedoIndex;
 
 	if (data->fUndoType == kGroupWithPrevious)
@@ -2290,25 +3393,149 @@ void TTextView::Redo()
 {
 	ASSERT(HasRedo());
 
+	ClearExtraSelections();
 	UndoRedoData* data = fUndoRedoList[++fUndoRedoIndex];
 
-	STextOffset selectionStart, selectionEnd;
-	GetSelection(selectionStart, selectionEnd);
-	
-	SetSelection(data->fOldStart, data->fOldEnd);
-	TString oldText;
-	GetSelectedText(oldText);
-	ReplaceSelection(data->fText, data->fText.GetLength(), false, true);
+	if (data->fRangeCount > 0)
+		ReplaceUndoRanges(data, false);
+	else
+	{
+		SetSelection(data->fOldStart, data->fOldEnd);
+		TString oldText;
+		GetSelectedText(oldText);
+		ReplaceSelection(data->fText, data->fText.GetLength(), false, true);
+		data->fText = oldText;
+	}
+
 	SetSelection(data->fNewSelectionStart, data->fNewSelectionEnd);
 	AnchorSelection();
-
-	data->fText = oldText;
 	
-	if (data->fUndoType == kGroupWithNext)
+	if (data->fUndoType == kGroupWithNext ||
+		(fUndoRedoIndex + 1 < fUndoRedoList.GetSize() && fUndoRedoList[fUndoRedoIndex + 1]->fUndoType == kGroupWithPrevious))
 		Redo();
 }
 
 
+// puts back the text each range of an edit of several selections had before it, or for redo the text it had after,
+// in a single edit. the text taken out is kept in its place for going back the other way.
+void TTextView::ReplaceUndoRanges(UndoRedoData* data, bool undo)
+{
+	uint32 count = data->fRangeCount;
+	STextRange* ranges = (STextRange *)malloc(count * sizeof(STextRange));
+	const TChar** texts = (const TChar **)malloc(count * sizeof(TChar *));
+	STextOffset* lengths = (STextOffset *)malloc(count * sizeof(STextOffset));
+	ASSERT(ranges && texts && lengths);
+
+	const TChar* text = data->fText;
+	uint32 i;
+
+	for (i = 0; i < count; i++)
+	{
+		const UndoRange& range = data->fRanges[i];
+		ranges[i].start = (undo ? range.fNewStart : range.fOldStart);
+		ranges[i].end = (undo ? range.fNewEnd : range.fOldEnd);
+		lengths[i] = (undo ? range.fOldEnd - range.fOldStart : range.fNewEnd - range.fNewStart);
+		texts[i] = text;
+		text += lengths[i];
+	}
+
+	TString replaced;
+	GetRangesText(ranges, count, replaced);
+
+	if (fEditJournal)
+	{
+		for (i = count; i > 0; i--)
+			fEditJournal->RecordEdit(ranges[i - 1].start, ranges[i - 1].end - ranges[i - 1].start, texts[i - 1], lengths[i - 1]);
+	}
+
+	uint32 redrawStart, redrawEnd;
+	fLayout->ReplaceRanges(ranges, count, texts, lengths, redrawStart, redrawEnd);
+
+	// going back starts from where the text put in ended up
+	STextOffset shift = 0;
+
+	for (i = 0; i < count; i++)
+	{
+		UndoRange& range = data->fRanges[i];
+		STextOffset start = ranges[i].start + shift;
+
+		if (undo)
+		{
+			range.fOldStart = start;
+			range.fOldEnd = start + lengths[i];
+		}
+		else
+		{
+			range.fNewStart = start;
+			range.fNewEnd = start + lengths[i];
+		}
+
+		shift += lengths[i] - (ranges[i].end - ranges[i].start);
+	}
+
+	data->fText = replaced;
+
+	free(ranges);
+	free(texts);
+	free(lengths);
+
+	if (undo)
+		SetSelection(data->fOldSelectionStart, data->fOldSelectionEnd, false);
+	else
+		SetSelection(data->fNewSelectionStart, data->fNewSelectionEnd, false);
+
+	ComputeContentSize();
+
+	if (IsVisible())
+	{
+		uint32 firstVisible = FirstVisibleLine();
+		uint32 lastVisible = LastVisibleLine();
+		
+		if (redrawStart < firstVisible)
+			redrawStart = firstVisible;
+		if (redrawEnd > lastVisible)
+			redrawEnd = lastVisible;
+	
+		InvalidateLines(redrawStart, redrawEnd, true);
+	}
+
+	HandleCommand(this, this, kDataModifiedCommandID);
+}
+
+
+// copies the text of each of the ranges, one after another
+void TTextView::GetRangesText(const STextRange* ranges, uint32 count, TString& text) const
+{
+	STextOffset length = 0;
+	uint32 i;
+
+	for (i = 0; i < count; i++)
+		length += ranges[i].end - ranges[i].start;
+
+	TChar* buffer = (TChar *)malloc(length + 1);
+	ASSERT(buffer);
+	TChar* dest = buffer;
+
+	for (i = 0; i < count; i++)
+	{
+		if (ranges[i].end > ranges[i].start)
+		{
+			memcpy(dest, GetText() + ranges[i].start, ranges[i].end - ranges[i].start);
+			dest += ranges[i].end - ranges[i].start;
+		}
+	}
+
+	text.Set(buffer, length);
+	free(buffer);
+}
+
+
+TTextView::UndoRedoData::~UndoRedoData()
+{
+	free(fRanges);
+}
+
+
 void TTextView::ClearUndoRedo()
 {
 	for (int i = fUndoRedoList.GetSize() - 1; i >= 0; i--)
@@ -2355,6 +3582,15 @@ void TTextView::AdjustOffsets(STextOffset offset, int shift)
 	if (fMouseCopyLocation >= offset)
 		fMouseCopyLocation += shift;
 
+	for (uint32 i = 0; i < fExtraSelections.GetSize(); i++)
+	{
+		STextRange& range = fExtraSelections[i];
+		if (range.start >= offset)
+			range.start += shift;
+		if (range.end >= offset)
+			range.end += shift;
+	}
+
 	TListIterator<UndoRedoData> iter(fUndoRedoList);
 	UndoRedoData* undoRedoData;
 
@@ -2383,6 +3619,26 @@ void TTextView::TextSaved()
 	
 	// this is necessary to ensure we can undo/redo back to point where document last saved
 	fAccumulateTyping = fAccumulateDeletion = false;
+
+	fLayout->ClearModifiedLines();
+	if (fShowModifiedLines && IsVisible())
+		Redraw();
+}
+
+
+void TTextView::GotoChange(bool forward)
+{
+	uint32 line;
+
+	if (fLayout->FindModifiedLine(fLayout->OffsetToLine(fSelectionStart), forward, line))
+	{
+		STextOffset offset = fLayout->LineToOffset(line);
+		SetSelection(offset, offset);
+		AnchorSelection();
+		ScrollSelectionIntoView();
+	}
+	else
+		gApplication->Beep();
 }
 
 
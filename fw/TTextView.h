@@ -26,10 +26,12 @@
 #include "TTextLayout.h"
 #include "TString.h"
 #include "TList.h"
+#include "TDynamicArray.h"
 
 
 class TFont;
 class TDrawContext;
+class TEditJournal;
 
 
 class TTextView : public TView, public TIdler
@@ -43,13 +45,24 @@ public:
 	};
 
 private:	
+	// where one of the selections of an edit of several was, before and after the edit
+	struct UndoRange
+	{
+		STextOffset		fOldStart;
+		STextOffset		fOldEnd;
+		STextOffset		fNewStart;
+		STextOffset		fNewEnd;
+	};
+
 	struct UndoRedoData
 	{
 		inline UndoRedoData(STextOffset oldStart, STextOffset oldEnd, STextOffset newStart, STextOffset newEnd, 
 							 STextOffset oldSelectionStart, STextOffset oldSelectionEnd, UndoType undoType)
 				:	fOldStart(oldStart), fOldEnd(oldEnd), fNewStart(newStart), fNewEnd(newEnd), 
 					fOldSelectionStart(oldSelectionStart), fOldSelectionEnd(oldSelectionEnd), 
-					fNewSelectionStart(newStart), fNewSelectionEnd(newEnd),fUndoType(undoType) {}
+					fNewSelectionStart(newStart), fNewSelectionEnd(newEnd),fUndoType(undoType),
+					fRanges(NULL), fRangeCount(0) {}
+		~UndoRedoData();
 			
 		TString			fText;
 		STextOffset		fOldStart;
@@ -61,6 +74,18 @@ private:
 		STextOffset		fNewSelectionStart;
 		STextOffset		fNewSelectionEnd;
 		UndoType		fUndoType;
+		UndoRange*		fRanges;			// for an edit of several selections, whose text is one after another in fText
+		uint32			fRangeCount;
+	};
+
+protected:
+	// the line an edit is made in, as it was before the edit
+	struct LineEdit
+	{
+		uint32			fLine;
+		TCoord			fTailH;			// where the text after the edit started
+		TCoord			fRight;			// where the line ended
+		TCoord			fHeight;
 	};
 		
 public:
@@ -97,7 +122,7 @@ public:
 	void						InsertTabSpaces();
 	void						InsertText(STextOffset location, const TChar* text, STextOffset length, UndoType undoType = kNormal);
 	void						ReplaceSelection(const TChar* text, STextOffset length, bool saveUndo, bool selectAfter, bool accumulateTyping = false);
-	void						Delete(bool forward, bool accumulateDeletion);
+	void						Delete(bool forward, bool accumulateDeletion, int count = 1);
 	void						AutoIndent();
 	void						SetUndoSelection();
 
@@ -105,6 +130,11 @@ public:
 	void						ShiftSelectionRight();
 	void						ExtendSelectionToLines();
 
+	// these work on the selected lines, or the whole text if nothing is selected
+	void						SortLines(int flags, int column = 0);
+	void						UniqueLines();
+	void						FilterLines(const TChar* pattern, bool keepMatches);
+
 	bool						FindString(const TChar* searchString, bool caseSensitive, bool forward, bool wrap, bool wholeWord);
 
 	inline bool					FilterTabAndCR() const { return fFilterTabAndCR; }
@@ -119,11 +149,29 @@ public:
 	void						ScrollSelectionIntoView(bool selecting = false, bool allowHorizScroll = true);
 
 	void						TextSaved();
+	void						GotoChange(bool forward);
+
+	// marks lines changed since the last save in the left margin
+	inline void					SetShowModifiedLines(bool show) { fShowModifiedLines = show; }
 	inline bool					NeedsSaving() const { return  fSavedUndoRedoIndex != fUndoRedoIndex; }
 
 	void						ClearUndoRedo();
 	
 	inline void					SetSpacesPerTab(int spacesPerTab) { fSpacesPerTab = spacesPerTab; }
+
+	// edits are recorded in the journal, if any.  the journal is not owned by the view.
+	inline void					SetEditJournal(TEditJournal* journal) { fEditJournal = journal; }
+
+	// multiple selections.  fSelectionStart and fSelectionEnd is the main selection,
+	// the others are kept sorted and non-overlapping in fExtraSelections.
+	inline bool					HasExtraSelections() const { return fExtraSelections.GetSize() > 0; }
+	void						AddSelection(STextOffset start, STextOffset end);
+	void						ClearExtraSelections();
+	void						SelectColumns(const TPoint& anchor, const TPoint& point);
+	void						ReplaceSelections(const TChar* text, STextOffset length, bool accumulateTyping);
+	void						DeleteSelections(bool forward, int count);
+	void						MoveSelections(bool forward, int count);
+	void						GetSelectionsText(TString& string);
 	
 protected:
 	virtual						~TTextView();
@@ -140,6 +188,8 @@ protected:
 	virtual void				DoMouseUp(const TPoint& point, TMouseButton button, TModifierState state);
 	virtual void				DoMouseMoved(const TPoint& point, TModifierState state);
 	virtual bool				DoKeyDown(KeySym key, TModifierState state, const char* string);
+	int							CollectKeyRepeats();
+	bool						DoMultipleSelectionKeyDown(KeySym key, TModifierState state, const char* string);
 
 	virtual bool				IsTargetable() const;
 
@@ -149,9 +199,16 @@ protected:
 	
 	virtual void				PastedText();
 
-	void						DrawTextRange(TDrawContext& context, STextOffset startOffset, STextOffset endOffset, TRegion* clip = NULL);
+	void						InvalidateTextRange(STextOffset startOffset, STextOffset endOffset);
+	void						InvalidateLines(uint32 startLine, uint32 endLine, bool showInsertionPoint);
+	void						InvalidateInsertionPoint();
+	bool						BeginLineEdit(STextOffset start, STextOffset end, const TChar* text, STextOffset length, LineEdit& edit);
+	bool						InvalidateLineEdit(const LineEdit& edit, STextOffset start, STextOffset end);
+	virtual bool				CanMoveLineTail(STextOffset start, STextOffset end, const TChar* text, STextOffset length) const;
+	virtual void				ExtendLineEditDamage(STextOffset& ioStart, STextOffset& ioEnd) const;
 
 	void						DrawInsertionPoint(TDrawContext& context);
+	void						DrawCaret(TDrawContext& context, STextOffset offset, const TRect& border);
 	void						ShowInsertionPoint(TDrawContext& context);
 	void						HideInsertionPoint(TDrawContext& context);
 	
@@ -159,6 +216,10 @@ protected:
     virtual void                EraseRightEdge(uint32 line, TDrawContext& context, TCoord rightEdge, STextOffset lineEnd);
 	virtual void				RedrawLines(uint32 startLine, uint32 endLine, bool showHideInsertionPoint, TRegion* clip = NULL);
 	virtual void				DrawText(const TChar* text, int length, TDrawContext& context);
+	void						SetTextColors(TDrawContext& context, bool hilited);
+	bool						NextSelection(STextOffset offset, STextOffset limit, STextOffset& outStart, STextOffset& outEnd) const;
+	void						GetSelections(TDynamicArray<STextRange>& selections, uint32& outMainIndex) const;
+	void						ReplaceRanges(const TDynamicArray<STextRange>& ranges, uint32 mainIndex, const TChar* text, STextOffset length, bool accumulateTyping);
 	
 	void						HideCursor();
 
@@ -174,6 +235,9 @@ protected:
 	virtual TCoord				GetPageIncrement(TScrollDirection direction) const;
 	
 	void						ComputeContentSize();
+
+	STextRange*					GetSelectedLines(uint32& outCount);
+	void						ReplaceSelectedLines(const STextRange* lines, uint32 count);
 	
 	virtual void				DoSetupMenu(TMenu* menu);
 	virtual bool				DoCommand(TCommandHandler* sender, TCommandHandler* receiver, TCommandID command);
@@ -186,7 +250,10 @@ protected:
 	void						SetLineEndingFormat(TLineEndingFormat format);
 
 	void						SaveUndo(STextOffset newSelectionStart, STextOffset newSelectionEnd, bool accumulateTyping, bool accumulateDeletion);
+	void						SaveUndoRanges(const TDynamicArray<STextRange>& ranges, STextOffset length, STextOffset newSelection, bool accumulateTyping);
 	void						SaveUndoMouseCopy(STextOffset offset, STextOffset length, UndoType undoType);
+	void						ReplaceUndoRanges(UndoRedoData* data, bool undo);
+	void						GetRangesText(const STextRange* ranges, uint32 count, TString& text) const;
 	void						Undo();
 	void						Redo();
 
@@ -224,7 +291,14 @@ protected:
 	bool						fFilterTabAndCR;
 	bool						fHideInsertionPointWhenNotTarget;	// if false, will show insertion point when not target
 	bool						fCursorHidden;						// cursor obscured due to typing
+	bool						fShowModifiedLines;
+
+	TDynamicArray<STextRange>	fExtraSelections;
+	TPoint						fColumnAnchor;			// start of a rectangular selection being tracked
+	TPoint						fColumnPoint;
+	bool						fTrackingColumns;
 
+	TEditJournal*				fEditJournal;
 	TString						fLastSelection;
 	TMouseTrackingIdler*		fMouseTrackingIdler;
 	static TCursor*				sCursor;
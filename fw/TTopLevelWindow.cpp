@@ -34,6 +34,7 @@
 #include <X11/Xatom.h>
 
 #include <stdio.h>
+#include <string.h>
 
 TPixmap* TTopLevelWindow::sDefaultIcon = NULL;
 TList<TTopLevelWindow> TTopLevelWindow::sWindowList;
@@ -47,6 +48,7 @@ TTopLevelWindow::TTopLevelWindow(const TRect& bounds, const TChar* title)
 		fHideOnClose(false),
 		fIcon(NULL)
 {
+	memset(&fCurrentKeyEvent, 0, sizeof(fCurrentKeyEvent));
 }
 
 
@@ -183,6 +185,8 @@ void TTopLevelWindow::DispatchKeyEvent(XEvent& event)
 
 	if (event.type == KeyPress)
 	{
+		fCurrentKeyEvent = event.xkey;
+
 		if (state != 0)
 		{
 			TMenuBar* menuBar = GetMenuBar();
@@ -200,6 +204,58 @@ void TTopLevelWindow::DispatchKeyEvent(XEvent& event)
 }
 
 
+// removes auto-repeats of the key being dispatched that are already queued and returns how many there were.
+// this lets the target handle a burst of repeats as a single edit.
+// only events that have already arrived are looked at, so nothing is consumed past the key release.
+int TTopLevelWindow::CollectKeyRepeats()
+{
+	Display* display = GetDisplay();
+	int count = 0;
+
+	while (XEventsQueued(display, QueuedAfterReading) > 0)
+	{
+		XEvent	event;
+		XPeekEvent(display, &event);
+		
+		if (event.xany.window != fCurrentKeyEvent.window || 
+			(event.type != KeyPress && event.type != KeyRelease) ||
+			event.xkey.keycode != fCurrentKeyEvent.keycode || event.xkey.state != fCurrentKeyEvent.state)
+			break;
+
+		if (event.type == KeyRelease)
+		{
+			// auto-repeat sends a release and a press with the same time stamp.
+			// anything else is the key really being released.
+			XEvent	release;
+			XNextEvent(display, &release);
+			
+			if (XEventsQueued(display, QueuedAfterReading) == 0)
+			{
+				XPutBackEvent(display, &release);
+				break;
+			}
+			
+			XPeekEvent(display, &event);
+			
+			if (event.type != KeyPress || event.xany.window != release.xany.window ||
+				event.xkey.keycode != release.xkey.keycode || event.xkey.time != release.xkey.time)
+			{
+				XPutBackEvent(display, &release);
+				break;
+			}
+		}
+		
+		// event is now the repeated key press
+		XNextEvent(display, &event);
+		fCurrentKeyEvent = event.xkey;
+		fCurrentEventTime = event.xkey.time;
+		++count;
+	}
+	
+	return count;
+}
+
+
 void TTopLevelWindow::SetTarget(TWindow* target)
 {
 	if (target != fTarget)
@@ -45,6 +45,7 @@ public:
 	inline void					SetMenuBar(TMenuBar* menuBar) { fMenuBar = menuBar; }
 
 	void						DispatchKeyEvent(XEvent& event);
+	int							CollectKeyRepeats();
 
 	inline TWindow*				GetTarget() const { return fTarget; }
 	void						SetTarget(TWindow* target);
@@ -70,6 +71,7 @@ protected:
 	TString						fTitle;
 	TMenuBar*					fMenuBar;
 	TWindow*					fTarget;			// window that should get keyboard focus
+	XKeyEvent					fCurrentKeyEvent;	// key press being dispatched
 	bool						fHideOnClose;
 	
 	TPixmap*					fIcon;
@@ -391,6 +391,7 @@ void TTreeView::ExpandCollapseRow(int row)
 		}
 
 		node->Expand(false);
+		RowsDeleted(startRow + 1, deletedRows);
 		
 		if (r > startRow + deletedRows)
 			SelectCell(r - deletedRows, c);
@@ -399,6 +400,7 @@ void TTreeView::ExpandCollapseRow(int row)
 	{		
 		node->Expand(true);
 		ExpandRow(row);
+		RowsInserted(startRow + 1, row - startRow);
 
 		int r, c;
 		if (GetFirstSelectedCell(r, c) && r > startRow)
@@ -407,8 +409,6 @@ void TTreeView::ExpandCollapseRow(int row)
 			SelectCell(r + row - startRow, c);
 		}
 	}
-
-	ComputeContentSize();
 }
 
 
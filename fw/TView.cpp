@@ -171,6 +171,14 @@ void TView::ScrollBy(TCoord dh, TCoord dv, bool notifyParent)
 		}
 		else
 		{			
+			// damage not drawn yet moves along with the pixels we copy
+			if (fUpdateRegion)
+			{
+				TRegion	moved(*fUpdateRegion);
+				moved.Offset(-deltaH, -deltaV);
+				fUpdateRegion->Union(&moved);
+			}
+
 			TDrawContext	context(this);
 			context.CopyRect(this, src, TPoint(src.left - deltaH, src.top - deltaV), false);
 
@@ -178,26 +186,26 @@ void TView::ScrollBy(TCoord dh, TCoord dv, bool notifyParent)
 			{
 				TRect	r(scrollableBounds.right - deltaH, scrollableBounds.top, scrollableBounds.right, scrollableBounds.bottom);
 				r.Offset(fScroll);
-				RedrawRect(r);
+				Invalidate(r);
 			}
 			else if (deltaH < 0)
 			{
 				TRect	r(scrollableBounds.left, scrollableBounds.top, scrollableBounds.left - deltaH, scrollableBounds.bottom);
 				r.Offset(fScroll);
-				RedrawRect(r);
+				Invalidate(r);
 			}
 
 			if (deltaV > 0)
 			{
 				TRect	r(scrollableBounds.left, scrollableBounds.bottom - deltaV, scrollableBounds.right, scrollableBounds.bottom);
 				r.Offset(fScroll);
-				RedrawRect(r);
+				Invalidate(r);
 			}
 			else if (deltaV < 0)
 			{
 				TRect	r(scrollableBounds.left, scrollableBounds.top, scrollableBounds.right, scrollableBounds.top - deltaV);
 				r.Offset(fScroll);
-				RedrawRect(r);
+				Invalidate(r);
 			}
 		}
 
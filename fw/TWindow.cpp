@@ -87,6 +87,11 @@ TWindow::TWindow(TWindow* parent, const TRect& bounds, TWindowStyle style)
 		fHasFocus(false),
 		fRaiseOnMapNotify(false),
 		fSetFocusOnMapNotify(false),
+		fDoubleBuffered(false),
+		fDrawingOffscreen(false),
+		fBackBuffer(0),
+		fBackBufferWidth(0),
+		fBackBufferHeight(0),
 		fLastClickTime(0),
 		fClickCount(1),
 		fNextUpdate(NULL)
@@ -333,6 +338,8 @@ void TWindow::DoDestroy()
 	while ((child = iter.Next()) != NULL)
 		child->Destroy();
 
+	FreeBackBuffer();
+
 	if (IsCreated())
 		XDestroyWindow(sDisplay, fWindow);
 
@@ -461,7 +468,7 @@ void TWindow::LostSelectionOwnership()
 
 Drawable TWindow::GetDrawable() const
 {
-	return fWindow;
+	return (fDrawingOffscreen ? fBackBuffer : fWindow);
 }
 
 
@@ -676,14 +683,7 @@ void TWindow::HandleEvent(XEvent& event)
 		{
 			TRect	r(event.xexpose.x, event.xexpose.y, event.xexpose.x + event.xexpose.width, event.xexpose.y + event.xexpose.height);
 
-			if (fUpdateRegion)
-				fUpdateRegion->Union(r);
-			else
-			{
-				fUpdateRegion = new TRegion(r);
-				fNextUpdate = sFirstUpdate;
-				sFirstUpdate = this;
-			}
+			AddUpdateRect(r);
 				
 //			if (event.xexpose.count == 0)
 //				Update();
@@ -1015,9 +1015,16 @@ void TWindow::Update()
 {
 	if (fUpdateRegion)
 	{
-		Draw(fUpdateRegion);
-		delete fUpdateRegion;
+		// anything invalidated while drawing waits for the next ProcessUpdates
+		TRegion* region = fUpdateRegion;
 		fUpdateRegion = NULL;
+
+		if (fDoubleBuffered && IsCreated())
+			DrawOffscreen(region);
+		else
+			Draw(region);
+
+		delete region;
 	}
 }
 
@@ -1029,8 +1036,82 @@ void TWindow::ProcessUpdates()
 	
 	while (window)
 	{
+		TWindow* next = window->fNextUpdate;
 		window->Update();
-		window = window->fNextUpdate;
+		window = next;
+	}
+}
+
+
+void TWindow::SetDoubleBuffered(bool doubleBuffered)
+{
+	fDoubleBuffered = doubleBuffered;
+
+	if (!doubleBuffered)
+		FreeBackBuffer();
+}
+
+
+// draws into the back buffer and copies the result to the window with a single XCopyArea,
+// so the window never shows a partially drawn update
+void TWindow::DrawOffscreen(TRegion* clip)
+{
+	TCoord width = GetWidth();
+	TCoord height = GetHeight();
+
+	if (width <= 0 || height <= 0)
+		return;
+
+	// the back buffer is kept between updates and only grows
+	if (!fBackBuffer || width > fBackBufferWidth || height > fBackBufferHeight)
+	{
+		FreeBackBuffer();
+
+		fBackBufferWidth = width;
+		fBackBufferHeight = height;
+		fBackBuffer = XCreatePixmap(sDisplay, fWindow, width, height, fDepth);
+	}
+
+	GC gc = XCreateGC(sDisplay, fWindow, 0, NULL);
+	XSetRegion(sDisplay, gc, clip->GetRegion());
+
+	// start from the background, as the window would after an expose
+	XSetForeground(sDisplay, gc, fBackColor.GetPixel());
+	XFillRectangle(sDisplay, fBackBuffer, gc, 0, 0, width, height);
+
+	fDrawingOffscreen = true;
+	Draw(clip);
+	fDrawingOffscreen = false;
+
+	XCopyArea(sDisplay, fBackBuffer, fWindow, gc, 0, 0, width, height, 0, 0);
+	XFreeGC(sDisplay, gc);
+}
+
+
+void TWindow::FreeBackBuffer()
+{
+	if (fBackBuffer)
+	{
+		XFreePixmap(sDisplay, fBackBuffer);
+		fBackBuffer = 0;
+		fBackBufferWidth = 0;
+		fBackBufferHeight = 0;
+	}
+}
+
+
+void TWindow::AddUpdateRect(const TRect& r)
+{
+	if (r.IsEmpty())
+		return;
+
+	if (fUpdateRegion)
+		fUpdateRegion->Union(r);
+	else
+	{
+		fUpdateRegion = new TRegion(r);
+		fNextUpdate = sFirstUpdate;
+		sFirstUpdate = this;
 	}
 }
 
@@ -1173,7 +1254,7 @@ void TWindow::Redraw()
 		TRect	r(0, 0, GetWidth(), GetHeight());
 		const TPoint& scroll = GetScroll();
 		r.Offset(scroll.h, scroll.v);
-		RedrawRect(r);
+		Invalidate(r);
 	}
 }
 
@@ -1189,6 +1270,19 @@ void TWindow::RedrawRect(const TRect& r)
 }
 
 
+void TWindow::Invalidate(const TRect& r)
+{
+	if (!IsCreated())
+		return;
+
+	TPoint scroll = GetScroll();
+	TRect updateRect(r);
+	updateRect.Offset(-scroll.h, -scroll.v);
+	
+	AddUpdateRect(updateRect);
+}
+
+
 void TWindow::AddChild(TWindow* child)
 {
 	fChildren.Insert(child);
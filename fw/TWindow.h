@@ -79,6 +79,10 @@ public:
 
 	void						Redraw();
 	virtual void				RedrawRect(const TRect& r);
+	void						Invalidate(const TRect& r);		// drawn by the next ProcessUpdates
+
+	void						SetDoubleBuffered(bool doubleBuffered);
+	inline bool					IsDoubleBuffered() const { return fDoubleBuffered; }
 
 	inline const TRect&			GetBounds() const { return fBounds; }
 	inline TCoord				GetWidth() const { return fBounds.GetWidth(); }
@@ -153,11 +157,15 @@ public:
 
 	void						Update();
 	static void					ProcessUpdates();
+	static inline bool			HasPendingUpdates() { return sFirstUpdate != NULL; }
 
 protected:
 	void						SetBackgroundPixel(TColor* color); // NULL for transparent
 
 	virtual void				Draw(TRegion* clip);
+	void						AddUpdateRect(const TRect& r);
+	void						DrawOffscreen(TRegion* clip);
+	void						FreeBackBuffer();
 	virtual void				DoClose();
 	virtual void				DoDestroy();
 
@@ -216,6 +224,13 @@ protected:
 	bool						fHasFocus;
 	bool						fRaiseOnMapNotify;
 	bool						fSetFocusOnMapNotify;
+
+	// back buffer for drawing updates offscreen
+	bool						fDoubleBuffered;
+	bool						fDrawingOffscreen;		// GetDrawable returns fBackBuffer while true
+	Pixmap						fBackBuffer;
+	TCoord						fBackBufferWidth;
+	TCoord						fBackBufferHeight;
 	
 	// for simulated mouse moved events
 	TPoint						fLastMouseMovedLocation;
@@ -0,0 +1,149 @@
+// ========================================================================================
+//	TCompletionMenu.cpp			   Copyright (C) 2001-2009 Mike Voydanoff. All rights reserved.
+// ========================================================================================
+/*
+	This program is free software; you can redistribute it and/or
+	modify it under the terms of the GNU General Public License
+	as published by the Free Software Foundation; either version 2
+	of the License, or (at your option) any later version.
+	
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+	
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*/
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "IDECommon.h"
+
+#include "TCompletionMenu.h"
+
+#include "fw/TTextView.h"
+#include "fw/TTopLevelWindow.h"
+
+#include <X11/keysym.h>
+#include <X11/Xutil.h>
+
+
+TCompletionMenu::TCompletionMenu(TTextView* textView, STextOffset prefixLength)
+	:	TPopupMenu(),
+		fTextView(textView),
+		fPrefixLength(prefixLength)
+{
+	ASSERT(textView);
+}
+
+
+TCompletionMenu::~TCompletionMenu()
+{
+}
+
+
+void TCompletionMenu::AddCompletion(const TChar* word, STextOffset length)
+{
+	TMenuItem* item = new TMenuItem(TString(word, length));
+	item->Enable(true);
+	AddItem(item);
+}
+
+
+void TCompletionMenu::DisplayAtInsertionPoint()
+{
+	STextOffset start, end;
+	fTextView->GetSelection(start, end);
+
+	// just below the line, Display moves it up and left a little
+	const TTextLayout* layout = fTextView->GetTextLayout();
+	TPoint point;
+	uint32 line = layout->OffsetToPoint(end, point);
+	point.h += 4;
+	point.v += layout->GetLineHeight(line) - layout->GetLineAscent(line) + 4;
+
+	Display(fTextView, point, GetKeyEventTime());
+	SelectItem(0);
+}
+
+
+void TCompletionMenu::InsertCompletion(TTextView* textView, const TChar* word, STextOffset length, STextOffset prefixLength)
+{
+	ASSERT(length > prefixLength);
+
+	textView->ReplaceSelection(word + prefixLength, length - prefixLength, true, true);
+	textView->ScrollSelectionIntoView();
+}
+
+
+void TCompletionMenu::PreDisplayMenu()
+{
+	// the items are all enabled as they are added
+}
+
+
+void TCompletionMenu::MenuItemSelected(TMenu* /*menu*/, int itemIndex, Time /*time*/)
+{
+	Show(false);
+	fTextView->SetTarget();
+
+	if (itemIndex >= 0)
+	{
+		const TString& word = GetItem(itemIndex)->GetTitle();
+		InsertCompletion(fTextView, word, word.GetLength(), fPrefixLength);
+	}
+}
+
+
+bool TCompletionMenu::DoKeyDown(KeySym key, TModifierState state, const char* string)
+{
+	if (IsModifierKey(key))
+		return true;
+
+	switch (key)
+	{
+		case XK_Up:
+			if (fSelectionIndex > 0)
+				SelectItem(fSelectionIndex - 1);
+			return true;
+
+		case XK_Down:
+			if (fSelectionIndex < fItemList.GetSize() - 1)
+				SelectItem(fSelectionIndex + 1);
+			return true;
+
+		case XK_Return:
+		case XK_KP_Enter:
+		case XK_Tab:
+			if (HasPointerGrab())
+				UngrabPointer(GetKeyEventTime());
+			MenuItemSelected(this, fSelectionIndex, GetKeyEventTime());
+			return true;
+
+		case XK_Escape:
+			if (HasPointerGrab())
+				UngrabPointer(GetKeyEventTime());
+			MenuItemSelected(this, -1, GetKeyEventTime());
+			return true;
+
+		default:
+			// the key goes on to the text view, the next handler
+			if (HasPointerGrab())
+				UngrabPointer(GetKeyEventTime());
+			MenuItemSelected(this, -1, GetKeyEventTime());
+			return TPopupMenu::DoKeyDown(key, state, string);
+	}
+}
+
+
+Time TCompletionMenu::GetKeyEventTime() const
+{
+	// key events are taken by the top level window
+	TTopLevelWindow* topLevel = fTextView->GetTopLevelWindow();
+	ASSERT(topLevel);
+
+	return topLevel->GetCurrentEventTime();
+}
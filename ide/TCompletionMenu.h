@@ -0,0 +1,55 @@
+// ========================================================================================
+//	TCompletionMenu.h			   Copyright (C) 2001-2009 Mike Voydanoff. All rights reserved.
+// ========================================================================================
+/*
+	This program is free software; you can redistribute it and/or
+	modify it under the terms of the GNU General Public License
+	as published by the Free Software Foundation; either version 2
+	of the License, or (at your option) any later version.
+	
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+	
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*/
+#ifndef __TCompletionMenu__
+#define __TCompletionMenu__
+
+#include "fw/TPopupMenu.h"
+#include "fw/TTextLayout.h"
+
+class TTextView;
+
+
+// Pops up below the insertion point with the words that complete the one being typed.
+// Up and Down choose between them and Return or Tab adds the rest of the word.
+// Any other key closes the menu and goes on to the text.
+
+class TCompletionMenu : public TPopupMenu
+{
+public:
+							TCompletionMenu(TTextView* textView, STextOffset prefixLength);
+	virtual 				~TCompletionMenu();
+
+	void					AddCompletion(const TChar* word, STextOffset length);
+	void					DisplayAtInsertionPoint();
+
+	static void				InsertCompletion(TTextView* textView, const TChar* word, STextOffset length, STextOffset prefixLength);
+
+	virtual void			PreDisplayMenu();
+	virtual void			MenuItemSelected(TMenu* menu, int itemIndex, Time time);
+	virtual bool			DoKeyDown(KeySym key, TModifierState state, const char* string);
+
+protected:
+	Time					GetKeyEventTime() const;
+
+protected:
+	TTextView*				fTextView;
+	STextOffset				fPrefixLength;			// of the word before the insertion point
+};
+
+#endif // __TCompletionMenu__
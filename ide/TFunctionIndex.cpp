@@ -0,0 +1,238 @@
+// ========================================================================================
+//	TFunctionIndex.cpp			   Copyright (C) 2001-2009 Mike Voydanoff. All rights reserved.
+// ========================================================================================
+/*
+	This program is free software; you can redistribute it and/or
+	modify it under the terms of the GNU General Public License
+	as published by the Free Software Foundation; either version 2
+	of the License, or (at your option) any later version.
+	
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+	
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "IDECommon.h"
+
+#include "TFunctionIndex.h"
+#include "TFunctionScanner.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+
+const STextOffset kTopLevelSpacing = 256;
+const STextOffset kScanLookaround = 2;			// TFunctionScanner looks at most this far either side of where it is
+
+
+// replaces the items from start to end in array with count new ones
+static void* ReplaceItems(void* array, uint32& arrayCount, uint32 start, uint32 end, const void* items, uint32 count, size_t itemSize)
+{
+	ASSERT(start <= end && end <= arrayCount);
+	uint32 newCount = arrayCount - (end - start) + count;
+
+	if (newCount > arrayCount)
+	{
+		array = realloc(array, newCount * itemSize);
+		ASSERT(array);
+	}
+
+	char* bytes = (char *)array;
+	memmove(bytes + (start + count) * itemSize, bytes + end * itemSize, (arrayCount - end) * itemSize);
+	memcpy(bytes + start * itemSize, items, count * itemSize);
+	arrayCount = newCount;
+
+	return array;
+}
+
+
+// where offset is after oldLength characters at offset are replaced by newLength others
+static inline STextOffset ShiftOffset(STextOffset value, STextOffset offset, STextOffset oldLength, STextOffset newLength)
+{
+	if (value >= offset + oldLength)
+		return value - oldLength + newLength;
+	else if (value > offset)
+		return offset;
+	else
+		return value;
+}
+
+
+TFunctionIndex::TFunctionIndex(const TTextLayout* layout)
+	:	fLayout(layout),
+		fFunctions(NULL),
+		fFunctionCount(0),
+		fTopLevels(NULL),
+		fTopLevelCount(0),
+		fScanned(false),
+		fEdited(false),
+		fEditStart(0),
+		fEditEnd(0),
+		fChangeCount(0),
+		fNewFunctions(NULL),
+		fNewFunctionCount(0),
+		fNewFunctionSize(0),
+		fNewTopLevels(NULL),
+		fNewTopLevelCount(0),
+		fNewTopLevelSize(0),
+		fLastTopLevel(0),
+		fNextTopLevel(0),
+		fResynced(false)
+{
+	ASSERT(layout);
+}
+
+
+TFunctionIndex::~TFunctionIndex()
+{
+	free(fFunctions);
+	free(fTopLevels);
+	free(fNewFunctions);
+	free(fNewTopLevels);
+}
+
+
+void TFunctionIndex::Update()
+{
+	if (fScanned && !fEdited)
+		return;
+
+	if (!fScanned)
+	{
+		// the first time scans everything
+		fFunctionCount = 0;
+		fTopLevels = (STextOffset *)realloc(fTopLevels, sizeof(STextOffset));
+		ASSERT(fTopLevels);
+		fTopLevels[0] = 0;
+		fTopLevelCount = 1;
+		fEditStart = 0;
+		fEditEnd = fLayout->GetTextLength();
+		fScanned = true;
+		fChangeCount++;
+	}
+
+	// start from the last top level the scan before it did not look at the edited text from
+	uint32 first = 0;
+	while (first + 1 < fTopLevelCount && fTopLevels[first + 1] + kScanLookaround <= fEditStart)
+		first++;
+
+	STextOffset start = fTopLevels[first];
+
+	// and stop at the first one after it that does not look back into it
+	fNextTopLevel = first + 1;
+	while (fNextTopLevel < fTopLevelCount && fTopLevels[fNextTopLevel] < fEditEnd + kScanLookaround)
+		fNextTopLevel++;
+
+	fNewFunctionCount = 0;
+	fNewTopLevelCount = 0;
+	fLastTopLevel = start;
+	fResynced = false;
+
+	TFunctionScanner scanner(fLayout);
+	scanner.ScanFunctions(start, FunctionFound, TopLevelFound, this);
+
+	// replace what was found between the two with what was found now
+	STextOffset end = (fResynced ? fTopLevels[fNextTopLevel] : fLayout->GetTextLength() + 1);
+
+	uint32 firstFunction = 0;
+	while (firstFunction < fFunctionCount && fFunctions[firstFunction].offset < start)
+		firstFunction++;
+
+	uint32 lastFunction = firstFunction;
+	while (lastFunction < fFunctionCount && fFunctions[lastFunction].offset < end)
+		lastFunction++;
+
+	fFunctions = (Function *)ReplaceItems(fFunctions, fFunctionCount, firstFunction, lastFunction, fNewFunctions, fNewFunctionCount, sizeof(Function));
+	fTopLevels = (STextOffset *)ReplaceItems(fTopLevels, fTopLevelCount, first + 1, (fResynced ? fNextTopLevel : fTopLevelCount),
+											 fNewTopLevels, fNewTopLevelCount, sizeof(STextOffset));
+
+	fEdited = false;
+}
+
+
+void TFunctionIndex::TextChanged(STextOffset offset, STextOffset oldLength, STextOffset newLength)
+{
+	fChangeCount++;
+
+	if (!fScanned)
+		return;
+
+	// what was in the replaced text moves to its start until Update scans it again
+	for (uint32 i = 0; i < fFunctionCount; i++)
+		fFunctions[i].offset = ShiftOffset(fFunctions[i].offset, offset, oldLength, newLength);
+
+	for (uint32 i = 0; i < fTopLevelCount; i++)
+		fTopLevels[i] = ShiftOffset(fTopLevels[i], offset, oldLength, newLength);
+
+	if (fEdited)
+	{
+		STextOffset editEnd = ShiftOffset(fEditEnd, offset, oldLength, newLength);
+
+		if (offset < fEditStart)
+			fEditStart = offset;
+		fEditEnd = (editEnd > offset + newLength ? editEnd : offset + newLength);
+	}
+	else
+	{
+		fEditStart = offset;
+		fEditEnd = offset + newLength;
+		fEdited = true;
+	}
+}
+
+
+void TFunctionIndex::FunctionFound(const TChar* /*functionName*/, int functionNameLength, STextOffset offset, void* userData)
+{
+	TFunctionIndex* self = (TFunctionIndex *)userData;
+
+	if (self->fNewFunctionCount == self->fNewFunctionSize)
+	{
+		self->fNewFunctionSize = (self->fNewFunctionSize > 0 ? self->fNewFunctionSize * 2 : 64);
+		self->fNewFunctions = (Function *)realloc(self->fNewFunctions, self->fNewFunctionSize * sizeof(Function));
+		ASSERT(self->fNewFunctions);
+	}
+
+	Function& function = self->fNewFunctions[self->fNewFunctionCount++];
+	function.offset = offset;
+	function.length = functionNameLength;
+}
+
+
+bool TFunctionIndex::TopLevelFound(STextOffset offset, void* userData)
+{
+	TFunctionIndex* self = (TFunctionIndex *)userData;
+
+	// back in step with the scan before the edit
+	while (self->fNextTopLevel < self->fTopLevelCount && self->fTopLevels[self->fNextTopLevel] < offset)
+		self->fNextTopLevel++;
+
+	if (self->fNextTopLevel < self->fTopLevelCount && self->fTopLevels[self->fNextTopLevel] == offset)
+	{
+		self->fResynced = true;
+		return false;
+	}
+
+	if (offset >= self->fLastTopLevel + kTopLevelSpacing)
+	{
+		if (self->fNewTopLevelCount == self->fNewTopLevelSize)
+		{
+			self->fNewTopLevelSize = (self->fNewTopLevelSize > 0 ? self->fNewTopLevelSize * 2 : 64);
+			self->fNewTopLevels = (STextOffset *)realloc(self->fNewTopLevels, self->fNewTopLevelSize * sizeof(STextOffset));
+			ASSERT(self->fNewTopLevels);
+		}
+
+		self->fNewTopLevels[self->fNewTopLevelCount++] = offset;
+		self->fLastTopLevel = offset;
+	}
+
+	return true;
+}
@@ -0,0 +1,80 @@
+// ========================================================================================
+//	TFunctionIndex.h			   Copyright (C) 2001-2009 Mike Voydanoff. All rights reserved.
+// ========================================================================================
+/*
+	This program is free software; you can redistribute it and/or
+	modify it under the terms of the GNU General Public License
+	as published by the Free Software Foundation; either version 2
+	of the License, or (at your option) any later version.
+	
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+	
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*/
+
+#ifndef __TFunctionIndex__
+#define __TFunctionIndex__
+
+#include "fw/TTextLayout.h"
+
+
+// The functions TFunctionScanner finds in a text, kept up to date as the text is edited.
+// Along with the functions it remembers offsets about every kTopLevelSpacing characters where
+// the scan was back at the top level. After an edit, Update scans again from the last of these
+// before the edit until the scan is back at the top level at one after it, since nothing after that can have changed.
+
+class TFunctionIndex
+{
+public:
+	struct Function
+	{
+		STextOffset			offset;			// of the name
+		STextOffset			length;
+	};
+
+							TFunctionIndex(const TTextLayout* layout);
+							~TFunctionIndex();
+
+	void					Update();
+	void					TextChanged(STextOffset offset, STextOffset oldLength, STextOffset newLength);
+
+	inline uint32			GetFunctionCount() const { return fFunctionCount; }
+	inline const Function&	GetFunction(uint32 index) const { ASSERT(index < fFunctionCount); return fFunctions[index]; }
+
+	// changes whenever the functions or their offsets may have
+	inline uint32			GetChangeCount() const { return fChangeCount; }
+
+protected:
+	static void				FunctionFound(const TChar* functionName, int functionNameLength, STextOffset offset, void* userData);
+	static bool				TopLevelFound(STextOffset offset, void* userData);
+
+protected:
+	const TTextLayout*		fLayout;
+	Function*				fFunctions;				// sorted by offset
+	uint32					fFunctionCount;
+	STextOffset*			fTopLevels;				// sorted, the first is always 0
+	uint32					fTopLevelCount;
+	bool					fScanned;
+	bool					fEdited;
+	STextOffset				fEditStart;				// the text edited since the last Update
+	STextOffset				fEditEnd;
+	uint32					fChangeCount;
+
+	// while Update is scanning
+	Function*				fNewFunctions;
+	uint32					fNewFunctionCount;
+	uint32					fNewFunctionSize;
+	STextOffset*			fNewTopLevels;
+	uint32					fNewTopLevelCount;
+	uint32					fNewTopLevelSize;
+	STextOffset				fLastTopLevel;
+	uint32					fNextTopLevel;			// the first old top level the scan can come back in step at
+	bool					fResynced;
+};
+
+#endif // __TFunctionIndex__
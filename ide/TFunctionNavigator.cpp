@@ -0,0 +1,343 @@
+// ========================================================================================
+//	TFunctionNavigator.cpp			   Copyright (C) 2001-2009 Mike Voydanoff. All rights reserved.
+// ========================================================================================
+/*
+	This program is free software; you can redistribute it and/or
+	modify it under the terms of the GNU General Public License
+	as published by the Free Software Foundation; either version 2
+	of the License, or (at your option) any later version.
+	
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+	
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "IDECommon.h"
+
+#include "TFunctionNavigator.h"
+#include "TSyntaxTextView.h"
+
+#include "fw/TApplication.h"
+#include "fw/TBehavior.h"
+#include "fw/TDialogWindow.h"
+#include "fw/TDrawContext.h"
+#include "fw/TScroller.h"
+#include "fw/TTextField.h"
+#include "fw/TWindowPositioners.h"
+
+#include "fw/intl.h"
+
+#include <X11/keysym.h>
+#include <ctype.h>
+#include <stdlib.h>
+
+
+// behavior to attach to the filter text field
+class TFunctionNavigatorBehavior : public TBehavior
+{
+public:
+							TFunctionNavigatorBehavior(TTextField* filterTextField, TFunctionListView* listView);
+	virtual					~TFunctionNavigatorBehavior();
+
+	virtual bool			DoCommand(TCommandHandler* sender, TCommandHandler* receiver, TCommandID command);
+	virtual bool			DoKeyDown(KeySym key, TModifierState state, const char* string);
+
+private:
+	TTextField*				fFilterTextField;
+	TFunctionListView*		fListView;
+};
+
+
+TFunctionNavigatorBehavior::TFunctionNavigatorBehavior(TTextField* filterTextField, TFunctionListView* listView)
+	:	fFilterTextField(filterTextField),
+		fListView(listView)
+{
+}
+
+
+TFunctionNavigatorBehavior::~TFunctionNavigatorBehavior()
+{
+}
+
+
+bool TFunctionNavigatorBehavior::DoCommand(TCommandHandler* sender, TCommandHandler* receiver, TCommandID command)
+{
+	if (command == kDataModifiedCommandID && sender == fFilterTextField)
+	{
+		fListView->SetFilter(fFilterTextField->GetText(), fFilterTextField->GetTextLength());
+
+		TDialogWindow* dialog = dynamic_cast<TDialogWindow*>(fFilterTextField->GetTopLevelWindow());
+		ASSERT(dialog);
+		dialog->SetOKEnabled(fListView->GetRowCount() > 0);
+	}
+
+	return false;
+}
+
+
+bool TFunctionNavigatorBehavior::DoKeyDown(KeySym key, TModifierState state, const char* string)
+{
+	// the list moves while typing continues in the filter
+	switch (key)
+	{
+		case XK_Up:
+		case XK_Down:
+		case XK_Page_Up:
+		case XK_Page_Down:
+			return fListView->HandleKeyDown(key, state, string);
+
+		default:
+			return false;
+	}
+}
+
+
+TFunctionListView::TFunctionListView(TWindow* parent, const TRect& bounds, const TChar* text, const TFunctionIndex& index)
+	:	TTextListView(parent, bounds),
+		fText(text),
+		fIndex(index),
+		fMatches(NULL),
+		fMatchSize(0),
+		fFilterStarts(NULL),
+		fFilter(NULL),
+		fFilterLength(0),
+		fFilterSize(0)
+{
+	uint32 count = index.GetFunctionCount();
+
+	// with no filter everything matches
+	fMatchSize = count + 256;
+	fMatches = (Match *)malloc(fMatchSize * sizeof(Match));
+	ASSERT(fMatches);
+
+	for (uint32 i = 0; i < count; i++)
+	{
+		fMatches[i].function = i;
+		fMatches[i].nameOffset = 0;
+	}
+
+	fFilterSize = 16;
+	fFilter = (TChar *)malloc(fFilterSize * sizeof(TChar));
+	fFilterStarts = (uint32 *)malloc((fFilterSize + 2) * sizeof(uint32));
+	ASSERT(fFilter && fFilterStarts);
+
+	fFilterStarts[0] = 0;
+	fFilterStarts[1] = count;
+}
+
+
+TFunctionListView::~TFunctionListView()
+{
+	free(fMatches);
+	free(fFilterStarts);
+	free(fFilter);
+}
+
+
+int TFunctionListView::GetRowCount() const
+{
+	return fFilterStarts[fFilterLength + 1] - fFilterStarts[fFilterLength];
+}
+
+
+void TFunctionListView::GetText(int row, TString& outText)
+{
+	const TFunctionIndex::Function& function = GetRowFunction(row);
+	outText.Set(fText + function.offset, function.length);
+}
+
+
+const TFunctionIndex::Function& TFunctionListView::GetRowFunction(int row) const
+{
+	ASSERT(row >= 0 && row < GetRowCount());
+	return fIndex.GetFunction(fMatches[fFilterStarts[fFilterLength] + row].function);
+}
+
+
+bool TFunctionListView::IsTargetable() const
+{
+	// keep the keys going to the filter
+	return false;
+}
+
+
+void TFunctionListView::CellDoubleClicked(int row, int column)
+{
+	HandleCommand(this, this, kOKCommandID);	// dismiss the dialog
+}
+
+
+bool TFunctionListView::DismissesDialog(TCommandID command) const
+{
+	return (command == kOKCommandID);
+}
+
+
+void TFunctionListView::SetFilter(const TChar* filter, uint32 length)
+{
+	// go back to the longest filter this one starts with, then forward a character at a time
+	uint32 common = 0;
+	while (common < fFilterLength && common < length && fFilter[common] == filter[common])
+		common++;
+
+	if (common == fFilterLength && common == length)
+		return;
+
+	fFilterLength = common;
+
+	for (uint32 i = common; i < length; i++)
+		AddFilterCharacter(filter[i]);
+
+	FilterChanged();
+}
+
+
+void TFunctionListView::AddFilterCharacter(TChar ch)
+{
+	if (fFilterLength == fFilterSize)
+	{
+		fFilterSize *= 2;
+		fFilter = (TChar *)realloc(fFilter, fFilterSize * sizeof(TChar));
+		fFilterStarts = (uint32 *)realloc(fFilterStarts, (fFilterSize + 2) * sizeof(uint32));
+		ASSERT(fFilter && fFilterStarts);
+	}
+
+	uint32 start = fFilterStarts[fFilterLength];
+	uint32 end = fFilterStarts[fFilterLength + 1];
+
+	// the new matches are at most the current ones
+	if (end + (end - start) > fMatchSize)
+	{
+		fMatchSize = end + (end - start) + 256;
+		fMatches = (Match *)realloc(fMatches, fMatchSize * sizeof(Match));
+		ASSERT(fMatches);
+	}
+
+	// lower case matches either case, upper case only itself
+	TChar upper = (islower((unsigned char)ch) ? toupper((unsigned char)ch) : ch);
+	uint32 next = end;
+
+	for (uint32 i = start; i < end; i++)
+	{
+		const Match& match = fMatches[i];
+		const TFunctionIndex::Function& function = fIndex.GetFunction(match.function);
+		const TChar* name = fText + function.offset;
+
+		for (STextOffset offset = match.nameOffset; offset < function.length; offset++)
+		{
+			if (name[offset] == ch || name[offset] == upper)
+			{
+				fMatches[next].function = match.function;
+				fMatches[next].nameOffset = offset + 1;
+				next++;
+				break;
+			}
+		}
+	}
+
+	fFilter[fFilterLength++] = ch;
+	fFilterStarts[fFilterLength + 1] = next;
+}
+
+
+void TFunctionListView::FilterChanged()
+{
+	ComputeContentSize();
+	UnselectAll();
+	ClearLastClick();
+	ScrollToTop();
+
+	if (GetRowCount() > 0)
+	{
+		SelectCell(0, 0);
+		SetLastClick(0, 0);
+	}
+
+	Redraw();
+}
+
+
+void TFunctionListView::SelectFunction(STextOffset offset)
+{
+	// select the last function starting before the offset
+	int count = GetRowCount();
+	int row = 0;
+
+	while (row + 1 < count && GetRowFunction(row + 1).offset <= offset)
+		row++;
+
+	UnselectAll();
+
+	if (row < count)
+	{
+		SelectCell(row, 0);
+		SetLastClick(row, 0);
+		ScrollSelectionIntoView();
+	}
+}
+
+
+void TFunctionNavigator::GotoFunction(TSyntaxTextView* textView)
+{
+	TFunctionIndex& index = textView->GetFunctionIndex();
+	index.Update();
+
+	TRect bounds(0, 0, 400, 400);
+	TDialogWindow* dialog = new TDialogWindow(bounds, _("Goto Function"), true, textView->GetTopLevelWindow());
+
+	TRect r(20, 20, bounds.right - 20, 40);
+	TTextField* filterTextField = new TTextField(dialog, r, TDrawContext::GetDefaultFont(), true);
+	filterTextField->SetFilterTabAndCR(true);
+	filterTextField->SetWindowPositioner(WidthRelativeParent);
+
+	r.Set(20, 50, bounds.right - 20, bounds.bottom - 20);
+	TScroller* scroller = new TScroller(dialog, r, false, true);
+	scroller->SetBorder(1);
+	scroller->SetBackColor(kWhiteColor);
+	scroller->SetWindowPositioner(SizeRelativeParent);
+
+	TFunctionListView* listView = new TFunctionListView(scroller, r, textView->GetText(), index);
+	scroller->SetContainedView(listView);
+
+	filterTextField->AddBehavior(new TFunctionNavigatorBehavior(filterTextField, listView));
+	dialog->SetTarget(filterTextField);
+
+	dialog->Show(true);
+
+	STextOffset start, end;
+	textView->GetSelection(start, end);
+	listView->SelectFunction(start);
+	dialog->SetOKEnabled(listView->GetRowCount() > 0);
+
+	TCommandID command = gApplication->ModalDialog(dialog);
+
+	bool found = false;
+	STextOffset offset = 0;
+
+	if (command == kOKCommandID)
+	{
+		int row = listView->GetFirstSelectedRow();
+		if (row < 0 && listView->GetRowCount() > 0)
+			row = 0;
+
+		if (row >= 0)
+		{
+			offset = listView->GetRowFunction(row).offset;
+			found = true;
+		}
+	}
+
+	dialog->Close();
+
+	if (found)
+		textView->ShowFunction(offset);
+}
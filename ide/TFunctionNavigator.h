@@ -0,0 +1,80 @@
+// ========================================================================================
+//	TFunctionNavigator.h			   Copyright (C) 2001-2009 Mike Voydanoff. All rights reserved.
+// ========================================================================================
+/*
+	This program is free software; you can redistribute it and/or
+	modify it under the terms of the GNU General Public License
+	as published by the Free Software Foundation; either version 2
+	of the License, or (at your option) any later version.
+	
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+	
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*/
+
+#ifndef __TFunctionNavigator__
+#define __TFunctionNavigator__
+
+#include "fw/TTextListView.h"
+#include "TFunctionIndex.h"
+
+class TSyntaxTextView;
+
+
+// Lists the functions whose names contain the characters of a filter in order.
+// The matches for each length of the filter are kept, each a subset of the ones before,
+// so typing a character only looks through the current matches and deleting one goes back a list.
+// Only the rows showing are drawn, so thousands of functions cost nothing until they are visible.
+
+class TFunctionListView : public TTextListView
+{
+public:
+								TFunctionListView(TWindow* parent, const TRect& bounds, const TChar* text, const TFunctionIndex& index);
+
+	virtual int					GetRowCount() const;
+	virtual void				GetText(int row, TString& outText);
+
+	virtual bool				IsTargetable() const;
+	virtual void				CellDoubleClicked(int row, int column);
+	virtual bool				DismissesDialog(TCommandID command) const;
+
+	void						SetFilter(const TChar* filter, uint32 length);
+	void						SelectFunction(STextOffset offset);
+	const TFunctionIndex::Function&	GetRowFunction(int row) const;
+
+protected:
+	virtual						~TFunctionListView();
+
+	void						AddFilterCharacter(TChar ch);
+	void						FilterChanged();
+
+protected:
+	struct Match
+	{
+		uint32					function;
+		STextOffset				nameOffset;			// in the name, just past the last filter character
+	};
+
+	const TChar*				fText;
+	const TFunctionIndex&		fIndex;
+	Match*						fMatches;			// the matches for each filter length, one after the other
+	uint32						fMatchSize;
+	uint32*						fFilterStarts;		// where the matches for each filter length start, plus the end
+	TChar*						fFilter;
+	uint32						fFilterLength;
+	uint32						fFilterSize;
+};
+
+
+class TFunctionNavigator
+{
+public:
+	static void					GotoFunction(TSyntaxTextView* textView);
+};
+
+#endif // __TFunctionNavigator__
@@ -26,6 +26,8 @@
 #include "TFunctionScanner.h"
 
 #include <ctype.h>
+#include <string.h>
+#include <wchar.h>
 
 
 inline bool IsString(const TChar* text)
@@ -41,12 +43,23 @@ inline bool IsComment(const TChar* text)
 
 TFunctionScanner::TFunctionScanner(const TTextLayout* layout)
 	:	fLayout(layout),
+		fText(NULL),
+		fTextLength(0),
 		fTextEnd(NULL)
 {
 	ASSERT(layout);
 }
 
 
+TFunctionScanner::TFunctionScanner(const TChar* text, STextOffset length)
+	:	fLayout(NULL),
+		fText(text),
+		fTextLength(length),
+		fTextEnd(NULL)
+{
+}
+
+
 TFunctionScanner::~TFunctionScanner()
 {
 }
@@ -54,12 +67,20 @@ TFunctionScanner::~TFunctionScanner()
 
 void TFunctionScanner::ScanFunctions(ReportFunctionProc functionProc, void* userData)
 {
-	const TChar* text = fLayout->GetText();
-	if (!text)
+	ScanFunctions(0, functionProc, NULL, userData);
+}
+
+
+void TFunctionScanner::ScanFunctions(STextOffset start, ReportFunctionProc functionProc, ReportTopLevelProc topLevelProc, void* userData)
+{
+	const TChar* textStart = (fLayout ? fLayout->GetText() : fText);
+	STextOffset textLength = (fLayout ? fLayout->GetTextLength() : fTextLength);
+	if (!textStart)
 		return;
 		
-	const TChar* textStart = text;
-	fTextEnd = text + fLayout->GetTextLength();
+	ASSERT(start <= textLength);
+	const TChar* text = textStart + start;
+	fTextEnd = textStart + textLength;
 	fScanState = kTopLevel;
 
 	const TChar* functionName;
@@ -71,6 +92,8 @@ void TFunctionScanner::ScanFunctions(ReportFunctionProc functionProc, void* user
 			switch (fScanState)
 			{
 				case kTopLevel:
+					if (topLevelProc && !topLevelProc(text - textStart, userData))
+						return;
 					ReadFunctionName(text, functionName, functionNameLength);
 					break;
 	
@@ -352,6 +375,15 @@ void TFunctionScanner::NextChar(const TChar*& text)
 	if (text >= fTextEnd)
 		throw 1;
 	
-	fLayout->NextCharacter(text);
+	if (fLayout)
+		fLayout->NextCharacter(text);
+	else
+	{
+		// mblen keeps hidden state, so it is not safe on other threads
+		mbstate_t state;
+		memset(&state, 0, sizeof(state));
+		size_t length = mbrlen(text, fTextEnd - text, &state);
+		text += (length > 0 && length <= (size_t)(fTextEnd - text) ? length : 1);
+	}
 }			
 
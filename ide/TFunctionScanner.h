@@ -27,11 +27,17 @@ class TFunctionScanner
 {
 public:
 	typedef void			(* ReportFunctionProc)(const TChar* functionName, int functionNameLength, STextOffset offset, void* userData);
+	typedef bool			(* ReportTopLevelProc)(STextOffset offset, void* userData);	// return false to stop scanning
 	
 							TFunctionScanner(const TTextLayout* layout);
+							TFunctionScanner(const TChar* text, STextOffset length);	// safe to use off the main thread
 	virtual					~TFunctionScanner();
 	
 	void					ScanFunctions(ReportFunctionProc functionProc, void* userData);
+
+	// scans from start, which must be at the top level, reporting each offset where the scan is back at the top level.
+	// what is found after such an offset depends only on the text from two characters before it on.
+	void					ScanFunctions(STextOffset start, ReportFunctionProc functionProc, ReportTopLevelProc topLevelProc, void* userData);
 	
 protected:
 	void					ReadFunctionName(const TChar*& text, const TChar*& name, STextOffset& nameLength);
@@ -52,6 +58,8 @@ protected:
 	};
 	
 	const TTextLayout*		fLayout;
+	const TChar*			fText;					// when not scanning a layout
+	STextOffset				fTextLength;
 	const TChar*			fTextEnd;
 	TScanState				fScanState;
 };
@@ -24,13 +24,14 @@
 #include "IDECommon.h"
 
 #include "TFunctionsMenu.h"
-#include "TFunctionScanner.h"
-#include "fw/TTextView.h"
+#include "TSyntaxTextView.h"
 
 
-TFunctionsMenu::TFunctionsMenu(TTextView* textView, const TChar* title)
+TFunctionsMenu::TFunctionsMenu(TSyntaxTextView* textView, const TChar* title)
 	:	TMenu(title),
-		fTextView(textView)
+		fTextView(textView),
+		fItemsValid(false),
+		fItemsChangeCount(0)
 {
 	ASSERT(textView);
 }
@@ -41,23 +42,31 @@ TFunctionsMenu::~TFunctionsMenu()
 }
 
 
-void TFunctionsMenu::FunctionHandler(const TChar* functionName, int functionNameLength, STextOffset offset, void* userData)
+void TFunctionsMenu::PreDisplayMenu()
 {
-	TString	title(functionName, functionNameLength);
-	TFunctionsMenu* self = (TFunctionsMenu *)userData;
-	
-	TMenuItem* item = new TMenuItem(title, offset);
-	item->Enable(true);
-	self->AddItem(item);
-}
+	TFunctionIndex& index = fTextView->GetFunctionIndex();
+	index.Update();
 
+	// the items only need making again if the text has changed since
+	if (fItemsValid && fItemsChangeCount == index.GetChangeCount())
+		return;
 
-void TFunctionsMenu::PreDisplayMenu()
-{
 	DeleteAllItems();
 
-	TFunctionScanner	scanner(fTextView->GetTextLayout());
-	scanner.ScanFunctions(FunctionHandler, this);
+	const TChar* text = fTextView->GetTextLayout()->GetText();
+	uint32 count = index.GetFunctionCount();
+
+	for (uint32 i = 0; i < count; i++)
+	{
+		const TFunctionIndex::Function& function = index.GetFunction(i);
+
+		TMenuItem* item = new TMenuItem(TString(text + function.offset, function.length), function.offset);
+		item->Enable(true);
+		AddItem(item);
+	}
+
+	fItemsValid = true;
+	fItemsChangeCount = index.GetChangeCount();
 }
 
 
@@ -68,9 +77,7 @@ void TFunctionsMenu::MenuItemSelected(TMenu* menu, int itemIndex, Time time)
 		TMenuItem* item = menu->GetItem(itemIndex);
 		ASSERT(item);
 	
-		uint32 line = fTextView->GetTextLayout()->OffsetToLine(item->GetCommandID());
-		fTextView->ScrollToLine(line > 0 ? line - 1 : 0);
-		fTextView->SetSelection(fTextView->GetTextLayout()->LineToOffset(line));
+		fTextView->ShowFunction(item->GetCommandID());
 	}
 	
 	TMenu::MenuItemSelected(menu, -1, time);
@@ -23,13 +23,13 @@
 #include "fw/TMenu.h"
 #include "fw/TTextLayout.h"
 
-class TTextView;
+class TSyntaxTextView;
 
 
 class TFunctionsMenu : public TMenu
 {
 public:
-							TFunctionsMenu(TTextView* textView, const TChar* title);
+							TFunctionsMenu(TSyntaxTextView* textView, const TChar* title);
 	virtual 				~TFunctionsMenu();
 
 	virtual void			PreDisplayMenu();
@@ -37,10 +37,9 @@ public:
 	virtual void			MenuItemSelected(TMenu* menu, int itemIndex, Time time);
 
 protected:
-	static void 			FunctionHandler(const TChar* functionName, int functionNameLength, STextOffset offset, void* userData);
-
-protected:
-	TTextView*				fTextView;
+	TSyntaxTextView*		fTextView;
+	bool					fItemsValid;
+	uint32					fItemsChangeCount;		// the function index change count the items were made from
 };
 
 #endif // __TFunctionsMenu__
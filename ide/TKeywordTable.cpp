@@ -0,0 +1,113 @@
+// ========================================================================================
+//	TKeywordTable.cpp			   Copyright (C) 2001-2009 Mike Voydanoff. All rights reserved.
+// ========================================================================================
+/*
+	This program is free software; you can redistribute it and/or
+	modify it under the terms of the GNU General Public License
+	as published by the Free Software Foundation; either version 2
+	of the License, or (at your option) any later version.
+	
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+	
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "IDECommon.h"
+
+#include "TKeywordTable.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+
+TKeywordTable::TKeywordTable(const char** keywords)
+	:	fEntries(NULL),
+		fMask(0),
+		fMinLength(0),
+		fMaxLength(0)
+{
+	ASSERT(keywords);
+
+	uint32 count = 0;
+	while (*keywords[count])
+		count++;
+
+	uint32 size = 4;
+	while (size < count * 2)
+		size *= 2;
+
+	fEntries = (Entry *)calloc(size, sizeof(Entry));
+	ASSERT(fEntries);
+	fMask = size - 1;
+
+	for (uint32 i = 0; i < count; i++)
+	{
+		const char* keyword = keywords[i];
+		uint32 length = strlen(keyword);
+
+		// some lists repeat a keyword
+		if (Contains(keyword, length))
+			continue;
+
+		uint32 index = Hash(keyword, length) & fMask;
+		while (fEntries[index].keyword)
+			index = (index + 1) & fMask;
+
+		fEntries[index].keyword = keyword;
+		fEntries[index].length = length;
+
+		if (fMinLength == 0 || length < fMinLength)
+			fMinLength = length;
+		if (length > fMaxLength)
+			fMaxLength = length;
+	}
+}
+
+
+TKeywordTable::~TKeywordTable()
+{
+	free(fEntries);
+}
+
+
+bool TKeywordTable::Contains(const TChar* text, uint32 length) const
+{
+	if (length < fMinLength || length > fMaxLength)
+		return false;
+
+	uint32 index = Hash(text, length) & fMask;
+
+	while (fEntries[index].keyword)
+	{
+		if (fEntries[index].length == length && memcmp(fEntries[index].keyword, text, length) == 0)
+			return true;
+
+		index = (index + 1) & fMask;
+	}
+
+	return false;
+}
+
+
+// FNV-1a
+uint32 TKeywordTable::Hash(const TChar* text, uint32 length)
+{
+	uint32 hash = 2166136261U;
+
+	for (uint32 i = 0; i < length; i++)
+	{
+		hash ^= (unsigned char)text[i];
+		hash *= 16777619;
+	}
+
+	return hash;
+}
@@ -0,0 +1,51 @@
+// ========================================================================================
+//	TKeywordTable.h			   Copyright (C) 2001-2009 Mike Voydanoff. All rights reserved.
+// ========================================================================================
+/*
+	This program is free software; you can redistribute it and/or
+	modify it under the terms of the GNU General Public License
+	as published by the Free Software Foundation; either version 2
+	of the License, or (at your option) any later version.
+	
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+	
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*/
+
+#ifndef __TKeywordTable__
+#define __TKeywordTable__
+
+
+// Hash set of the keywords of a language, built once from a "" terminated list.
+// The table is kept at most half full so a lookup is usually one hash and one compare.
+
+class TKeywordTable
+{
+public:
+							TKeywordTable(const char** keywords);
+							~TKeywordTable();
+
+	bool					Contains(const TChar* text, uint32 length) const;
+
+protected:
+	struct Entry
+	{
+		const char*			keyword;
+		uint32				length;
+	};
+
+	static uint32			Hash(const TChar* text, uint32 length);
+
+protected:
+	Entry*					fEntries;
+	uint32					fMask;				// table size - 1, a power of 2
+	uint32					fMinLength;
+	uint32					fMaxLength;
+};
+
+#endif // __TKeywordTable__
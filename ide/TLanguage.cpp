@@ -81,3 +81,11 @@ ELanguage GetFileLanguage(const TChar* extension)
 
 	return language;
 }
+
+
+bool LanguageHasFunctions(ELanguage language)
+{
+	return (language == kLanguageC || language == kLanguageCPlusPlus ||
+			language == kLanguageObjC || language == kLanguageObjCPlusPlus ||
+			language == kLanguageJava || language == kLanguageSwift);
+}
@@ -37,5 +37,6 @@ enum ELanguage
 };
 
 ELanguage GetFileLanguage(const TChar* extension);
+bool LanguageHasFunctions(ELanguage language);		// TFunctionScanner understands it
 
 #endif // __TLanguage__
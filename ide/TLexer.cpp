@@ -0,0 +1,630 @@
+// ========================================================================================
+//	TLexer.cpp			   Copyright (C) 2001-2009 Mike Voydanoff. All rights reserved.
+// ========================================================================================
+/*
+	This program is free software; you can redistribute it and/or
+	modify it under the terms of the GNU General Public License
+	as published by the Free Software Foundation; either version 2
+	of the License, or (at your option) any later version.
+	
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+	
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "IDECommon.h"
+
+#include "TLexer.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+
+const uint32 kSymbolCount = TLexer::kSymbolCount;
+const uint32 kSetWords = (kSymbolCount + 31) / 32;
+const uint32 kNoRule = 0xFFFFFFFF;
+
+
+// the rules are first compiled to an NFA, one fragment per rule
+
+struct NFAState
+{
+	uint32		symbols[kSetWords];				// symbols leading to out
+	bool		hasSymbols;						// if not, out and out2 are empty transitions
+	int			out;
+	int			out2;
+	uint32		rule;							// the rule accepted here, or kNoRule
+};
+
+struct NFA
+{
+	NFAState*	states;
+	uint32		count;
+	uint32		size;
+};
+
+struct Fragment
+{
+	int			start;
+	int			end;							// has no transitions yet
+};
+
+struct DFAState
+{
+	int*		nfaStates;						// sorted, only those with symbols or that accept a rule
+	uint32		count;
+	uint32		hash;
+};
+
+struct DFA
+{
+	DFAState*	states;							// states[0] is the state that matches nothing
+	uint32		count;
+	uint32		size;
+};
+
+
+static int NewState(NFA& nfa)
+{
+	if (nfa.count == nfa.size)
+	{
+		nfa.size = (nfa.size > 0 ? nfa.size * 2 : 256);
+		nfa.states = (NFAState *)realloc(nfa.states, nfa.size * sizeof(NFAState));
+		ASSERT(nfa.states);
+	}
+
+	NFAState& state = nfa.states[nfa.count];
+	memset(&state, 0, sizeof(state));
+	state.out = state.out2 = -1;
+	state.rule = kNoRule;
+
+	return nfa.count++;
+}
+
+
+static inline void AddSymbol(NFAState& state, uint32 symbol)
+{
+	state.symbols[symbol / 32] |= (uint32)1 << (symbol % 32);
+	state.hasSymbols = true;
+}
+
+
+static inline bool HasSymbol(const NFAState& state, uint32 symbol)
+{
+	return ((state.symbols[symbol / 32] & ((uint32)1 << (symbol % 32))) != 0);
+}
+
+
+static Fragment MakeFragment(NFA& nfa, int start)
+{
+	Fragment fragment;
+	fragment.start = start;
+	fragment.end = NewState(nfa);
+	nfa.states[start].out = fragment.end;
+
+	return fragment;
+}
+
+
+static Fragment MakeEmpty(NFA& nfa)
+{
+	Fragment fragment;
+	fragment.start = fragment.end = NewState(nfa);
+
+	return fragment;
+}
+
+
+static unsigned char ParseCharacter(const char*& p)
+{
+	ASSERT(*p);
+
+	if (*p != '\\')
+		return *p++;
+
+	p++;
+	ASSERT(*p);
+
+	switch (*p++)
+	{
+		case 't':
+			return '\t';
+		case 'r':
+			return '\r';
+		case 'n':
+			return '\n';
+		case 'f':
+			return '\f';
+		default:
+			return p[-1];
+	}
+}
+
+
+static Fragment ParseAlternation(NFA& nfa, const char*& p);
+
+
+static Fragment ParseClass(NFA& nfa, const char*& p)
+{
+	ASSERT(*p == '[');
+	p++;
+
+	bool negate = (*p == '^');
+	if (negate)
+		p++;
+
+	bool members[256];
+	memset(members, 0, sizeof(members));
+
+	while (*p != ']')
+	{
+		unsigned char first = ParseCharacter(p);
+		unsigned char last = first;
+
+		if (*p == '-' && p[1] != ']')
+		{
+			p++;
+			last = ParseCharacter(p);
+		}
+
+		for (uint32 ch = first; ch <= last; ch++)
+			members[ch] = true;
+	}
+
+	p++;
+
+	int start = NewState(nfa);
+
+	for (uint32 ch = 0; ch < 256; ch++)
+	{
+		if (members[ch] != negate)
+			AddSymbol(nfa.states[start], ch);
+	}
+
+	return MakeFragment(nfa, start);
+}
+
+
+static Fragment ParseAtom(NFA& nfa, const char*& p)
+{
+	if (*p == '(')
+	{
+		p++;
+		Fragment fragment = ParseAlternation(nfa, p);
+		ASSERT(*p == ')');
+		p++;
+
+		return fragment;
+	}
+	else if (*p == '[')
+		return ParseClass(nfa, p);
+
+	int start = NewState(nfa);
+
+	if (*p == '.')
+	{
+		p++;
+		for (uint32 ch = 0; ch < 256; ch++)
+			AddSymbol(nfa.states[start], ch);
+	}
+	else if (*p == '$')
+	{
+		p++;
+		AddSymbol(nfa.states[start], TLexer::kEndOfText);
+	}
+	else
+		AddSymbol(nfa.states[start], ParseCharacter(p));
+
+	return MakeFragment(nfa, start);
+}
+
+
+static Fragment ParseRepeat(NFA& nfa, const char*& p)
+{
+	Fragment fragment = ParseAtom(nfa, p);
+
+	while (*p == '*' || *p == '+' || *p == '?')
+	{
+		int end = NewState(nfa);
+
+		if (*p == '+')
+		{
+			nfa.states[fragment.end].out = fragment.start;
+			nfa.states[fragment.end].out2 = end;
+		}
+		else
+		{
+			int start = NewState(nfa);
+			nfa.states[start].out = fragment.start;
+			nfa.states[start].out2 = end;
+
+			if (*p == '*')
+			{
+				nfa.states[fragment.end].out = fragment.start;
+				nfa.states[fragment.end].out2 = end;
+			}
+			else
+				nfa.states[fragment.end].out = end;
+
+			fragment.start = start;
+		}
+
+		fragment.end = end;
+		p++;
+	}
+
+	return fragment;
+}
+
+
+static Fragment ParseSequence(NFA& nfa, const char*& p)
+{
+	Fragment fragment = MakeEmpty(nfa);
+
+	while (*p && *p != '|' && *p != ')')
+	{
+		Fragment next = ParseRepeat(nfa, p);
+		nfa.states[fragment.end].out = next.start;
+		fragment.end = next.end;
+	}
+
+	return fragment;
+}
+
+
+static Fragment ParseAlternation(NFA& nfa, const char*& p)
+{
+	Fragment fragment = ParseSequence(nfa, p);
+
+	while (*p == '|')
+	{
+		p++;
+		Fragment other = ParseSequence(nfa, p);
+
+		int start = NewState(nfa);
+		int end = NewState(nfa);
+		nfa.states[start].out = fragment.start;
+		nfa.states[start].out2 = other.start;
+		nfa.states[fragment.end].out = end;
+		nfa.states[other.end].out = end;
+
+		fragment.start = start;
+		fragment.end = end;
+	}
+
+	return fragment;
+}
+
+
+static int CompareStates(const void* state1, const void* state2)
+{
+	return *(const int *)state1 - *(const int *)state2;
+}
+
+
+// fills in the states reachable from the count states in ioStates without reading a symbol,
+// keeping only those that read a symbol or accept a rule.  marks and stack are scratch space the size of the NFA.
+static uint32 Closure(const NFA& nfa, int* ioStates, uint32 count, uint32* marks, uint32 mark, int* stack)
+{
+	uint32 depth = 0;
+	uint32 result = 0;
+
+	for (uint32 i = 0; i < count; i++)
+	{
+		if (marks[ioStates[i]] != mark)
+		{
+			marks[ioStates[i]] = mark;
+			stack[depth++] = ioStates[i];
+		}
+	}
+
+	while (depth > 0)
+	{
+		const NFAState& state = nfa.states[stack[--depth]];
+
+		if (state.hasSymbols || state.rule != kNoRule)
+			ioStates[result++] = &state - nfa.states;
+
+		if (!state.hasSymbols)
+		{
+			if (state.out >= 0 && marks[state.out] != mark)
+			{
+				marks[state.out] = mark;
+				stack[depth++] = state.out;
+			}
+
+			if (state.out2 >= 0 && marks[state.out2] != mark)
+			{
+				marks[state.out2] = mark;
+				stack[depth++] = state.out2;
+			}
+		}
+	}
+
+	qsort(ioStates, result, sizeof(int), CompareStates);
+
+	return result;
+}
+
+
+// returns the DFA state for a set of NFA states, adding it if it is new
+static uint32 FindState(DFA& dfa, const int* nfaStates, uint32 count)
+{
+	if (count == 0)
+		return 0;
+
+	uint32 hash = count;
+	for (uint32 i = 0; i < count; i++)
+		hash = hash * 31 + nfaStates[i];
+
+	for (uint32 i = 1; i < dfa.count; i++)
+	{
+		const DFAState& state = dfa.states[i];
+
+		if (state.hash == hash && state.count == count && memcmp(state.nfaStates, nfaStates, count * sizeof(int)) == 0)
+			return i;
+	}
+
+	if (dfa.count == dfa.size)
+	{
+		dfa.size *= 2;
+		dfa.states = (DFAState *)realloc(dfa.states, dfa.size * sizeof(DFAState));
+		ASSERT(dfa.states);
+	}
+
+	DFAState& state = dfa.states[dfa.count];
+	state.nfaStates = (int *)malloc(count * sizeof(int));
+	ASSERT(state.nfaStates);
+	memcpy(state.nfaStates, nfaStates, count * sizeof(int));
+	state.count = count;
+	state.hash = hash;
+
+	return dfa.count++;
+}
+
+
+TLexer::TLexer(const TLexerRule* rules)
+	:	fRules(rules),
+		fModeCount(0),
+		fClassCount(0),
+		fStartStates(NULL),
+		fTransitions(NULL),
+		fLongTokenRules(NULL)
+{
+	ASSERT(rules);
+
+	// compile every rule into one NFA
+	NFA nfa;
+	nfa.states = NULL;
+	nfa.count = nfa.size = 0;
+
+	uint32 ruleCount;
+	for (ruleCount = 0; rules[ruleCount].pattern; ruleCount++)
+	{
+		if (rules[ruleCount].mode >= fModeCount)
+			fModeCount = rules[ruleCount].mode + 1;
+	}
+
+	int* ruleStarts = (int *)malloc((ruleCount + 1) * sizeof(int));
+	int* ruleFirstStates = (int *)malloc((ruleCount + 1) * sizeof(int));
+	ASSERT(ruleStarts && ruleFirstStates);
+
+	for (uint32 i = 0; i < ruleCount; i++)
+	{
+		const char* p = rules[i].pattern;
+		ruleFirstStates[i] = nfa.count;
+		Fragment fragment = ParseAlternation(nfa, p);
+		ASSERT(*p == 0);
+
+		nfa.states[fragment.end].rule = i;
+		ruleStarts[i] = fragment.start;
+	}
+
+	ruleFirstStates[ruleCount] = nfa.count;
+
+	// the rule each NFA state was made for
+	uint32* owners = (uint32 *)malloc(nfa.count * sizeof(uint32));
+	ASSERT(owners);
+
+	for (uint32 i = 0; i < ruleCount; i++)
+	{
+		for (int n = ruleFirstStates[i]; n < ruleFirstStates[i + 1]; n++)
+			owners[n] = i;
+	}
+
+	// then the NFA into a DFA whose states are the sets of NFA states it could be in
+	uint32* marks = (uint32 *)calloc(nfa.count, sizeof(uint32));
+	int* stack = (int *)malloc(nfa.count * sizeof(int));
+	int* targets = (int *)malloc(nfa.count * sizeof(int));
+	int* lastTargets = (int *)malloc(nfa.count * sizeof(int));
+	ASSERT(marks && stack && targets && lastTargets);
+	uint32 mark = 0;
+
+	DFA dfa;
+	dfa.size = 64;
+	dfa.states = (DFAState *)malloc(dfa.size * sizeof(DFAState));
+	ASSERT(dfa.states);
+	dfa.states[0].nfaStates = NULL;
+	dfa.states[0].count = 0;
+	dfa.count = 1;
+
+	fStartStates = (uint32 *)malloc(fModeCount * sizeof(uint32));
+	ASSERT(fStartStates);
+
+	for (uint32 mode = 0; mode < fModeCount; mode++)
+	{
+		uint32 count = 0;
+		for (uint32 i = 0; i < ruleCount; i++)
+		{
+			if (rules[i].mode == mode)
+				targets[count++] = ruleStarts[i];
+		}
+
+		count = Closure(nfa, targets, count, marks, ++mark, stack);
+		fStartStates[mode] = FindState(dfa, targets, count);
+	}
+
+	uint32* transitions = NULL;
+	uint32 transitionRows = 0;
+
+	for (uint32 d = 0; d < dfa.count; d++)
+	{
+		if (d == transitionRows)
+		{
+			transitionRows = dfa.size;
+			transitions = (uint32 *)realloc(transitions, transitionRows * kSymbolCount * sizeof(uint32));
+			ASSERT(transitions);
+		}
+
+		uint32* row = transitions + d * kSymbolCount;
+		uint32 lastCount = 0;
+		uint32 lastState = 0;
+
+		// a copy, since FindState may move dfa.states
+		const DFAState state = dfa.states[d];
+
+		for (uint32 symbol = 0; symbol < kSymbolCount; symbol++)
+		{
+			uint32 count = 0;
+
+			for (uint32 i = 0; i < state.count; i++)
+			{
+				const NFAState& nfaState = nfa.states[state.nfaStates[i]];
+
+				if (nfaState.hasSymbols && HasSymbol(nfaState, symbol))
+					targets[count++] = nfaState.out;
+			}
+
+			// neighboring symbols usually go to the same place
+			if (count == lastCount && memcmp(targets, lastTargets, count * sizeof(int)) == 0)
+			{
+				row[symbol] = lastState;
+				continue;
+			}
+
+			memcpy(lastTargets, targets, count * sizeof(int));
+			lastCount = count;
+
+			count = Closure(nfa, targets, count, marks, ++mark, stack);
+			lastState = row[symbol] = FindState(dfa, targets, count);
+		}
+	}
+
+	// a state accepts the first rule any of its NFA states accepts
+	uint32* acceptedRules = (uint32 *)malloc(dfa.count * sizeof(uint32));
+	ASSERT(acceptedRules);
+
+	for (uint32 d = 0; d < dfa.count; d++)
+	{
+		acceptedRules[d] = kNoRule;
+
+		for (uint32 i = 0; i < dfa.states[d].count; i++)
+		{
+			uint32 rule = nfa.states[dfa.states[d].nfaStates[i]].rule;
+			if (rule < acceptedRules[d])
+				acceptedRules[d] = rule;
+		}
+	}
+
+	// a long token can be matched a piece at a time in states where every rule it could still end as
+	// gives the same token and next mode, since the pieces are colored the same whichever it ends as
+	fLongTokenRules = (uint32 *)malloc(dfa.count * sizeof(uint32));
+	ASSERT(fLongTokenRules);
+
+	for (uint32 d = 0; d < dfa.count; d++)
+	{
+		const DFAState& state = dfa.states[d];
+		uint32 longRule = (state.count > 0 ? owners[state.nfaStates[0]] : kNoRule);
+
+		for (uint32 i = 1; i < state.count && longRule != kNoRule; i++)
+		{
+			uint32 rule = owners[state.nfaStates[i]];
+
+			if (rules[rule].token != rules[longRule].token || rules[rule].nextMode != rules[longRule].nextMode)
+				longRule = kNoRule;
+			else if (rule < longRule)
+				longRule = rule;
+		}
+
+		fLongTokenRules[d] = (longRule != kNoRule ? (longRule + 1) << kRuleShift : 0);
+	}
+
+	// symbols every state treats the same share a column, which keeps the table small enough to stay in the cache
+	uint32* classSymbols = (uint32 *)malloc(kSymbolCount * sizeof(uint32));
+	ASSERT(classSymbols);
+	fClassCount = 0;
+
+	for (uint32 symbol = 0; symbol < kSymbolCount; symbol++)
+	{
+		uint32 c;
+		for (c = 0; c < fClassCount; c++)
+		{
+			uint32 d;
+			for (d = 0; d < dfa.count; d++)
+			{
+				if (transitions[d * kSymbolCount + symbol] != transitions[d * kSymbolCount + classSymbols[c]])
+					break;
+			}
+
+			if (d == dfa.count)
+				break;
+		}
+
+		if (c == fClassCount)
+			classSymbols[fClassCount++] = symbol;
+
+		fSymbolClasses[symbol] = c;
+	}
+
+	// transitions hold the offset of the next state's row, so matching need not multiply,
+	// and the rule it accepts, so matching need not look it up
+	ASSERT(dfa.count * fClassCount <= kRowMask && ruleCount < ((uint32)0xFFFFFFFF >> kRuleShift));
+	fTransitions = (uint32 *)malloc(dfa.count * fClassCount * sizeof(uint32));
+	ASSERT(fTransitions);
+
+	for (uint32 d = 0; d < dfa.count; d++)
+	{
+		for (uint32 c = 0; c < fClassCount; c++)
+		{
+			uint32 state = transitions[d * kSymbolCount + classSymbols[c]];
+			uint32 rule = acceptedRules[state];
+			fTransitions[d * fClassCount + c] = state * fClassCount | (rule != kNoRule ? (rule + 1) << kRuleShift : 0);
+		}
+	}
+
+	for (uint32 mode = 0; mode < fModeCount; mode++)
+		fStartStates[mode] *= fClassCount;
+
+	free(classSymbols);
+	free(acceptedRules);
+	for (uint32 d = 0; d < dfa.count; d++)
+		free(dfa.states[d].nfaStates);
+
+	free(dfa.states);
+	free(transitions);
+	free(lastTargets);
+	free(targets);
+	free(stack);
+	free(marks);
+	free(owners);
+	free(ruleFirstStates);
+	free(ruleStarts);
+	free(nfa.states);
+}
+
+
+TLexer::~TLexer()
+{
+	free(fStartStates);
+	free(fTransitions);
+	free(fLongTokenRules);
+}
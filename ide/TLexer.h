@@ -0,0 +1,195 @@
+// ========================================================================================
+//	TLexer.h			   Copyright (C) 2001-2009 Mike Voydanoff. All rights reserved.
+// ========================================================================================
+/*
+	This program is free software; you can redistribute it and/or
+	modify it under the terms of the GNU General Public License
+	as published by the Free Software Foundation; either version 2
+	of the License, or (at your option) any later version.
+	
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+	
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*/
+
+#ifndef __TLexer__
+#define __TLexer__
+
+#include <string.h>
+#include <wchar.h>
+
+
+// A lexer rule matches pattern in mode, and the lexer then continues in nextMode.
+// Patterns are regular expressions over bytes with ( ) | * + ? . [ ] [^ ] and \ escapes,
+// and $ to match the end of the text.  A multibyte character is matched as its lead byte,
+// so its trail bytes cannot be taken for quotes or backslashes.
+// A table of rules ends with one whose pattern is NULL.
+
+struct TLexerRule
+{
+	uint32					mode;
+	const char*				pattern;
+	uint32					token;
+	uint32					nextMode;
+};
+
+
+// Compiles a table of rules into a DFA, so matching a token costs one table lookup per character.
+// The longest match wins, and of matches of the same length, the first rule.
+
+class TLexer
+{
+public:
+	enum
+	{
+		kEndOfText = 256,					// the symbol $ matches
+		kSymbolCount = 257,
+		kRuleShift = 20,					// transitions into states that accept a rule hold the rule number + 1 above this
+		kRowMask = (1 << kRuleShift) - 1
+	};
+
+							TLexer(const TLexerRule* rules);
+							~TLexer();
+
+	// returns the end of the longest match at text, or NULL if no rule matches.
+	// examined is set past the last character looked at to decide.
+	// a match still going at limit stops there if every rule it could still end as gives the same
+	// token and next mode.  it then returns limit with rule set to one of them, and ioState set
+	// to pass back in to carry on from limit.  ioState is 0 to start a match in mode, and is
+	// left 0 once the match is finished.
+	const TChar*			Match(uint32 mode, uint32& ioState, const TChar* text, const TChar* limit, const TChar* textEnd,
+								  const TLexerRule*& rule, const TChar*& examined) const;
+
+	// returns false if no token in mode starts with ch
+	inline bool				CanStart(uint32 mode, TChar ch) const { return fTransitions[fStartStates[mode] + fSymbolClasses[(unsigned char)ch]] != 0; }
+
+	// returns the start of the character after the one at text
+	static inline const TChar*	NextCharacter(const TChar* text, const TChar* textEnd);
+
+protected:
+	inline bool				SameToken(uint32 accepted1, uint32 accepted2) const;
+
+	const TLexerRule*		fRules;
+	uint32					fModeCount;
+	uint32					fClassCount;
+	uint16					fSymbolClasses[kSymbolCount];	// for each byte and the end of the text
+	uint32*					fStartStates;		// row offset for each mode
+	uint32*					fTransitions;		// fClassCount for each state, state 0 matches nothing
+	uint32*					fLongTokenRules;	// for each state, the rule a match may stop partway through in it, as in fTransitions, or 0
+};
+
+
+inline const TChar* TLexer::NextCharacter(const TChar* text, const TChar* textEnd)
+{
+	// bytes below 0x80 are single characters in every encoding we handle
+	if ((unsigned char)*text < 0x80)
+		return text + 1;
+
+	// mblen keeps hidden state, so it is not safe on other threads
+	mbstate_t state;
+	memset(&state, 0, sizeof(state));
+	size_t length = mbrlen(text, textEnd - text, &state);
+	return text + (length > 0 && length <= (size_t)(textEnd - text) ? length : 1);
+}
+
+
+// accepted1 and accepted2 hold rule numbers as in fTransitions
+inline bool TLexer::SameToken(uint32 accepted1, uint32 accepted2) const
+{
+	const TLexerRule& rule1 = fRules[(accepted1 >> kRuleShift) - 1];
+	const TLexerRule& rule2 = fRules[(accepted2 >> kRuleShift) - 1];
+
+	return (rule1.token == rule2.token && rule1.nextMode == rule2.nextMode);
+}
+
+
+// inline since it is called for every token
+inline const TChar* TLexer::Match(uint32 mode, uint32& ioState, const TChar* text, const TChar* limit, const TChar* textEnd,
+								   const TLexerRule*& rule, const TChar*& examined) const
+{
+	ASSERT(mode < fModeCount);
+	ASSERT(limit <= textEnd);
+
+	uint32 state = (ioState ? ioState : fStartStates[mode]);
+	uint32 accepted = 0;
+	const TChar* matchEnd = NULL;
+
+	// carrying on from a stop partway through, the token is already known
+	if (ioState)
+	{
+		accepted = fLongTokenRules[ioState / fClassCount];
+		matchEnd = text;
+		ioState = 0;
+	}
+
+	const TChar* stop = limit;
+
+	for (;;)
+	{
+		while (text < stop)
+		{
+			const uint32* row = fTransitions + state;
+			uint32 next = row[fSymbolClasses[(unsigned char)*text]];
+			text = NextCharacter(text, textEnd);
+
+			// runs of characters that stay in the same state, as in comments, need not wait on each other's lookups.
+			// the run stops at multibyte characters so they are stepped over whole.
+			if ((next & kRowMask) == state)
+			{
+				while (text < stop && (unsigned char)*text < 0x80 && row[fSymbolClasses[(unsigned char)*text]] == next)
+					text++;
+			}
+
+			state = next & kRowMask;
+
+			if (next > kRowMask)
+			{
+				matchEnd = text;
+				accepted = next;
+			}
+			else if (state == 0)
+				break;
+		}
+
+		if (state == 0 || text >= textEnd)
+			break;
+
+		// still going at limit
+		uint32 longRule = fLongTokenRules[state / fClassCount];
+
+		if (longRule && (!matchEnd || SameToken(accepted, longRule)))
+		{
+			rule = fRules + (longRule >> kRuleShift) - 1;
+			ioState = state;
+			examined = text;
+			return text;
+		}
+
+		stop = textEnd;
+	}
+
+	// still matching at the end of the text
+	if (state != 0)
+	{
+		uint32 next = fTransitions[state + fSymbolClasses[kEndOfText]];
+
+		if (next > kRowMask)
+		{
+			matchEnd = text;
+			accepted = next;
+		}
+	}
+
+	if (matchEnd)
+		rule = fRules + (accepted >> kRuleShift) - 1;
+
+	examined = text;
+	return matchEnd;
+}
+
+#endif // __TLexer__
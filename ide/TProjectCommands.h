@@ -37,6 +37,9 @@ const TCommandID kCloseAllTextWindowsCommandID	= 6011;
 const TCommandID kToggleHTMLMenuCommandID		= 6012;
 const TCommandID kToggleTeXMenuCommandID		= 6013;
 const TCommandID kCompareFilesCommandID			= 6014;
+const TCommandID kGotoFunctionCommandID			= 6015;
+const TCommandID kFindDefinitionCommandID		= 6016;
+const TCommandID kCompleteWordCommandID			= 6017;
 
 // Compare Files commands
 const TCommandID kChoosePath1CommandID			= 6020;
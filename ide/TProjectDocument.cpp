@@ -26,6 +26,7 @@
 #include "TProjectDocument.h"
 #include "TLogDocument.h"
 #include "TProjectCommands.h"
+#include "TSymbolIndex.h"
 #include "fw/TApplication.h"
 #include "fw/TButton.h"
 #include "fw/TCheckBox.h"
@@ -141,7 +142,8 @@ TProjectDocument::TProjectDocument(TFile* file)
 		fUseExternalDebuggerBox(NULL),
 #endif
 		fMakeBeforeDebugBox(NULL),
-		fMakeChild(NULL)
+		fMakeChild(NULL),
+		fSymbolIndex(NULL)
 #ifdef ENABLE_DEBUGGER
 		, fSymDocument(NULL)
 #endif
@@ -167,6 +169,8 @@ TProjectDocument::~TProjectDocument()
 		fSymDocument->SetProjectDocument(NULL);
 	}
 #endif
+
+	delete fSymbolIndex;
 }
 
 
@@ -330,6 +334,36 @@ void TProjectDocument::Open(TDocumentWindow* window)
 	TDocument::Open(window);
 
 	window->SetTarget(fMakePathText);
+
+	StartSymbolIndex();
+}
+
+
+void TProjectDocument::StartSymbolIndex()
+{
+	// a new project has no directory until it is saved
+	if (!fFile.IsSpecified())
+		return;
+
+	// saving the project somewhere else starts over with the files there
+	if (fSymbolIndex && !fSymbolIndex->IndexesProject(fFile))
+	{
+		delete fSymbolIndex;
+		fSymbolIndex = NULL;
+	}
+
+	if (!fSymbolIndex)
+	{
+		fSymbolIndex = new TSymbolIndex(fFile);
+		fSymbolIndex->Update();
+	}
+}
+
+
+void TProjectDocument::FileSaved(const TFile& file)
+{
+	if (fSymbolIndex)
+		fSymbolIndex->FileSaved(file.GetPath());
 }
 
 
@@ -398,6 +432,8 @@ void TProjectDocument::WriteToFile(TFile* file)
 	fSettingsFile.WriteToFile(file);
 
 	file->Close();
+
+	StartSymbolIndex();
 }
 
 
@@ -32,6 +32,7 @@ class TWindow;
 class TTextField;
 class TCheckBox;
 class TChildProcess;
+class TSymbolIndex;
 
 #ifdef ENABLE_DEBUGGER
 class TSymDocument;
@@ -52,6 +53,9 @@ public:
 
 	inline bool						IsMaking() const { return (fMakeChild != NULL); }
 
+	inline TSymbolIndex*			GetSymbolIndex() const { return fSymbolIndex; }
+	void							FileSaved(const TFile& file);
+
 #ifdef ENABLE_DEBUGGER
 	inline TSymDocument*			GetSymDocument() const { return fSymDocument; }
 	inline void						SetSymDocument(TSymDocument* document) { fSymDocument = document; }
@@ -91,6 +95,7 @@ protected:
 	virtual bool					DoCommand(TCommandHandler* sender, TCommandHandler* receiver, TCommandID command);
 
 	TMenuBar*						MakeMenuBar(TWindow* window);
+	void							StartSymbolIndex();
 
 protected:
 	// project settings
@@ -125,6 +130,8 @@ protected:
 	TTime							fBuildStartTime;
 	bool							fDebugAfterMake;
 
+	TSymbolIndex*					fSymbolIndex;	// the functions in the files under the project's directory
+
 #ifdef ENABLE_DEBUGGER
 	TSymDocument*					fSymDocument;
 #endif
@@ -0,0 +1,1413 @@
+// ========================================================================================
+//	TSymbolIndex.cpp			   Copyright (C) 2001-2009 Mike Voydanoff. All rights reserved.
+// ========================================================================================
+/*
+	This program is free software; you can redistribute it and/or
+	modify it under the terms of the GNU General Public License
+	as published by the Free Software Foundation; either version 2
+	of the License, or (at your option) any later version.
+	
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+	
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "IDECommon.h"
+
+#include "TSymbolIndex.h"
+#include "TFunctionScanner.h"
+#include "TLanguage.h"
+
+#include "fw/TApplication.h"
+#include "fw/TException.h"
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifdef HAVE_SYS_INOTIFY_H
+#include <sys/inotify.h>
+#endif
+
+
+const char		kIndexMagic[4] = { 'Z', 'S', 'Y', 'M' };
+const uint32	kIndexVersion = 2;
+const uint32	kNoIndex = (uint32)-1;				// all bits set, so tables are emptied with memset
+const int		kMaxScanThreads = 8;
+const TTime		kIdleFrequency = 250;
+const TTime		kIdleScanTime = 50;					// without threads, how long to walk and scan for each idle
+const TTime		kWalkDelay = 600000;				// without inotify, walk the directory again this long after the last walk finished
+const TTime		kWriteDelay = 5000;					// write the index out once it has been left alone this long
+const uint32	kMaxFileSize = 4 * 1024 * 1024;		// larger files are indexed without scanning them
+const int		kMaxNameLength = 256;
+
+#ifdef HAVE_SYS_INOTIFY_H
+const uint32	kWatchMask = IN_CREATE | IN_CLOSE_WRITE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_ONLYDIR;
+#endif
+
+struct IndexHeader
+{
+	char		magic[4];
+	uint32		version;
+	uint32		fileCount;
+};
+
+struct FileRecord
+{
+	uint32		pathLength;				// followed by the path, then the symbols
+	uint32		size;
+	TFileTime	modification;
+	uint32		symbolsLength;
+};
+
+struct SymbolRecord
+{
+	uint32		line;
+	uint32		nameLength;				// followed by the name, padded so the next record is aligned
+};
+
+
+static inline uint32 RecordLength(uint32 nameLength)
+{
+	// uint32 is eight bytes on some platforms, and the records are read in place
+	return (sizeof(SymbolRecord) + nameLength + sizeof(uint32) - 1) & ~(sizeof(uint32) - 1);
+}
+
+
+TSymbolIndex::TSymbolIndex(const TFile& projectFile)
+	:	fFiles(NULL),
+		fFileCount(0),
+		fFileSize(0),
+		fFreeFile(kNoIndex),
+		fUsedFiles(0),
+		fFileBuckets(NULL),
+		fFileBucketCount(1024),
+		fEntries(NULL),
+		fEntryCount(0),
+		fEntrySize(0),
+		fFreeEntry(kNoIndex),
+		fUsedEntries(0),
+		fBuckets(NULL),
+		fBucketCount(4096),
+		fPending(NULL),
+		fPendingCount(0),
+		fPendingSize(0),
+		fScans(NULL),
+		fScanCount(0),
+		fNextScan(0),
+		fWalking(false),
+		fWalkDirectories(NULL),
+		fWalkDirectoryCount(0),
+		fWalkDirectorySize(0),
+		fWalkFiles(NULL),
+		fWalkFileCount(0),
+		fWalkFileSize(0),
+		fWalkTime(0),
+		fWalkAll(false),
+		fModified(false),
+		fModifiedTime(0)
+#ifdef HAVE_SYS_INOTIFY_H
+		, fNotifyFD(-1),
+		fWatches(NULL),
+		fWatchSize(0),
+		fWalkWatches(NULL),
+		fWalkWatchCount(0),
+		fWalkWatchSize(0),
+		fWalkUnwatched(false)
+#endif
+#ifdef HAVE_LIBPTHREAD
+		, fThreads(NULL),
+		fThreadCount(0),
+		fThreadsDone(0),
+		fWalkThreadRunning(false),
+		fWalkDone(false),
+		fStopWalk(false)
+#endif
+{
+	projectFile.GetDirectory(fRoot);
+
+	TString path;
+	GetIndexPath(projectFile, path);
+	fIndexFile.Specify(path);
+
+	fFileBuckets = (uint32 *)malloc(fFileBucketCount * sizeof(uint32));
+	fBuckets = (uint32 *)malloc(fBucketCount * sizeof(uint32));
+	ASSERT(fFileBuckets && fBuckets);
+	memset(fFileBuckets, 0xFF, fFileBucketCount * sizeof(uint32));
+	memset(fBuckets, 0xFF, fBucketCount * sizeof(uint32));
+
+#ifdef HAVE_LIBPTHREAD
+	pthread_mutex_init(&fScanLock, NULL);
+#endif
+
+#ifdef HAVE_SYS_INOTIFY_H
+	// changes are read while idle, so reading must not block
+	fNotifyFD = inotify_init();
+	if (fNotifyFD >= 0)
+	{
+		fcntl(fNotifyFD, F_SETFL, O_NONBLOCK);
+		fcntl(fNotifyFD, F_SETFD, FD_CLOEXEC);
+	}
+#endif
+
+	Read();
+
+	SetIdleFrequency(kIdleFrequency);
+	EnableIdling(true);
+}
+
+
+TSymbolIndex::~TSymbolIndex()
+{
+#ifdef HAVE_LIBPTHREAD
+	// the walk stops after the directory it is reading
+	if (fWalkThreadRunning)
+	{
+		pthread_mutex_lock(&fScanLock);
+		fStopWalk = true;
+		pthread_mutex_unlock(&fScanLock);
+
+		pthread_join(fWalkThread, NULL);
+	}
+
+	if (fThreadCount > 0)
+	{
+		// the threads stop after the files they are on
+		pthread_mutex_lock(&fScanLock);
+		fNextScan = fScanCount;
+		pthread_mutex_unlock(&fScanLock);
+
+		for (int i = 0; i < fThreadCount; i++)
+			pthread_join(fThreads[i], NULL);
+	}
+
+	free(fThreads);
+	pthread_mutex_destroy(&fScanLock);
+#endif
+
+#ifdef HAVE_SYS_INOTIFY_H
+	if (fNotifyFD >= 0)
+		StopWatching();
+
+	for (uint32 i = 0; i < fWalkWatchCount; i++)
+		free(fWalkWatches[i].path);
+
+	free(fWalkWatches);
+#endif
+
+	// files scanned but not merged in yet are scanned again next time
+	if (fModified)
+		Write();
+
+	for (uint32 i = 0; i < fScanCount; i++)
+	{
+		free(fScans[i].path);
+		free(fScans[i].symbols);
+	}
+
+	for (uint32 i = 0; i < fPendingCount; i++)
+		free(fPending[i]);
+
+	for (uint32 i = 0; i < fWalkDirectoryCount; i++)
+		free(fWalkDirectories[i]);
+
+	for (uint32 i = 0; i < fWalkFileCount; i++)
+		free(fWalkFiles[i].path);
+
+	for (uint32 i = 0; i < fFileCount; i++)
+	{
+		free(fFiles[i].path);
+		free(fFiles[i].symbols);
+	}
+
+	free(fScans);
+	free(fPending);
+	free(fWalkDirectories);
+	free(fWalkFiles);
+	free(fFiles);
+	free(fFileBuckets);
+	free(fEntries);
+	free(fBuckets);
+}
+
+
+void TSymbolIndex::Update()
+{
+	// the walk going already will do
+	if (fWalking)
+		return;
+
+	// files added while walking count as seen
+	for (uint32 i = 0; i < fFileCount; i++)
+		fFiles[i].seen = false;
+
+	fWalkAll = true;
+	AddWalkDirectory("");
+	StartWalk();
+}
+
+
+void TSymbolIndex::StartWalk()
+{
+	fWalking = true;
+
+#ifdef HAVE_LIBPTHREAD
+	// if the thread does not start, DoIdle does the walking
+	fWalkDone = fStopWalk = false;
+	fWalkThreadRunning = (pthread_create(&fWalkThread, NULL, WalkThread, this) == 0);
+#endif
+}
+
+
+void TSymbolIndex::FileSaved(const TChar* path)
+{
+	uint32 rootLength = fRoot.GetLength();
+
+	if (strncmp(path, fRoot, rootLength) == 0 && IsIndexedFile(path + rootLength))
+	{
+		AddPending(path + rootLength);
+		StartScan();
+	}
+}
+
+
+uint32 TSymbolIndex::FindSymbol(const TChar* name, uint32 length, Definition* definitions, uint32 maxCount) const
+{
+	const char* key;
+	uint32 keyLength;
+	GetKey(name, length, key, keyLength);
+
+	uint32 hash = Hash(key, keyLength);
+	uint32 count = 0;
+
+	for (uint32 i = fBuckets[hash & (fBucketCount - 1)]; i != kNoIndex; i = fEntries[i].next)
+	{
+		const Entry& entry = fEntries[i];
+		if (entry.hash != hash)
+			continue;
+
+		const SymbolRecord* record = (const SymbolRecord *)(fFiles[entry.file].symbols + entry.symbol);
+		const char* symbolKey;
+		uint32 symbolKeyLength;
+		GetKey((const char *)(record + 1), record->nameLength, symbolKey, symbolKeyLength);
+
+		if (symbolKeyLength == keyLength && memcmp(symbolKey, key, keyLength) == 0)
+		{
+			if (count < maxCount)
+			{
+				definitions[count].file = entry.file;
+				definitions[count].line = record->line;
+			}
+
+			count++;
+		}
+	}
+
+	return count;
+}
+
+
+bool TSymbolIndex::IndexesProject(const TFile& projectFile) const
+{
+	TString path;
+	GetIndexPath(projectFile, path);
+
+	return (strcmp(path, fIndexFile.GetPath()) == 0);
+}
+
+
+void TSymbolIndex::GetIndexPath(const TFile& projectFile, TString& path)
+{
+	projectFile.GetDirectory(path);
+	path += ".";
+	path += projectFile.GetFileName();
+	path += ".symbols";
+}
+
+
+void TSymbolIndex::GetFilePath(uint32 file, TString& path) const
+{
+	ASSERT(file < fFileCount && fFiles[file].path);
+
+	path = fRoot;
+	path += fFiles[file].path;
+}
+
+
+void TSymbolIndex::DoIdle()
+{
+	// without threads, walking and scanning share a little time each idle
+	TTime stopTime = gApplication->GetCurrentTime() + kIdleScanTime;
+
+	if (fWalking && WalkDone(stopTime))
+		FinishWalk();
+
+	if (fScanCount > 0 && ScanDone(stopTime))
+		FinishScan();
+
+	bool watching = false;
+
+#ifdef HAVE_SYS_INOTIFY_H
+	// changes wait while walking, since they may be under directories it has not added the watches for yet
+	if (fNotifyFD >= 0 && !fWalking)
+		ReadNotifications();
+
+	watching = (fNotifyFD >= 0);
+#endif
+
+	if (fPendingCount > 0)
+		StartScan();
+	else if (!watching && !fWalking && fScanCount == 0 && gApplication->GetCurrentTime() - fWalkTime >= kWalkDelay)
+		Update();
+
+	if (fModified && fScanCount == 0 && gApplication->GetCurrentTime() - fModifiedTime >= kWriteDelay)
+		Write();
+}
+
+
+// reads the next directory waiting to be walked, returning false once there are none.
+// called on the walking thread, so it only touches the walk lists.
+bool TSymbolIndex::WalkNext()
+{
+	if (fWalkDirectoryCount == 0)
+		return false;
+
+	char* directory = fWalkDirectories[--fWalkDirectoryCount];
+	uint32 rootLength = fRoot.GetLength();
+
+	char path[PATH_MAX + 1];
+	int pathLength = snprintf(path, sizeof(path), "%s%s", (const char *)fRoot, directory);
+
+	DIR* dir = (pathLength < (int)sizeof(path) ? opendir(path) : NULL);
+	if (!dir)
+	{
+		free(directory);
+		return true;
+	}
+
+#ifdef HAVE_SYS_INOTIFY_H
+	// watched before it is read, so nothing changing in between is missed
+	if (fNotifyFD >= 0)
+	{
+		int watch = inotify_add_watch(fNotifyFD, path, kWatchMask);
+
+		if (watch >= 0)
+		{
+			if (fWalkWatchCount == fWalkWatchSize)
+			{
+				fWalkWatchSize = fWalkWatchSize * 2 + 64;
+				fWalkWatches = (WalkWatch *)realloc(fWalkWatches, fWalkWatchSize * sizeof(WalkWatch));
+				ASSERT(fWalkWatches);
+			}
+
+			fWalkWatches[fWalkWatchCount].watch = watch;
+			fWalkWatches[fWalkWatchCount].path = directory;
+			fWalkWatchCount++;
+			directory = NULL;
+		}
+		else
+			fWalkUnwatched = true;
+	}
+#endif
+
+	free(directory);
+
+	int space = sizeof(path) - pathLength;
+	dirent* entry;
+
+	while ((entry = readdir(dir)) != NULL)
+	{
+		// skips ".", ".." and hidden files and directories, like the index itself
+		if (entry->d_name[0] == '.')
+			continue;
+
+		// leaves room for the '/' after a directory
+		if (snprintf(path + pathLength, space, "%s", entry->d_name) >= space - 1)
+			continue;
+
+		// symbolic links to directories are not followed, they may loop
+		struct stat statBuf;
+		if (lstat(path, &statBuf) != 0)
+			continue;
+
+		if (S_ISDIR(statBuf.st_mode))
+		{
+			strcat(path, "/");
+			AddWalkDirectory(path + rootLength);
+		}
+		else if (IsIndexedFile(entry->d_name))
+		{
+			if (S_ISLNK(statBuf.st_mode) && stat(path, &statBuf) != 0)
+				continue;
+			if (!S_ISREG(statBuf.st_mode))
+				continue;
+
+			if (fWalkFileCount == fWalkFileSize)
+			{
+				fWalkFileSize = fWalkFileSize * 2 + 256;
+				fWalkFiles = (WalkFile *)realloc(fWalkFiles, fWalkFileSize * sizeof(WalkFile));
+				ASSERT(fWalkFiles);
+			}
+
+			WalkFile& file = fWalkFiles[fWalkFileCount++];
+			file.path = strdup(path + rootLength);
+			ASSERT(file.path);
+			file.size = statBuf.st_size;
+			file.modification = statBuf.st_mtime;
+		}
+	}
+
+	closedir(dir);
+	return true;
+}
+
+
+// returns true once the walk is finished
+bool TSymbolIndex::WalkDone(TTime stopTime)
+{
+#ifdef HAVE_LIBPTHREAD
+	if (fWalkThreadRunning)
+	{
+		pthread_mutex_lock(&fScanLock);
+		bool done = fWalkDone;
+		pthread_mutex_unlock(&fScanLock);
+
+		if (!done)
+			return false;
+
+		pthread_join(fWalkThread, NULL);
+		fWalkThreadRunning = false;
+		return true;
+	}
+#endif
+
+	// without a thread, walk a little at a time
+	while (WalkNext())
+	{
+		if (gApplication->GetCurrentTime() >= stopTime)
+			return false;
+	}
+
+	return true;
+}
+
+
+// compares what the walk found with the index
+void TSymbolIndex::FinishWalk()
+{
+#ifdef HAVE_SYS_INOTIFY_H
+	for (uint32 i = 0; i < fWalkWatchCount; i++)
+		SetWatch(fWalkWatches[i].watch, fWalkWatches[i].path);
+
+	free(fWalkWatches);
+	fWalkWatches = NULL;
+	fWalkWatchCount = fWalkWatchSize = 0;
+
+	// changes under a directory without a watch would be missed, so walk again every so often instead
+	if (fWalkUnwatched && fNotifyFD >= 0)
+		StopWatching();
+#endif
+
+	for (uint32 i = 0; i < fWalkFileCount; i++)
+	{
+		const WalkFile& walkFile = fWalkFiles[i];
+		uint32 file = FindFile(walkFile.path);
+
+		if (file != kNoIndex)
+			fFiles[file].seen = true;
+
+		if (file == kNoIndex || fFiles[file].size != walkFile.size || fFiles[file].modification != walkFile.modification)
+			AddPending(walkFile.path);
+
+		free(walkFile.path);
+	}
+
+	free(fWalkFiles);
+	fWalkFiles = NULL;
+	fWalkFileCount = fWalkFileSize = 0;
+
+	// only a walk of the whole directory can tell a file is gone
+	for (uint32 i = 0; fWalkAll && i < fFileCount; i++)
+	{
+		if (fFiles[i].path && !fFiles[i].seen)
+		{
+			RemoveFile(i);
+			fModified = true;
+			fModifiedTime = gApplication->GetCurrentTime();
+		}
+	}
+
+	fWalking = false;
+	fWalkTime = gApplication->GetCurrentTime();
+}
+
+
+void TSymbolIndex::AddWalkDirectory(const char* path)
+{
+	if (fWalkDirectoryCount == fWalkDirectorySize)
+	{
+		fWalkDirectorySize = fWalkDirectorySize * 2 + 64;
+		fWalkDirectories = (char **)realloc(fWalkDirectories, fWalkDirectorySize * sizeof(char *));
+		ASSERT(fWalkDirectories);
+	}
+
+	fWalkDirectories[fWalkDirectoryCount] = strdup(path);
+	ASSERT(fWalkDirectories[fWalkDirectoryCount]);
+	fWalkDirectoryCount++;
+}
+
+
+#ifdef HAVE_SYS_INOTIFY_H
+// queues the files that changed for scanning and walks the directories that appeared
+void TSymbolIndex::ReadNotifications()
+{
+	int buffer[1024];							// aligned for inotify_event
+	ssize_t length;
+	bool overflow = false;
+
+	while ((length = read(fNotifyFD, buffer, sizeof(buffer))) > 0)
+	{
+		const char* next = (const char *)buffer;
+		const char* end = next + length;
+
+		while (next < end)
+		{
+			const inotify_event* event = (const inotify_event *)next;
+			next += sizeof(inotify_event) + event->len;
+
+			if (event->mask & IN_Q_OVERFLOW)
+			{
+				overflow = true;
+				continue;
+			}
+
+			if (event->mask & IN_IGNORED)
+			{
+				RemoveWatch(event->wd);
+				continue;
+			}
+
+			if (event->len == 0 || event->name[0] == '.' || event->wd < 0 || event->wd >= fWatchSize || !fWatches[event->wd])
+				continue;
+
+			// leaves room for the '/' after a directory
+			char path[PATH_MAX + 1];
+			if (snprintf(path, sizeof(path), "%s%s", fWatches[event->wd], event->name) >= (int)sizeof(path) - 1)
+				continue;
+
+			if (event->mask & IN_ISDIR)
+			{
+				strcat(path, "/");
+
+				if (event->mask & (IN_CREATE | IN_MOVED_TO))
+					AddWalkDirectory(path);
+				else if (event->mask & (IN_DELETE | IN_MOVED_FROM))
+					RemoveDirectory(path);
+			}
+			else if (IsIndexedFile(event->name))
+			{
+				// scanning a file that is gone removes it, and a new file is often created and written at once
+				if (fPendingCount == 0 || strcmp(fPending[fPendingCount - 1], path) != 0)
+					AddPending(path);
+			}
+		}
+	}
+
+	// events were lost, so only walking everything again will do
+	if (overflow)
+	{
+		for (uint32 i = 0; i < fWalkDirectoryCount; i++)
+			free(fWalkDirectories[i]);
+		fWalkDirectoryCount = 0;
+
+		Update();
+	}
+	else if (fWalkDirectoryCount > 0)
+	{
+		fWalkAll = false;
+		StartWalk();
+	}
+}
+
+
+// forgets the files under a directory that was deleted or moved away
+void TSymbolIndex::RemoveDirectory(const char* path)
+{
+	uint32 length = strlen(path);
+
+	for (uint32 i = 0; i < fFileCount; i++)
+	{
+		if (fFiles[i].path && strncmp(fFiles[i].path, path, length) == 0)
+		{
+			RemoveFile(i);
+			fModified = true;
+			fModifiedTime = gApplication->GetCurrentTime();
+		}
+	}
+
+	// a directory moved away keeps its watches, under paths that are no longer right
+	for (int watch = 0; watch < fWatchSize; watch++)
+	{
+		if (fWatches[watch] && strncmp(fWatches[watch], path, length) == 0)
+		{
+			inotify_rm_watch(fNotifyFD, watch);
+			RemoveWatch(watch);
+		}
+	}
+}
+
+
+// takes the path, which replaces any the watch had from an earlier walk
+void TSymbolIndex::SetWatch(int watch, char* path)
+{
+	if (watch >= fWatchSize)
+	{
+		int size = watch * 2 + 64;
+		fWatches = (char **)realloc(fWatches, size * sizeof(char *));
+		ASSERT(fWatches);
+		memset(fWatches + fWatchSize, 0, (size - fWatchSize) * sizeof(char *));
+		fWatchSize = size;
+	}
+
+	free(fWatches[watch]);
+	fWatches[watch] = path;
+}
+
+
+void TSymbolIndex::RemoveWatch(int watch)
+{
+	if (watch >= 0 && watch < fWatchSize)
+	{
+		free(fWatches[watch]);
+		fWatches[watch] = NULL;
+	}
+}
+
+
+void TSymbolIndex::StopWatching()
+{
+	close(fNotifyFD);
+	fNotifyFD = -1;
+
+	for (int i = 0; i < fWatchSize; i++)
+		free(fWatches[i]);
+
+	free(fWatches);
+	fWatches = NULL;
+	fWatchSize = 0;
+}
+#endif // HAVE_SYS_INOTIFY_H
+
+
+#ifdef HAVE_LIBPTHREAD
+void* TSymbolIndex::WalkThread(void* data)
+{
+	TSymbolIndex* index = (TSymbolIndex *)data;
+
+	for (;;)
+	{
+		pthread_mutex_lock(&index->fScanLock);
+		bool stop = index->fStopWalk;
+		pthread_mutex_unlock(&index->fScanLock);
+
+		if (stop || !index->WalkNext())
+			break;
+	}
+
+	pthread_mutex_lock(&index->fScanLock);
+	index->fWalkDone = true;
+	pthread_mutex_unlock(&index->fScanLock);
+
+	return NULL;
+}
+#endif
+
+
+void TSymbolIndex::AddPending(const char* path)
+{
+	if (fPendingCount == fPendingSize)
+	{
+		fPendingSize = fPendingSize * 2 + 64;
+		fPending = (char **)realloc(fPending, fPendingSize * sizeof(char *));
+		ASSERT(fPending);
+	}
+
+	fPending[fPendingCount] = strdup(path);
+	ASSERT(fPending[fPendingCount]);
+	fPendingCount++;
+}
+
+
+void TSymbolIndex::StartScan()
+{
+	// files to scan while a scan is going wait for the next one
+	if (fScanCount > 0 || fPendingCount == 0)
+		return;
+
+	fScans = (Scan *)malloc(fPendingCount * sizeof(Scan));
+	ASSERT(fScans);
+	memset(fScans, 0, fPendingCount * sizeof(Scan));
+
+	for (uint32 i = 0; i < fPendingCount; i++)
+		fScans[i].path = fPending[i];
+
+	fScanCount = fPendingCount;
+	fNextScan = 0;
+	fPendingCount = 0;
+
+#ifdef HAVE_LIBPTHREAD
+	// even a single saved file is scanned on a thread, since it may be large
+	long processors = sysconf(_SC_NPROCESSORS_ONLN);
+	int threads = (processors < 1 ? 1 : (processors > kMaxScanThreads ? kMaxScanThreads : processors));
+	if ((uint32)threads > fScanCount)
+		threads = fScanCount;
+
+	fThreads = (pthread_t *)malloc(threads * sizeof(pthread_t));
+	ASSERT(fThreads);
+	fThreadsDone = 0;
+
+	// if no thread starts, DoIdle does the scanning
+	for (fThreadCount = 0; fThreadCount < threads; fThreadCount++)
+	{
+		if (pthread_create(&fThreads[fThreadCount], NULL, ScanThread, this) != 0)
+			break;
+	}
+#endif
+}
+
+
+bool TSymbolIndex::ScanNext()
+{
+#ifdef HAVE_LIBPTHREAD
+	pthread_mutex_lock(&fScanLock);
+#endif
+
+	uint32 scan = fNextScan;
+	if (scan < fScanCount)
+		fNextScan++;
+
+#ifdef HAVE_LIBPTHREAD
+	pthread_mutex_unlock(&fScanLock);
+#endif
+
+	if (scan >= fScanCount)
+		return false;
+
+	ScanFile(fRoot, fScans[scan]);
+	return true;
+}
+
+
+// returns true once every file has been scanned
+bool TSymbolIndex::ScanDone(TTime stopTime)
+{
+#ifdef HAVE_LIBPTHREAD
+	if (fThreadCount > 0)
+	{
+		pthread_mutex_lock(&fScanLock);
+		bool done = (fThreadsDone == fThreadCount);
+		pthread_mutex_unlock(&fScanLock);
+
+		if (!done)
+			return false;
+
+		for (int i = 0; i < fThreadCount; i++)
+			pthread_join(fThreads[i], NULL);
+
+		free(fThreads);
+		fThreads = NULL;
+		fThreadCount = 0;
+		return true;
+	}
+#endif
+
+	// without threads, scan a little at a time
+	while (ScanNext())
+	{
+		if (gApplication->GetCurrentTime() >= stopTime)
+			return false;
+	}
+
+	return true;
+}
+
+
+#ifdef HAVE_LIBPTHREAD
+void* TSymbolIndex::ScanThread(void* data)
+{
+	TSymbolIndex* index = (TSymbolIndex *)data;
+
+	while (index->ScanNext())
+		;
+
+	pthread_mutex_lock(&index->fScanLock);
+	index->fThreadsDone++;
+	pthread_mutex_unlock(&index->fScanLock);
+
+	return NULL;
+}
+#endif
+
+
+// called on the scanning threads, so it only touches the scan
+void TSymbolIndex::ScanFile(const char* root, Scan& scan)
+{
+	char path[PATH_MAX + 1];
+	snprintf(path, sizeof(path), "%s%s", root, scan.path);
+
+	int fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return;
+
+	struct stat statBuf;
+	if (fstat(fd, &statBuf) != 0 || !S_ISREG(statBuf.st_mode))
+	{
+		close(fd);
+		return;
+	}
+
+	scan.exists = true;
+	scan.size = statBuf.st_size;
+	scan.modification = statBuf.st_mtime;
+
+	if (scan.size > kMaxFileSize)
+	{
+		close(fd);
+		return;
+	}
+
+	// the scanner looks a character or two either side of where it is
+	TChar* buffer = (TChar *)malloc(scan.size + 3);
+	ASSERT(buffer);
+	buffer[0] = buffer[1] = 0;
+	TChar* text = buffer + 2;
+
+	uint32 length = 0;
+	while (length < scan.size)
+	{
+		ssize_t count = read(fd, text + length, scan.size - length);
+		if (count <= 0)
+			break;
+		length += count;
+	}
+
+	close(fd);
+	text[length] = 0;
+
+	scan.text = text;
+	scan.line = 0;
+	scan.lineOffset = 0;
+
+	TFunctionScanner scanner(text, length);
+	scanner.ScanFunctions(FunctionFound, &scan);
+
+	scan.text = NULL;
+	free(buffer);
+}
+
+
+void TSymbolIndex::FunctionFound(const TChar* functionName, int functionNameLength, STextOffset offset, void* userData)
+{
+	Scan* scan = (Scan *)userData;
+
+	if (functionNameLength <= 0 || functionNameLength > kMaxNameLength)
+		return;
+
+	// functions are found in order, so lines are only counted from the last one
+	const TChar* text = scan->text;
+	for (STextOffset i = scan->lineOffset; i < offset; i++)
+	{
+		if (text[i] == '\n' || (text[i] == '\r' && text[i + 1] != '\n'))
+			scan->line++;
+	}
+	scan->lineOffset = offset;
+
+	uint32 length = RecordLength(functionNameLength);
+
+	if (scan->symbolsLength + length > scan->symbolsSize)
+	{
+		scan->symbolsSize = (scan->symbolsLength + length) * 2;
+		scan->symbols = (char *)realloc(scan->symbols, scan->symbolsSize);
+		ASSERT(scan->symbols);
+	}
+
+	SymbolRecord* record = (SymbolRecord *)(scan->symbols + scan->symbolsLength);
+	record->line = scan->line;
+	record->nameLength = functionNameLength;
+
+	char* name = (char *)(record + 1);
+	memcpy(name, functionName, functionNameLength);
+	memset(name + functionNameLength, 0, length - sizeof(SymbolRecord) - functionNameLength);
+
+	scan->symbolsLength += length;
+}
+
+
+void TSymbolIndex::FinishScan()
+{
+	for (uint32 i = 0; i < fScanCount; i++)
+	{
+		Scan& scan = fScans[i];
+		uint32 file = FindFile(scan.path);
+
+		if (scan.exists)
+		{
+			if (file == kNoIndex)
+				file = AddFile(scan.path);
+
+			fFiles[file].size = scan.size;
+			fFiles[file].modification = scan.modification;
+			SetSymbols(file, scan.symbols, scan.symbolsLength);
+		}
+		else
+		{
+			if (file != kNoIndex)
+				RemoveFile(file);
+
+			free(scan.symbols);
+		}
+
+		free(scan.path);
+	}
+
+	free(fScans);
+	fScans = NULL;
+	fScanCount = 0;
+	fNextScan = 0;
+
+	fModified = true;
+	fModifiedTime = gApplication->GetCurrentTime();
+}
+
+
+uint32 TSymbolIndex::FindFile(const char* path) const
+{
+	uint32 hash = Hash(path, strlen(path));
+
+	for (uint32 file = fFileBuckets[hash & (fFileBucketCount - 1)]; file != kNoIndex; file = fFiles[file].next)
+	{
+		if (fFiles[file].pathHash == hash && strcmp(fFiles[file].path, path) == 0)
+			return file;
+	}
+
+	return kNoIndex;
+}
+
+
+uint32 TSymbolIndex::AddFile(const char* path)
+{
+	uint32 file;
+
+	if (fFreeFile != kNoIndex)
+	{
+		file = fFreeFile;
+		fFreeFile = fFiles[file].next;
+	}
+	else
+	{
+		if (fFileCount == fFileSize)
+		{
+			fFileSize = fFileSize * 2 + 256;
+			fFiles = (FileEntry *)realloc(fFiles, fFileSize * sizeof(FileEntry));
+			ASSERT(fFiles);
+		}
+
+		file = fFileCount++;
+	}
+
+	FileEntry& entry = fFiles[file];
+	entry.path = strdup(path);
+	ASSERT(entry.path);
+	entry.size = 0;
+	entry.modification = 0;
+	entry.symbols = NULL;
+	entry.symbolsLength = 0;
+	entry.seen = true;
+	entry.pathHash = Hash(path, strlen(path));
+
+	uint32 bucket = entry.pathHash & (fFileBucketCount - 1);
+	entry.next = fFileBuckets[bucket];
+	fFileBuckets[bucket] = file;
+
+	if (++fUsedFiles > fFileBucketCount * 2)
+		GrowFileBuckets();
+
+	return file;
+}
+
+
+void TSymbolIndex::RemoveFile(uint32 file)
+{
+	FileEntry& entry = fFiles[file];
+	ASSERT(entry.path);
+
+	RemoveEntries(file);
+	free(entry.symbols);
+	entry.symbols = NULL;
+	entry.symbolsLength = 0;
+
+	uint32* link = &fFileBuckets[entry.pathHash & (fFileBucketCount - 1)];
+	while (*link != file)
+	{
+		ASSERT(*link != kNoIndex);
+		link = &fFiles[*link].next;
+	}
+	*link = entry.next;
+
+	free(entry.path);
+	entry.path = NULL;
+	entry.next = fFreeFile;
+	fFreeFile = file;
+	fUsedFiles--;
+}
+
+
+void TSymbolIndex::SetSymbols(uint32 file, char* symbols, uint32 symbolsLength)
+{
+	FileEntry& entry = fFiles[file];
+
+	RemoveEntries(file);
+	free(entry.symbols);
+
+	entry.symbols = symbols;
+	entry.symbolsLength = symbolsLength;
+	AddEntries(file);
+}
+
+
+void TSymbolIndex::AddEntries(uint32 file)
+{
+	const FileEntry& fileEntry = fFiles[file];
+	uint32 offset = 0;
+
+	while (offset < fileEntry.symbolsLength)
+	{
+		const SymbolRecord* record = (const SymbolRecord *)(fileEntry.symbols + offset);
+		const char* key;
+		uint32 keyLength;
+		GetKey((const char *)(record + 1), record->nameLength, key, keyLength);
+
+		uint32 i;
+
+		if (fFreeEntry != kNoIndex)
+		{
+			i = fFreeEntry;
+			fFreeEntry = fEntries[i].next;
+		}
+		else
+		{
+			if (fEntryCount == fEntrySize)
+			{
+				fEntrySize = fEntrySize * 2 + 1024;
+				fEntries = (Entry *)realloc(fEntries, fEntrySize * sizeof(Entry));
+				ASSERT(fEntries);
+			}
+
+			i = fEntryCount++;
+		}
+
+		Entry& entry = fEntries[i];
+		entry.hash = Hash(key, keyLength);
+		entry.file = file;
+		entry.symbol = offset;
+
+		uint32 bucket = entry.hash & (fBucketCount - 1);
+		entry.next = fBuckets[bucket];
+		fBuckets[bucket] = i;
+
+		if (++fUsedEntries > fBucketCount * 2)
+			GrowBuckets();
+
+		offset += RecordLength(record->nameLength);
+	}
+}
+
+
+void TSymbolIndex::RemoveEntries(uint32 file)
+{
+	const FileEntry& fileEntry = fFiles[file];
+	uint32 offset = 0;
+
+	while (offset < fileEntry.symbolsLength)
+	{
+		const SymbolRecord* record = (const SymbolRecord *)(fileEntry.symbols + offset);
+		const char* key;
+		uint32 keyLength;
+		GetKey((const char *)(record + 1), record->nameLength, key, keyLength);
+
+		uint32* link = &fBuckets[Hash(key, keyLength) & (fBucketCount - 1)];
+
+		while (*link != kNoIndex)
+		{
+			uint32 i = *link;
+			Entry& entry = fEntries[i];
+
+			if (entry.file == file && entry.symbol == offset)
+			{
+				*link = entry.next;
+				entry.file = kNoIndex;
+				entry.next = fFreeEntry;
+				fFreeEntry = i;
+				fUsedEntries--;
+				break;
+			}
+
+			link = &entry.next;
+		}
+
+		offset += RecordLength(record->nameLength);
+	}
+}
+
+
+void TSymbolIndex::GrowFileBuckets()
+{
+	fFileBucketCount *= 2;
+	fFileBuckets = (uint32 *)realloc(fFileBuckets, fFileBucketCount * sizeof(uint32));
+	ASSERT(fFileBuckets);
+	memset(fFileBuckets, 0xFF, fFileBucketCount * sizeof(uint32));
+
+	for (uint32 file = 0; file < fFileCount; file++)
+	{
+		FileEntry& entry = fFiles[file];
+
+		if (entry.path)
+		{
+			uint32 bucket = entry.pathHash & (fFileBucketCount - 1);
+			entry.next = fFileBuckets[bucket];
+			fFileBuckets[bucket] = file;
+		}
+	}
+}
+
+
+void TSymbolIndex::GrowBuckets()
+{
+	fBucketCount *= 2;
+	fBuckets = (uint32 *)realloc(fBuckets, fBucketCount * sizeof(uint32));
+	ASSERT(fBuckets);
+	memset(fBuckets, 0xFF, fBucketCount * sizeof(uint32));
+
+	for (uint32 i = 0; i < fEntryCount; i++)
+	{
+		Entry& entry = fEntries[i];
+
+		if (entry.file != kNoIndex)
+		{
+			uint32 bucket = entry.hash & (fBucketCount - 1);
+			entry.next = fBuckets[bucket];
+			fBuckets[bucket] = i;
+		}
+	}
+}
+
+
+void TSymbolIndex::Read()
+{
+	if (!fIndexFile.Exists())
+		return;
+
+	uint32 length = fIndexFile.GetFileSize();
+	if (length < sizeof(IndexHeader))
+		return;
+
+	char* data = (char *)malloc(length);
+	ASSERT(data);
+
+	try
+	{
+		fIndexFile.Open(true, false, false);
+		fIndexFile.Read(data, length);
+		fIndexFile.Close();
+	}
+	catch (TSystemError* error)
+	{
+		delete error;
+		fIndexFile.Close();
+		free(data);
+		return;
+	}
+
+	IndexHeader header;
+	memcpy(&header, data, sizeof(header));
+
+	if (memcmp(header.magic, kIndexMagic, sizeof(header.magic)) == 0 && header.version == kIndexVersion)
+	{
+		const char* next = data + sizeof(header);
+		const char* end = data + length;
+
+		// a damaged index is read as far as it makes sense, the rest is scanned again
+		for (uint32 i = 0; i < header.fileCount && next + sizeof(FileRecord) <= end; i++)
+		{
+			FileRecord record;
+			memcpy(&record, next, sizeof(record));
+
+			const char* path = next + sizeof(record);
+			const char* symbols = path + record.pathLength;
+
+			if (record.pathLength == 0 || record.pathLength > (uint32)(end - path) ||
+				record.symbolsLength > (uint32)(end - symbols) || !ValidSymbols(symbols, record.symbolsLength))
+				break;
+
+			TString filePath(path, record.pathLength);
+			if (FindFile(filePath) != kNoIndex)
+				break;
+
+			// copied so the records are aligned
+			char* fileSymbols = NULL;
+			if (record.symbolsLength > 0)
+			{
+				fileSymbols = (char *)malloc(record.symbolsLength);
+				ASSERT(fileSymbols);
+				memcpy(fileSymbols, symbols, record.symbolsLength);
+			}
+
+			uint32 file = AddFile(filePath);
+			fFiles[file].size = record.size;
+			fFiles[file].modification = record.modification;
+			SetSymbols(file, fileSymbols, record.symbolsLength);
+
+			next = symbols + record.symbolsLength;
+		}
+	}
+
+	free(data);
+}
+
+
+void TSymbolIndex::Write()
+{
+	uint32 length = sizeof(IndexHeader);
+
+	for (uint32 i = 0; i < fFileCount; i++)
+	{
+		if (fFiles[i].path)
+			length += sizeof(FileRecord) + strlen(fFiles[i].path) + fFiles[i].symbolsLength;
+	}
+
+	char* data = (char *)malloc(length);
+	ASSERT(data);
+
+	IndexHeader header;
+	memcpy(header.magic, kIndexMagic, sizeof(header.magic));
+	header.version = kIndexVersion;
+	header.fileCount = fUsedFiles;
+	memcpy(data, &header, sizeof(header));
+
+	char* next = data + sizeof(header);
+
+	for (uint32 i = 0; i < fFileCount; i++)
+	{
+		const FileEntry& entry = fFiles[i];
+		if (!entry.path)
+			continue;
+
+		FileRecord record;
+		record.pathLength = strlen(entry.path);
+		record.size = entry.size;
+		record.modification = entry.modification;
+		record.symbolsLength = entry.symbolsLength;
+
+		memcpy(next, &record, sizeof(record));
+		next += sizeof(record);
+		memcpy(next, entry.path, record.pathLength);
+		next += record.pathLength;
+		memcpy(next, entry.symbols, record.symbolsLength);
+		next += record.symbolsLength;
+	}
+
+	// written to a new file and moved over the old one, so a crash never leaves half an index
+	TString tempPath(fIndexFile.GetPath());
+	tempPath += ".new";
+	TFile temp(tempPath);
+
+	try
+	{
+		temp.Open(false, true, true);
+		temp.Write(data, length);
+		temp.Close();
+
+		if (rename(temp.GetPath(), fIndexFile.GetPath()) != 0)
+			unlink(temp.GetPath());
+	}
+	catch (TSystemError* error)
+	{
+		// the index is only a cache, it is rebuilt by scanning
+		delete error;
+		temp.Close();
+		unlink(temp.GetPath());
+	}
+
+	free(data);
+	fModified = false;
+}
+
+
+bool TSymbolIndex::IsIndexedFile(const char* name)
+{
+	return LanguageHasFunctions(GetFileLanguage(TFile::GetFileExtension(name)));
+}
+
+
+bool TSymbolIndex::ValidSymbols(const char* symbols, uint32 length)
+{
+	uint32 offset = 0;
+
+	while (offset < length)
+	{
+		if (length - offset < sizeof(SymbolRecord))
+			return false;
+
+		SymbolRecord record;
+		memcpy(&record, symbols + offset, sizeof(record));
+
+		if (record.nameLength == 0 || record.nameLength > (uint32)kMaxNameLength || RecordLength(record.nameLength) > length - offset)
+			return false;
+
+		offset += RecordLength(record.nameLength);
+	}
+
+	return true;
+}
+
+
+// the last part of a qualified name
+void TSymbolIndex::GetKey(const char* name, uint32 length, const char*& key, uint32& keyLength)
+{
+	const char* start = name + length;
+	while (start > name && start[-1] != ':')
+		start--;
+
+	key = start;
+	keyLength = name + length - start;
+}
+
+
+uint32 TSymbolIndex::Hash(const char* text, uint32 length)
+{
+	// FNV-1a
+	uint32 hash = 2166136261U;
+
+	for (uint32 i = 0; i < length; i++)
+	{
+		hash ^= (unsigned char)text[i];
+		hash *= 16777619;
+	}
+
+	return hash;
+}
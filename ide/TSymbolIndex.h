@@ -0,0 +1,220 @@
+// ========================================================================================
+//	TSymbolIndex.h			   Copyright (C) 2001-2009 Mike Voydanoff. All rights reserved.
+// ========================================================================================
+/*
+	This program is free software; you can redistribute it and/or
+	modify it under the terms of the GNU General Public License
+	as published by the Free Software Foundation; either version 2
+	of the License, or (at your option) any later version.
+	
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+	
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*/
+
+#ifndef __TSymbolIndex__
+#define __TSymbolIndex__
+
+#include "fw/TIdler.h"
+#include "fw/TFile.h"
+#include "fw/TString.h"
+#include "fw/TTextLayout.h"
+
+#ifdef HAVE_LIBPTHREAD
+#include <pthread.h>
+#endif
+
+
+// The functions defined in the source files under a project's directory, for finding a definition by name.
+// The directory is walked and files are scanned with TFunctionScanner on worker threads, or a little at a
+// time while idle without them. The results are kept in a file next to the project along with the size
+// and modification time of each file, so reopening the project only scans the files that have changed since.
+// Saved files are scanned again right away. Other changes under the directory are followed with inotify
+// where it is available, otherwise the directory is walked again every so often to find new, changed and
+// deleted files. Names are looked up in a hash table.
+
+class TSymbolIndex : public TIdler
+{
+public:
+	struct Definition
+	{
+		uint32				file;
+		uint32				line;					// zero based
+	};
+
+							TSymbolIndex(const TFile& projectFile);
+	virtual					~TSymbolIndex();
+
+	void					Update();				// starts looking for new, changed and deleted files under the directory
+	void					FileSaved(const TChar* path);
+	bool					IndexesProject(const TFile& projectFile) const;
+
+	// returns the number of definitions of the name, filling in at most maxCount of them.
+	// a qualified name like TFoo::Bar is found by its last part.
+	uint32					FindSymbol(const TChar* name, uint32 length, Definition* definitions, uint32 maxCount) const;
+	void					GetFilePath(uint32 file, TString& path) const;
+
+protected:
+	struct FileEntry
+	{
+		char*				path;					// relative to the directory, NULL if the entry is free
+		uint32				size;					// of the file when it was scanned
+		TFileTime			modification;
+		char*				symbols;				// SymbolRecords
+		uint32				symbolsLength;
+		uint32				pathHash;
+		uint32				next;					// in the path hash chain, or the free list
+		bool				seen;					// by Update
+	};
+
+	struct Entry
+	{
+		uint32				hash;
+		uint32				file;					// kNoIndex if the entry is free
+		uint32				symbol;					// offset of the SymbolRecord in the file's symbols
+		uint32				next;					// in the hash chain, or the free list
+	};
+
+	struct Scan
+	{
+		char*				path;
+		uint32				size;
+		TFileTime			modification;
+		char*				symbols;
+		uint32				symbolsLength;
+		uint32				symbolsSize;
+		const TChar*		text;					// while scanning
+		uint32				line;					// of lineOffset
+		STextOffset			lineOffset;
+		bool				exists;
+	};
+
+	struct WalkFile
+	{
+		char*				path;					// relative to the directory
+		uint32				size;
+		TFileTime			modification;
+	};
+
+#ifdef HAVE_SYS_INOTIFY_H
+	struct WalkWatch
+	{
+		int					watch;
+		char*				path;					// of the directory, relative to the directory
+	};
+#endif
+
+	virtual void			DoIdle();
+
+	void					StartWalk();
+	bool					WalkNext();
+	bool					WalkDone(TTime stopTime);
+	void					FinishWalk();
+	void					AddWalkDirectory(const char* path);
+#ifdef HAVE_SYS_INOTIFY_H
+	void					ReadNotifications();
+	void					RemoveDirectory(const char* path);
+	void					SetWatch(int watch, char* path);
+	void					RemoveWatch(int watch);
+	void					StopWatching();
+#endif
+	void					AddPending(const char* path);
+	void					StartScan();
+	bool					ScanNext();
+	bool					ScanDone(TTime stopTime);
+	void					FinishScan();
+	static void				ScanFile(const char* root, Scan& scan);
+	static void				FunctionFound(const TChar* functionName, int functionNameLength, STextOffset offset, void* userData);
+	static void				GetIndexPath(const TFile& projectFile, TString& path);
+#ifdef HAVE_LIBPTHREAD
+	static void*			WalkThread(void* data);
+	static void*			ScanThread(void* data);
+#endif
+
+	uint32					FindFile(const char* path) const;
+	uint32					AddFile(const char* path);
+	void					RemoveFile(uint32 file);
+	void					SetSymbols(uint32 file, char* symbols, uint32 symbolsLength);
+	void					AddEntries(uint32 file);
+	void					RemoveEntries(uint32 file);
+	void					GrowFileBuckets();
+	void					GrowBuckets();
+
+	void					Read();
+	void					Write();
+
+	static bool				IsIndexedFile(const char* name);
+	static bool				ValidSymbols(const char* symbols, uint32 length);
+	static void				GetKey(const char* name, uint32 length, const char*& key, uint32& keyLength);
+	static uint32			Hash(const char* text, uint32 length);
+
+protected:
+	TString					fRoot;					// the project's directory, ending in '/'
+	TFile					fIndexFile;
+
+	FileEntry*				fFiles;
+	uint32					fFileCount;				// including free entries
+	uint32					fFileSize;
+	uint32					fFreeFile;
+	uint32					fUsedFiles;
+	uint32*					fFileBuckets;			// by path
+	uint32					fFileBucketCount;
+
+	Entry*					fEntries;
+	uint32					fEntryCount;			// including free entries
+	uint32					fEntrySize;
+	uint32					fFreeEntry;
+	uint32					fUsedEntries;
+	uint32*					fBuckets;				// by name
+	uint32					fBucketCount;
+
+	char**					fPending;				// paths to scan next
+	uint32					fPendingCount;
+	uint32					fPendingSize;
+
+	Scan*					fScans;					// being scanned
+	uint32					fScanCount;
+	uint32					fNextScan;
+
+	// while walking, the directories still to read and the files found so far
+	bool					fWalking;
+	char**					fWalkDirectories;		// relative to the directory, ending in '/'
+	uint32					fWalkDirectoryCount;
+	uint32					fWalkDirectorySize;
+	WalkFile*				fWalkFiles;
+	uint32					fWalkFileCount;
+	uint32					fWalkFileSize;
+	TTime					fWalkTime;				// when the last walk finished
+	bool					fWalkAll;				// rather than just new directories
+
+	bool					fModified;				// since written out
+	TTime					fModifiedTime;
+
+#ifdef HAVE_SYS_INOTIFY_H
+	int						fNotifyFD;				// -1 if changes are not being followed
+	char**					fWatches;				// directory paths by watch descriptor
+	int						fWatchSize;
+	WalkWatch*				fWalkWatches;			// added while walking
+	uint32					fWalkWatchCount;
+	uint32					fWalkWatchSize;
+	bool					fWalkUnwatched;			// a directory could not be watched
+#endif
+
+#ifdef HAVE_LIBPTHREAD
+	pthread_mutex_t			fScanLock;				// guards fNextScan, fThreadsDone, fWalkDone and fStopWalk
+	pthread_t*				fThreads;
+	int						fThreadCount;
+	int						fThreadsDone;
+	pthread_t				fWalkThread;
+	bool					fWalkThreadRunning;
+	bool					fWalkDone;
+	bool					fStopWalk;
+#endif
+};
+
+#endif // __TSymbolIndex__
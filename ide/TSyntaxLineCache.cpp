@@ -0,0 +1,143 @@
+// ========================================================================================
+//	TSyntaxLineCache.cpp			   Copyright (C) 2001-2009 Mike Voydanoff. All rights reserved.
+// ========================================================================================
+/*
+	This program is free software; you can redistribute it and/or
+	modify it under the terms of the GNU General Public License
+	as published by the Free Software Foundation; either version 2
+	of the License, or (at your option) any later version.
+	
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+	
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*/
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "IDECommon.h"
+
+#include "TSyntaxLineCache.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+
+const STextOffset kScanLookahead = 4;		// as in TSyntaxScanner
+
+
+TSyntaxLineCache::TSyntaxLineCache(uint32 capacity)
+	:	fLines(NULL),
+		fCapacity(capacity),
+		fUseCount(0)
+{
+	ASSERT(capacity > 0);
+
+	fLines = (Line *)calloc(capacity, sizeof(Line));
+	ASSERT(fLines);
+}
+
+
+TSyntaxLineCache::~TSyntaxLineCache()
+{
+	for (uint32 i = 0; i < fCapacity; i++)
+		free(fLines[i].spans);
+
+	free(fLines);
+}
+
+
+const TSyntaxLineCache::Span* TSyntaxLineCache::Find(STextOffset start, STextOffset end, STextOffset resyncOffset, uint32& count)
+{
+	for (uint32 i = 0; i < fCapacity; i++)
+	{
+		Line& line = fLines[i];
+
+		if (line.lastUse > 0 && line.start == start && line.end == end)
+		{
+			if (line.moved && start < resyncOffset)
+				return NULL;
+
+			line.lastUse = ++fUseCount;
+			count = line.spanCount;
+			return line.spans;
+		}
+	}
+
+	return NULL;
+}
+
+
+void TSyntaxLineCache::Store(STextOffset start, STextOffset end, const Span* spans, uint32 count)
+{
+	// replace the same line if it is here, or else the least recently used one
+	Line* line = fLines;
+
+	for (uint32 i = 0; i < fCapacity; i++)
+	{
+		if (fLines[i].lastUse > 0 && fLines[i].start == start)
+		{
+			line = &fLines[i];
+			break;
+		}
+
+		if (fLines[i].lastUse < line->lastUse)
+			line = &fLines[i];
+	}
+
+	line->spans = (Span *)realloc(line->spans, (count > 0 ? count : 1) * sizeof(Span));
+	ASSERT(line->spans);
+	memcpy(line->spans, spans, count * sizeof(Span));
+
+	line->start = start;
+	line->end = end;
+	line->spanCount = count;
+	line->moved = false;
+	line->lastUse = ++fUseCount;
+}
+
+
+void TSyntaxLineCache::TextChanged(STextOffset offset, STextOffset oldLength, STextOffset newLength, STextOffset resyncOffset)
+{
+	for (uint32 i = 0; i < fCapacity; i++)
+	{
+		Line& line = fLines[i];
+
+		if (line.lastUse == 0)
+			continue;
+
+		// lines moved by the edit before were either confirmed by now or never will be
+		if (line.moved)
+		{
+			if (line.start < resyncOffset)
+				line.lastUse = 0;
+			else
+				line.moved = false;
+		}
+
+		if (line.lastUse == 0 || line.end + kScanLookahead <= offset)
+			continue;
+
+		if (line.start <= offset + oldLength)
+			line.lastUse = 0;
+		else
+		{
+			line.start += newLength - oldLength;
+			line.end += newLength - oldLength;
+			line.moved = true;
+		}
+	}
+}
+
+
+void TSyntaxLineCache::RemoveAll()
+{
+	for (uint32 i = 0; i < fCapacity; i++)
+		fLines[i].lastUse = 0;
+}
@@ -0,0 +1,79 @@
+// ========================================================================================
+//	TSyntaxLineCache.h			   Copyright (C) 2001-2009 Mike Voydanoff. All rights reserved.
+// ========================================================================================
+/*
+	This program is free software; you can redistribute it and/or
+	modify it under the terms of the GNU General Public License
+	as published by the Free Software Foundation; either version 2
+	of the License, or (at your option) any later version.
+	
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+	
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*/
+
+#ifndef __TSyntaxLineCache__
+#define __TSyntaxLineCache__
+
+#include "fw/TTextLayout.h"
+
+
+// Remembers how the most recently drawn lines were colored, so repainting a line
+// that has not changed does not need the syntax scanner.
+// Lines are found by their start and end offsets and the least recently used line is dropped when full.
+// An edit drops the lines around it. Lines after it are kept, moved by the edit,
+// but are only used again if scanning after the edit comes back in step before them.
+
+class TSyntaxLineCache
+{
+public:
+	enum EStyle
+	{
+		kNoStyle,				// keep the current color, for white space
+		kPlainStyle,
+		kCommentStyle,
+		kPreprocessorStyle,
+		kKeywordStyle,
+		kStringStyle
+	};
+
+	struct Span
+	{
+		uint32				length;
+		EStyle				style;
+	};
+
+							TSyntaxLineCache(uint32 capacity);
+							~TSyntaxLineCache();
+
+	// returns NULL if the line from start to end is not cached.
+	// resyncOffset is where scanning after the last edit came back in step.
+	const Span*				Find(STextOffset start, STextOffset end, STextOffset resyncOffset, uint32& count);
+	void					Store(STextOffset start, STextOffset end, const Span* spans, uint32 count);
+
+	void					TextChanged(STextOffset offset, STextOffset oldLength, STextOffset newLength, STextOffset resyncOffset);
+	void					RemoveAll();
+
+protected:
+	struct Line
+	{
+		STextOffset			start;
+		STextOffset			end;
+		uint32				lastUse;		// 0 if unused
+		bool				moved;			// moved by the last edit, so it depends on the scan after it
+		Span*				spans;
+		uint32				spanCount;
+	};
+
+protected:
+	Line*					fLines;
+	uint32					fCapacity;
+	uint32					fUseCount;
+};
+
+#endif // __TSyntaxLineCache__
@@ -24,8 +24,15 @@
 #include "IDECommon.h"
 
 #include "TSyntaxScanner.h"
+#include "TLexer.h"
 
-#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+const STextOffset kCheckpointSpacing = 1024;
+const STextOffset kMaxRangeLength = 1024;			// longer tokens come back a piece at a time, so no one call scans far
+const STextOffset kScanLookahead = 4;				// checkpoints are only made where the scan has looked no further ahead than this
 
 #define C_KEYWORDS			\
 	"asm",					\
@@ -67,7 +74,7 @@
 	"alignas",				\
 	"alignof",				\
 	"and",					\
-	"and_eq"				\
+	"and_eq",				\
 	"atomic_cancel",		\
 	"atomic_commit",		\
 	"atomic_noexcept",		\
@@ -424,18 +431,135 @@ const char* kSwiftKeywords[] =
 	"unowned",
 	"weak",
 	"willSet",
+	""
 };
 
-inline bool IsString(const TChar* text)
+// lexer modes
+enum
 {
-	return ((*text == '\'' || *text == '\"') && (text[-1] != '\\' || text[-2] == '\\'));
-}
+	kDefaultMode,
+	kHTMLTagMode
+};
+
+#define WHITE_SPACE_RULE																		\
+	{ kDefaultMode, "[ \t\r\n][ \t\r\n\f]*", TSyntaxScanner::kWhiteSpace, kDefaultMode }
+
+// an unterminated comment or string runs to the end of the text
+#define C_COMMENT_RULES																			\
+	{ kDefaultMode, "/\\*([^*]|\\*+[^*/])*\\*+/", TSyntaxScanner::kComment, kDefaultMode },		\
+	{ kDefaultMode, "/\\*([^*]|\\*+[^*/])*\\**$", TSyntaxScanner::kComment, kDefaultMode },		\
+	{ kDefaultMode, "//([^\\\\\r\n]|\\\\+([^\\\\\r]|\r\n?))*\\\\*", TSyntaxScanner::kComment, kDefaultMode }
+
+// up to the end of the line or a comment, with \ continuing the line
+#define PREPROCESSOR_PATTERN	"([^/\\\\\r\n]|/[^*/\\\\\r\n]|/?\\\\[^\r\n]*(\r\n?|\n)?)*"
+
+#define PREPROCESSOR_RULE																		\
+	{ kDefaultMode, "#" PREPROCESSOR_PATTERN, TSyntaxScanner::kPreprocessor, kDefaultMode }
+
+#define SCRIPT_COMMENT_RULES																	\
+	{ kDefaultMode, "#!" PREPROCESSOR_PATTERN, TSyntaxScanner::kPreprocessor, kDefaultMode },	\
+	{ kDefaultMode, "#[^\r\n]*", TSyntaxScanner::kComment, kDefaultMode }
+
+#define STRING_RULES(mode)																		\
+	{ mode, "\"([^\"\\\\]|\\\\.)*\"", TSyntaxScanner::kString, mode },							\
+	{ mode, "\"([^\"\\\\]|\\\\.)*\\\\?$", TSyntaxScanner::kString, mode },						\
+	{ mode, "'([^'\\\\]|\\\\.)*'", TSyntaxScanner::kString, mode },								\
+	{ mode, "'([^'\\\\]|\\\\.)*\\\\?$", TSyntaxScanner::kString, mode }
+
+#define IDENTIFIER_RULE																			\
+	{ kDefaultMode, "[A-Za-z_][A-Za-z0-9_@]*", TSyntaxScanner::kIdentifier, kDefaultMode }
+
+#define END_RULE																				\
+	{ 0, NULL, 0, 0 }
+
+const TLexerRule kCRules[] =
+{
+	WHITE_SPACE_RULE,
+	C_COMMENT_RULES,
+	PREPROCESSOR_RULE,
+	STRING_RULES(kDefaultMode),
+	IDENTIFIER_RULE,
+	END_RULE
+};
+
+const TLexerRule kObjCRules[] =
+{
+	WHITE_SPACE_RULE,
+	C_COMMENT_RULES,
+	PREPROCESSOR_RULE,
+	STRING_RULES(kDefaultMode),
+	{ kDefaultMode, "[A-Za-z_@][A-Za-z0-9_@]*", TSyntaxScanner::kIdentifier, kDefaultMode },
+	END_RULE
+};
+
+const TLexerRule kRubyRules[] =
+{
+	WHITE_SPACE_RULE,
+	SCRIPT_COMMENT_RULES,
+	STRING_RULES(kDefaultMode),
+	IDENTIFIER_RULE,
+	END_RULE
+};
+
+const TLexerRule kPythonRules[] =
+{
+	WHITE_SPACE_RULE,
+	SCRIPT_COMMENT_RULES,
+	C_COMMENT_RULES,
+	STRING_RULES(kDefaultMode),
+	IDENTIFIER_RULE,
+	END_RULE
+};
+
+const TLexerRule kHTMLRules[] =
+{
+	{ kDefaultMode, "<!--([^-]|-[^-]|--+[^->])*--+>", TSyntaxScanner::kComment, kDefaultMode },
+	{ kDefaultMode, "<!--([^-]|-[^-]|--+[^->])*-*$", TSyntaxScanner::kComment, kDefaultMode },
+	{ kDefaultMode, "<[^>\"']*>", TSyntaxScanner::kTag, kDefaultMode },
+	{ kDefaultMode, "<[^>\"']*", TSyntaxScanner::kTag, kHTMLTagMode },
+	{ kDefaultMode, "[^<]+", TSyntaxScanner::kContent, kDefaultMode },
+	{ kHTMLTagMode, "[^>\"']*>", TSyntaxScanner::kTag, kDefaultMode },
+	{ kHTMLTagMode, "[^>\"']+", TSyntaxScanner::kTag, kHTMLTagMode },
+	STRING_RULES(kHTMLTagMode),
+	END_RULE
+};
+
+const TLexerRule kTeXRules[] =
+{
+	WHITE_SPACE_RULE,
+	{ kDefaultMode, "%([^\\\\\r\n]|\\\\+([^\\\\\r]|\r\n?))*\\\\*", TSyntaxScanner::kTeXComment, kDefaultMode },
+	{ kDefaultMode, "\\\\[A-Za-z]+", TSyntaxScanner::kTeXCommand, kDefaultMode },
+	{ kDefaultMode, "[{}$^_]", TSyntaxScanner::kTeXSpecialChar, kDefaultMode },
+	END_RULE
+};
+
+TLexer* TSyntaxScanner::sCLexer = NULL;
+TLexer* TSyntaxScanner::sObjCLexer = NULL;
+TLexer* TSyntaxScanner::sRubyLexer = NULL;
+TLexer* TSyntaxScanner::sPythonLexer = NULL;
+TLexer* TSyntaxScanner::sHTMLLexer = NULL;
+TLexer* TSyntaxScanner::sTeXLexer = NULL;
+
 
 TSyntaxScanner::TSyntaxScanner(const TTextLayout* layout)
 	:	fLayout(layout),
 		fLanguage(kLanguageNone),
+		fLexer(NULL),
 		fCurrentPosition(NULL),
-		fTextEnd(NULL)
+		fTextEnd(NULL),
+		fMode(kDefaultMode),
+		fTokenState(0),
+		fExamined(NULL),
+		fNextMatchStart(NULL),
+		fNextMatchEnd(NULL),
+		fNextMatchRule(NULL),
+		fNextMatchState(0),
+		fCheckpoints(NULL),
+		fCheckpointCount(0),
+		fValidCheckpoints(0),
+		fNextCheckpoint(0),
+		fCheckpointLanguage(kLanguageNone),
+		fResyncOffset(0)
 {
 	ASSERT(layout);
 	
@@ -444,6 +568,7 @@ TSyntaxScanner::TSyntaxScanner(const TTextLayout* layout)
 
 TSyntaxScanner::~TSyntaxScanner()
 {
+	free(fCheckpoints);
 }
 
 TSyntaxScanner::TScanState TSyntaxScanner::NextSyntaxRange(STextOffset& offset, uint32& length)
@@ -456,521 +581,283 @@ TSyntaxScanner::TScanState TSyntaxScanner::NextSyntaxRange(STextOffset& offset,
 		return kUnknown;
 	}
 	
-	TScanState state = fScanState;
-
-	try
-	{
-		if (fLanguage == kLanguageHTML)
-		{
-			switch (fScanState)
-			{
-				case kWhiteSpace:
-					SkipWhiteSpace(text);
-					break;
-
-				case kComment:
-					SkipHTMLComment(text);
-					break;
-
-				case kString:
-					SkipString(text);
-					break;
-					
-				case kTag:
-					SkipTag(text);
-					break;
-
-				case kContent:
-					SkipContent(text);
-					break;
-			
-				case kIdentifier:
-				case kPreprocessor:
-				case kTeXCommand:
-				case kTeXSpecialChar:
-				case kTeXComment:
-				case kNoScanState:
-					ASSERT(0);
-					break;
-					
-				case kUnknown:
-					fScanState = kContent;
-			}
-	
-			TChar ch = *text;
+	const TLexerRule* rule = NULL;
+	const TChar* end;
 	
-			if (fScanState == kTag && (ch == '"' || ch == '\''))
-			{
-				fScanState = kString;
-			}
-			else if (fScanState == kContent && ch == '<')
-			{				
-				if (text + 4 < fTextEnd && text[0] == '<' && text[1] == '!' && text[2] == '-' && text[3] == '-')
-					fScanState = kComment;
-				else
-					fScanState = kTag;
-			}
-		}
-		else if (fLanguage == kLanguageTeX)
-		{
-			// TeX
-			
-			switch (fScanState)
-			{
-				case kWhiteSpace:
-					SkipWhiteSpace(text);
-					break;
-					
-				case kTeXComment:
-					SkipTeXComment(text);
-					break;
-
-				case kTeXCommand:
-					SkipTeXCommand(text);
-					break;
-					
-				case kTeXSpecialChar:
-					NextChar(text);
-					break;
-	
-				case kString:
-				case kIdentifier:
-				case kComment:
-				case kPreprocessor:
-				case kTag:
-				case kContent:
-				case kNoScanState:
-					ASSERT(0);
-					break;
-
-				case kUnknown:
-					SkipTeXUnknown(text);
-					break;
-			}
-			
-			TChar ch = *text;
-	
-			if (ch == ' ' || ch == '\t' || ch == '\n' || ch == '\r')
-				fScanState = kWhiteSpace;
-			else if (ch == '%')
-				fScanState = kTeXComment;
-			else if (ch == '\\' && isalpha(text[1]))
-				fScanState = kTeXCommand;
-			else if (IsTeXSpecialChar(ch))
-				fScanState = kTeXSpecialChar;
-			else
-				fScanState = kUnknown;
-		}
-		else
-		{
-			// C, C++, Java and Ruby
-			
-			switch (fScanState)
-			{
-				case kWhiteSpace:
-					SkipWhiteSpace(text);
-					break;
-					
-				case kComment:
-					SkipComment(text);
-					break;
-	
-				case kPreprocessor:
-					SkipPreprocessor(text);
-					break;
-	
-				case kIdentifier:
-					SkipIdentifier(text);
-					break;
-	
-				case kString:
-					SkipString(text);	
-					break;
-					
-				case kTag:
-				case kContent:
-				case kTeXCommand:
-				case kTeXComment:
-				case kTeXSpecialChar:
-				case kNoScanState:
-					ASSERT(0);
-					break;
-
-				case kUnknown:
-					SkipUnknown(text);
-					break;
-			}
-			
-			TChar ch = *text;
-	
-			if (ch == '"' || ch == '\'')
-				fScanState = kString;
-			else if (ch == ' ' || ch == '\t' || ch == '\n' || ch == '\r')
-				fScanState = kWhiteSpace;
-			else if (ch == '#')
-			{
-				if (fLanguage == kLanguageRuby || fLanguage == kLanguagePython)
-				{
-					if (text[1] == '!')		// treat #! directives as preprocessor
-						fScanState = kPreprocessor;
-					else
-						fScanState = kComment;
-				}
-				else
-					fScanState = kPreprocessor;
-			}
-			else if ((ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z') || ch == '_' ||
-					 (ch == '@' && (fLanguage == kLanguageObjC || fLanguage == kLanguageObjCPlusPlus)))
-				fScanState = kIdentifier;
-			else if (fLanguage != kLanguageRuby && ch == '/' && (text[1] == '*' || text[1] == '/'))
-				fScanState = kComment;
-			else
-				fScanState = kUnknown;
-		}
-	}
-	catch (...)
+	if (text == fNextMatchStart)
 	{
-		fScanState = kUnknown;
+		end = fNextMatchEnd;
+		rule = fNextMatchRule;
+		fTokenState = fNextMatchState;
 	}
-	
-	offset = fCurrentPosition - fLayout->GetText();
-	length = text - fCurrentPosition;
-	fCurrentPosition = text;
-	
-	return state;
-}
-
-
-void TSyntaxScanner::Reset(ELanguage language)
-{
-	fCurrentPosition = fLayout->GetText();
-	fTextEnd = fCurrentPosition + fLayout->GetTextLength();
-	fScanState = kUnknown;
-	fLanguage = language;
-}
-
-
-
-void TSyntaxScanner::SkipWhiteSpace(const TChar*& text)
-{
-	ASSERT(IsWhiteSpace(*text));
+	else if (!fTokenState && text < fTextEnd && !fLexer->CanStart(fMode, *text))
+		end = NULL;
+	else
+		end = Match(text, fTokenState, rule);
 
-	while (IsWhiteSpace(*text))
-		NextChar(text);
-}
+	fNextMatchStart = NULL;
 
+	TScanState state = kUnknown;
 
-void TSyntaxScanner::SkipComment(const TChar*& text)
-{
-	ASSERT(*text == '/' || ((fLanguage == kLanguageRuby || fLanguage == kLanguagePython) && *text == '#'));
-	ASSERT(fLanguage != kLanguageHTML && fLanguage != kLanguageTeX);
-	NextChar(text);
-	
-	if (fLanguage == kLanguageRuby || fLanguage == kLanguagePython)
+	if (end)
 	{
-		while (1)
-		{
-			// read until end of line
-			TChar ch = *text;
-			
-			if (ch == '\n' || ch == '\r')
-				break;
-		
-			NextChar(text);
-		}
+		state = (TScanState)rule->token;
+
+		if (!fTokenState)
+			fMode = rule->nextMode;
 	}
-	else if (*text == '*')
+	else
 	{
-		NextChar(text);
-		
-		while (1)
+		// characters that do not start any token make up an unknown range,
+		// and the token after them is kept for the next call
+		end = text;
+
+		while (end < fTextEnd && (STextOffset)(end - text) < kMaxRangeLength)
 		{
-			if (*text == '*' && text + 1 < fTextEnd && text[1] == '/')
+			end = TLexer::NextCharacter(end, fTextEnd);
+
+			if (end < fTextEnd && !fLexer->CanStart(fMode, *end))
+				continue;
+			
+			fNextMatchState = 0;
+			fNextMatchEnd = Match(end, fNextMatchState, fNextMatchRule);
+
+			if (fNextMatchEnd)
 			{
-				NextChar(text);
-				NextChar(text);
-				
+				fNextMatchStart = end;
 				break;
 			}
-		
-			NextChar(text);
 		}
 	}
-	else if (*text == '/')
-	{
-		NextChar(text);
+
+	offset = fCurrentPosition - fLayout->GetText();
+	length = end - fCurrentPosition;
+	fCurrentPosition = end;
 	
-		TChar previous = 0;
-		while (1)
-		{
-			TChar ch = *text;
-			
-			if ((ch == '\n' || ch == '\r') && previous != '\\')
-				break;
-		
-			previous = ch;
-			NextChar(text);
-		}
-	}
-	else
-		ASSERT(0);
+	AddCheckpoint();
+
+	return state;
 }
 
 
-void TSyntaxScanner::SkipTeXComment(const TChar*& text)
+const TChar* TSyntaxScanner::Match(const TChar* text, uint32& ioTokenState, const TLexerRule*& rule)
 {
-	ASSERT(*text == '%');
-	ASSERT(fLanguage == kLanguageTeX);
-	NextChar(text);
+	const TChar* limit = ((STextOffset)(fTextEnd - text) > kMaxRangeLength ? text + kMaxRangeLength : fTextEnd);
+	const TChar* examined;
+	const TChar* end = fLexer->Match(fMode, ioTokenState, text, limit, fTextEnd, rule, examined);
 
-	TChar previous = 0;
-	while (1)
-	{
-		TChar ch = *text;
-		
-		if ((ch == '\n' || ch == '\r') && previous != '\\')
-			break;
-	
-		previous = ch;
-		NextChar(text);
-	}
-}
+	if (examined > fExamined)
+		fExamined = examined;
 
+	return end;
+}
 
 
-void TSyntaxScanner::SkipHTMLComment(const TChar*& text)
+void TSyntaxScanner::Reset(ELanguage language)
 {
-	ASSERT(fLanguage == kLanguageHTML);
-
-	ASSERT(*text == '<');
-	NextChar(text);
-	ASSERT(*text == '!');
-	NextChar(text);
-	ASSERT(*text == '-');
-	NextChar(text);
-	ASSERT(*text == '-');
-	NextChar(text);
-		
-	while (1)
+	fCurrentPosition = fLayout->GetText();
+	fTextEnd = fCurrentPosition + fLayout->GetTextLength();
+	fMode = kDefaultMode;
+	fTokenState = 0;
+	fExamined = fCurrentPosition;
+	fNextMatchStart = NULL;
+	fLanguage = language;
+	fLexer = GetLexer(language);
+
+	if (language != fCheckpointLanguage)
 	{
-		if (text + 3 < fTextEnd && text[0] == '-' && text[1] == '-' && text[2] == '>')
-		{
-			NextChar(text);
-			NextChar(text);
-			NextChar(text);
-			
-			break;
-		}
-	
-		NextChar(text);
+		fCheckpointCount = fValidCheckpoints = fNextCheckpoint = 0;
+		fCheckpointLanguage = language;
 	}
-	
-	fScanState = kContent;
 }
 
 
-void TSyntaxScanner::SkipPreprocessor(const TChar*& text)
+TLexer* TSyntaxScanner::GetLexer(ELanguage language)
 {
-	ASSERT(*text == '#');
+	TLexer** lexer;
+	const TLexerRule* rules;
 
-	NextChar(text);
-	
-	while (1)
+	switch (language)
 	{
-		TChar ch = *text;
-		
-		// look for comments after preprocessor
-		if (ch == '/' && (text[1] == '*' || text[1] == '/'))
+		case kLanguageObjC:
+		case kLanguageObjCPlusPlus:
+			lexer = &sObjCLexer;
+			rules = kObjCRules;
 			break;
 
-		// handle multi-line macros 
-		if (ch == '\\')
-		{
-			do
-				NextChar(text);
-			while (*text != kLineEnd13 && *text != kLineEnd10);
+		case kLanguageRuby:
+			lexer = &sRubyLexer;
+			rules = kRubyRules;
+			break;
 
-			if (*text == kLineEnd10)
-				NextChar(text);
-			else if (*text == kLineEnd13)
-			{
-				NextChar(text);
-				
-				// handle DOS line endings
-				if (*text == kLineEnd10)
-					NextChar(text);
-			}
-			
-			ch = *text;
-		}
-		
-		if (ch == '\n' || ch == '\r')
+		case kLanguagePython:
+			lexer = &sPythonLexer;
+			rules = kPythonRules;
 			break;
-	
-		NextChar(text);
-	}
-}
 
+		case kLanguageHTML:
+			lexer = &sHTMLLexer;
+			rules = kHTMLRules;
+			break;
 
-void TSyntaxScanner::SkipIdentifier(const TChar*& text)
-{
-	while (1)
-	{
-		TChar ch = *text;
-		
-		if ((ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z') || ch == '_' || (ch >= '0' && ch <= '9') || ch == '@')
-			NextChar(text);
-		else
+		case kLanguageTeX:
+			lexer = &sTeXLexer;
+			rules = kTeXRules;
+			break;
+
+		default:
+			lexer = &sCLexer;
+			rules = kCRules;
 			break;
 	}
+
+	// compiled the first time the language is used
+	if (!*lexer)
+		*lexer = new TLexer(rules);
+
+	return *lexer;
 }
 
 
-void TSyntaxScanner::SkipTeXCommand(const TChar*& text)
+void TSyntaxScanner::Seek(ELanguage language, STextOffset offset)
 {
-	ASSERT(*text == '\\');
+	Reset(language);
 
-	NextChar(text);
-	
-	while (1)
+	// find the last valid checkpoint at or before offset
+	uint32 low = 0;
+	uint32 high = fValidCheckpoints;
+
+	while (low < high)
 	{
-		TChar ch = *text;
-		
-		if ((ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z'))
-			NextChar(text);
+		uint32 middle = (low + high) / 2;
+		if (fCheckpoints[middle].offset <= offset)
+			low = middle + 1;
 		else
-			break;
+			high = middle;
 	}
-}
-
 
-void TSyntaxScanner::SkipString(const TChar*& text)
-{
-	TChar	terminator = *text;
-	ASSERT(terminator == '\'' || terminator == '\"');
-	NextChar(text);
-	
-	TChar previous = 0;
-	TChar previous2 = 0;
-	
-	while (1)
+	if (low > 0 && fCurrentPosition)
 	{
-		TChar ch = *text;
-		
-		if (ch == terminator && (previous != '\\' || previous2 == '\\'))
-		{
-			NextChar(text);
-			break;
-		}
-	
-		previous2 = previous;
-		previous = ch;
-		NextChar(text);
+		fCurrentPosition += fCheckpoints[low - 1].offset;
+		fExamined = fCurrentPosition;
+		fMode = fCheckpoints[low - 1].mode;
+		fTokenState = fCheckpoints[low - 1].tokenState;
 	}
-	
-	if (fLanguage == kLanguageHTML)
-		fScanState = kTag;	// only dealing with strings within tags
 }
 
 
-void TSyntaxScanner::SkipTag(const TChar*& text)
-{	
-	ASSERT(fLanguage == kLanguageHTML);
-	
-	while (1)
+void TSyntaxScanner::TextChanged(STextOffset offset, STextOffset oldLength, STextOffset newLength)
+{
+	// the checkpoints just before the edit may have depended on the text after them
+	uint32 valid = 0;
+
+	if (offset >= kScanLookahead)
 	{
-		TChar ch = *text;
-		
-		if (ch == '>')
+		uint32 high = fValidCheckpoints;
+
+		while (valid < high)
 		{
-			NextChar(text);
-			fScanState = kUnknown;
-			break;
+			uint32 middle = (valid + high) / 2;
+			if (fCheckpoints[middle].offset <= offset - kScanLookahead)
+				valid = middle + 1;
+			else
+				high = middle;
 		}
-		else if (ch == '\"' || ch == '\'')
-			break;	// string
-	
-		NextChar(text);
 	}
-}
 
+	// the rest are kept to compare against, without the ones within the edit.
+	// any left from an earlier edit were never confirmed, so they are no use to compare against.
+	fCheckpointCount = fValidCheckpoints;
 
-void TSyntaxScanner::SkipContent(const TChar*& text)
-{	
-	ASSERT(fLanguage == kLanguageHTML);
-	
-	while (1)
-	{		
-		if (*text == '<')
-			break;
-	
-		NextChar(text);
-	}
+	uint32 end = valid;
+	while (end < fCheckpointCount && fCheckpoints[end].offset < offset + oldLength)
+		end++;
+
+	RemoveCheckpoints(valid, end - valid);
+
+	for (uint32 i = valid; i < fCheckpointCount; i++)
+		fCheckpoints[i].offset += newLength - oldLength;
+
+	fValidCheckpoints = fNextCheckpoint = valid;
+	fResyncOffset = kNotResynced;
 }
 
 
-void TSyntaxScanner::SkipUnknown(const TChar*& text)
+// continues scanning from the last valid checkpoint, so that drawing far ahead does not have to
+bool TSyntaxScanner::ScanAhead(ELanguage language, STextOffset length)
 {
-	while (1)
+	Seek(language, fValidCheckpoints > 0 ? fCheckpoints[fValidCheckpoints - 1].offset : 0);
+
+	if (!fCurrentPosition)
+		return false;
+
+	STextOffset remaining = fTextEnd - fCurrentPosition;
+	const TChar* stop = fCurrentPosition + (length < remaining ? length : remaining);
+
+	while (fCurrentPosition < stop)
 	{
-		TChar ch = *text;
-		
-		if (ch == '"' || ch == '\'')
-			// fScanState = kString;
-			break;
-		else if (ch == ' ' || ch == '\t' || ch == '\n' || ch == '\r')
-			// fScanState = kWhiteSpace;
-			break;
-		else if (ch == '#')
-			// fScanState = kPreprocessor;
-			break;
-		else if ((ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z') || ch == '_')
-			// fScanState = kIdentifier;
-			break;
-		else if (ch == '/' && (text[1] == '*' || text[1] == '/') && fLanguage != kLanguageRuby)
-			// fScanState = kComment;
-			break;
-		else
-			NextChar(text);
+		STextOffset offset;
+		uint32 tokenLength;
+		NextSyntaxRange(offset, tokenLength);
 	}
+
+	return (fCurrentPosition < fTextEnd);
 }
 
 
-void TSyntaxScanner::SkipTeXUnknown(const TChar*& text)
+// called after each token
+void TSyntaxScanner::AddCheckpoint()
 {
-	while (1)
+	STextOffset offset = fCurrentPosition - fLayout->GetText();
+	STextOffset lastOffset = (fValidCheckpoints > 0 ? fCheckpoints[fValidCheckpoints - 1].offset : 0);
+
+	if (offset <= lastOffset)
+		return;
+
+	// skip the old checkpoints we have passed without landing on
+	while (fNextCheckpoint < fCheckpointCount && fCheckpoints[fNextCheckpoint].offset < offset)
+		fNextCheckpoint++;
+
+	if (fNextCheckpoint < fCheckpointCount && fCheckpoints[fNextCheckpoint].offset == offset)
 	{
-		TChar ch = *text;
-		
-		if (ch == '%')
-			// fScanState = kComment;
-			break;
-		else if (ch == '\\' && isalpha(text[1]))
-			// fScanState = kTeXCommand;
-			break;
-		else if (ch == ' ' || ch == '\t' || ch == '\n' || ch == '\r')
-			// fScanState = kWhiteSpace;
-			break;
-		else if (IsTeXSpecialChar(ch))
-			// fScanState = kTeXSpecialChar;
-			break;
-		else
-			NextChar(text);
+		if (fCheckpoints[fNextCheckpoint].mode == fMode && fCheckpoints[fNextCheckpoint].tokenState == fTokenState)
+		{
+			// back in step with the text before the edit
+			RemoveCheckpoints(fValidCheckpoints, fNextCheckpoint - fValidCheckpoints);
+			fValidCheckpoints = fNextCheckpoint = fCheckpointCount;
+			fResyncOffset = offset;
+			return;
+		}
+
+		fNextCheckpoint++;
 	}
-}
 
+	// tokens before here may change if the text the scan looked at past here does
+	if (offset >= lastOffset + kCheckpointSpacing && fExamined <= fCurrentPosition + kScanLookahead)
+	{
+		// reuse the space of an old checkpoint we have passed if there is one
+		if (fValidCheckpoints == fNextCheckpoint)
+		{
+			fCheckpoints = (Checkpoint *)realloc(fCheckpoints, (fCheckpointCount + 1) * sizeof(Checkpoint));
+			ASSERT(fCheckpoints);
+			memmove(fCheckpoints + fValidCheckpoints + 1, fCheckpoints + fValidCheckpoints, (fCheckpointCount - fValidCheckpoints) * sizeof(Checkpoint));
+			fCheckpointCount++;
+			fNextCheckpoint++;
+		}
 
-bool TSyntaxScanner::IsTeXSpecialChar(TChar ch)
-{
-	return (ch == '{' || ch == '}' || ch == '$' || ch == '^' || ch == '_');
+		fCheckpoints[fValidCheckpoints].offset = offset;
+		fCheckpoints[fValidCheckpoints].mode = fMode;
+		fCheckpoints[fValidCheckpoints].tokenState = fTokenState;
+		fValidCheckpoints++;
+	}
 }
 
 
-void TSyntaxScanner::NextChar(const TChar*& text)
+void TSyntaxScanner::RemoveCheckpoints(uint32 index, uint32 count)
 {
-	if (text >= fTextEnd)
-		throw 1;
-	
-	fLayout->NextCharacter(text);
-}			
-
+	if (count > 0)
+	{
+		memmove(fCheckpoints + index, fCheckpoints + index + count, (fCheckpointCount - index - count) * sizeof(Checkpoint));
+		fCheckpointCount -= count;
+	}
+}
@@ -23,6 +23,9 @@
 #include "TLanguage.h"
 #include "fw/TTextLayout.h"
 
+class TLexer;
+struct TLexerRule;
+
 extern const char* kCKeywords[];
 extern const char* kCPlusPlusKeywords[];
 extern const char* kObjCKeywords[];
@@ -32,6 +35,8 @@ extern const char* kRubyKeywords[];
 extern const char* kPythonKeywords[];
 extern const char* kSwiftKeywords[];
 
+const STextOffset kNotResynced = 0xFFFFFFFF;
+
 class TSyntaxScanner
 {
 public:
@@ -56,32 +61,62 @@ public:
 	
 	TScanState				NextSyntaxRange(STextOffset& offset, uint32& length);
 	void					Reset(ELanguage language);
+	void					Seek(ELanguage language, STextOffset offset);		// resumes from the last checkpoint at or before offset
+	void					TextChanged(STextOffset offset, STextOffset oldLength, STextOffset newLength);
+	bool					ScanAhead(ELanguage language, STextOffset length);	// returns false once the checkpoints reach the end of the text
+
+	// scanning after the last edit finds the same tokens as before it from this offset on
+	inline STextOffset		GetResyncOffset() const { return fResyncOffset; }
 	
 protected:
-	void					SkipWhiteSpace(const TChar*& text);
-	void					SkipComment(const TChar*& text);
-	void					SkipTeXComment(const TChar*& text);
-	void					SkipHTMLComment(const TChar*& text);
-	void					SkipPreprocessor(const TChar*& text);
-	void					SkipIdentifier(const TChar*& text);
-	void					SkipTeXCommand(const TChar*& text);
-	void					SkipString(const TChar*& text);
-	void					SkipTag(const TChar*& text);
-	void					SkipContent(const TChar*& text);
-	void					SkipUnknown(const TChar*& text);
-	void					SkipTeXUnknown(const TChar*& text);
-	
-	bool					IsTeXSpecialChar(TChar ch);
-	void					NextChar(const TChar*& text);
-	inline bool				IsWhiteSpace(TChar ch) { return (ch == ' ' || ch == '\t' || ch == '\n' || ch == '\r' || ch == '\f'); }
+	struct Checkpoint
+	{
+		STextOffset			offset;
+		uint32				mode;			// lexer mode
+		uint32				tokenState;		// lexer state partway through a long token, or 0
+	};
+
+	void					AddCheckpoint();
+	void					RemoveCheckpoints(uint32 index, uint32 count);
+
+	const TChar*			Match(const TChar* text, uint32& ioTokenState, const TLexerRule*& rule);
+
+	static TLexer*			GetLexer(ELanguage language);
 
 	
 	const TTextLayout*		fLayout;
 	ELanguage				fLanguage;
+	const TLexer*			fLexer;
 
 	const TChar*			fCurrentPosition;
 	const TChar*			fTextEnd;
-	TScanState				fScanState;
+	uint32					fMode;
+	uint32					fTokenState;		// the lexer state to carry on from partway through a long token, or 0
+	const TChar*			fExamined;			// the furthest the lexer has looked at since the last Reset or Seek
+
+	// the token found after a range of unknown characters
+	const TChar*			fNextMatchStart;
+	const TChar*			fNextMatchEnd;
+	const TLexerRule*		fNextMatchRule;
+	uint32					fNextMatchState;
+
+	// the scan state about every kCheckpointSpacing characters, at a token boundary or partway through a long one,
+	// so drawing can start scanning near the lines it draws rather than at the top of the file.
+	// the first fValidCheckpoints are known to be right.  those from fNextCheckpoint on were recorded
+	// before an edit, and once scanning after the edit reaches one of them in the same state, they are right again.
+	Checkpoint*				fCheckpoints;
+	uint32					fCheckpointCount;
+	uint32					fValidCheckpoints;
+	uint32					fNextCheckpoint;
+	ELanguage				fCheckpointLanguage;
+	STextOffset				fResyncOffset;
+
+	static TLexer*			sCLexer;
+	static TLexer*			sObjCLexer;
+	static TLexer*			sRubyLexer;
+	static TLexer*			sPythonLexer;
+	static TLexer*			sHTMLLexer;
+	static TLexer*			sTeXLexer;
 };
 
 
@@ -24,11 +24,16 @@
 #include "IDECommon.h"
 
 #include "TSyntaxTextView.h"
+#include "TKeywordTable.h"
+#include "fw/TApplication.h"
 #include "fw/TCursor.h"
 #include "fw/TDrawContext.h"
+#include "fw/TIdler.h"
 #include "fw/TSettingsFile.h"
 
 #include <X11/cursorfont.h>
+#include <ctype.h>
+#include <stdlib.h>
 
 
 TColor TSyntaxTextView::sCommentColor(0xb4, 0, 0);
@@ -42,6 +47,15 @@ bool TSyntaxTextView::sDefaultLineWrap = false;
 int TSyntaxTextView::sSpacesPerTab = 0;
 int TSyntaxTextView::sLineLimit = 0;
 
+static const TKeywordTable sCKeywords(kCKeywords);
+static const TKeywordTable sCPlusPlusKeywords(kCPlusPlusKeywords);
+static const TKeywordTable sObjCKeywords(kObjCKeywords);
+static const TKeywordTable sObjCPlusPlusKeywords(kObjCPlusPlusKeywords);
+static const TKeywordTable sJavaKeywords(kJavaKeywords);
+static const TKeywordTable sRubyKeywords(kRubyKeywords);
+static const TKeywordTable sPythonKeywords(kPythonKeywords);
+static const TKeywordTable sSwiftKeywords(kSwiftKeywords);
+
 const char kUseSyntaxHilitingSetting[]	= "UseSyntaxHiliting";
 const char kPreprocessorColorSetting[]	= "PreprocessorColor";
 const char kCommentColorSetting[]		= "CommentColor";
@@ -54,6 +68,52 @@ const char kLineLimit[]			      	= "LineLimit";
 
 const char TSyntaxTextView::kSpacesPerTab[]	= "SpacesPerTab";
 
+const TTime kBackgroundScanTime = 20;					// longest time to scan for in one idle
+const STextOffset kBackgroundScanLength = 8192;			// characters to scan between checks for input
+const uint32 kLineCacheSize = 256;						// lines to remember the colors of
+const TTime kDrawScanTime = 50;							// longest time to scan for while drawing, the lines after are drawn plain
+const STextOffset kMaxHilitedLineLength = 4096;			// characters of a line to color, the rest is drawn plain
+const uint32 kCatchUpCheckCount = 16;					// scanner ranges to catch up by between checks of the time
+
+
+static inline bool IsWordChar(TChar ch)
+{
+	return (isalnum((unsigned char)ch) || ch == '_');
+}
+
+
+// scans in slices on the main thread.  the scanner reads the layout's text in place and every
+// edit moves its checkpoints, so a worker thread would need its own copy of the text per edit
+// and its results would have to be thrown away whenever the user typed.
+class TSyntaxScanIdler : public TIdler
+{
+public:
+							TSyntaxScanIdler(TSyntaxTextView* view);
+	virtual					~TSyntaxScanIdler();
+	virtual void			DoIdle();
+
+private:
+	TSyntaxTextView*		fView;
+};
+
+
+TSyntaxScanIdler::TSyntaxScanIdler(TSyntaxTextView* view)
+	:	fView(view)
+{
+	SetIdleFrequency(0);
+}
+
+
+TSyntaxScanIdler::~TSyntaxScanIdler()
+{
+}
+
+
+void TSyntaxScanIdler::DoIdle()
+{
+	fView->BackgroundScan();
+}
+
 
 TSyntaxTextView::TSyntaxTextView(TWindow* parent, const TRect& bounds, TFont* font, bool modifiable)
 	:	TTextView(parent, bounds, font, modifiable),
@@ -61,18 +121,43 @@ TSyntaxTextView::TSyntaxTextView(TWindow* parent, const TRect& bounds, TFont* fo
 		fUseSyntaxHiliting(false),
 		fSyntaxScanner(fLayout),
 		fCachedSyntaxScanStateStart(TSyntaxScanner::kNoScanState),
-		fCachedSyntaxScanStateEnd(TSyntaxScanner::kNoScanState)
+		fCachedSyntaxScanStateEnd(TSyntaxScanner::kNoScanState),
+		fScanIdler(NULL),
+		fLineCache(kLineCacheSize),
+		fDrawSpans(NULL),
+		fDrawSpanCount(0),
+		fDrawLineStart(0),
+		fDrawLineEnd(0),
+		fLineSpans(NULL),
+		fLineSpanCount(0),
+		fLineSpanSize(0),
+		fScannedLineEnd(0),
+		fScannedLine(false),
+		fDrawStopTime(0),
+		fDrawOutOfTime(false),
+		fPlainStartLine(0),
+		fPlainEndLine(0),
+		fHasPlainLines(false),
+		fFunctionIndex(fLayout),
+		fWordIndex(fLayout)
 {
 	SetForeColor(sForeColor);
 	SetBackColor(sBackColor);
 	
 	if (sSpacesPerTab > 0)
 		fSpacesPerTab = sSpacesPerTab;
+
+	fLayout->SetTextChangeCallback(TextChangedCallback, this);
+	fScanIdler = new TSyntaxScanIdler(this);
 }	
 
 
 TSyntaxTextView::~TSyntaxTextView()
 {
+	// TTextView deletes the layout after we are gone
+	fLayout->SetTextChangeCallback(NULL, NULL);
+	delete fScanIdler;
+	free(fLineSpans);
 }
 
 
@@ -81,26 +166,38 @@ void TSyntaxTextView::SetUseSyntaxHiliting(bool doit)
 	if (fUseSyntaxHiliting != doit)
 	{
 		fUseSyntaxHiliting = doit; 
+		fLineCache.RemoveAll();
+		StartBackgroundScan();
 		Redraw();
 	}
 }
 
 
+void TSyntaxTextView::SetLanguage(ELanguage language)
+{
+	if (fLanguage != language)
+	{
+		fLanguage = language;
+		fLineCache.RemoveAll();
+		StartBackgroundScan();
+	}
+}
+
+
 void TSyntaxTextView::RedrawLines(uint32 startLine, uint32 endLine, bool showHideInsertionPoint, TRegion* clip)
 {
 	TSyntaxScanner::TScanState savedCachedSyntaxStateStart = fCachedSyntaxScanStateStart;
 	TSyntaxScanner::TScanState savedCachedSyntaxStateEnd = fCachedSyntaxScanStateEnd;
 	
-	if (fUseSyntaxHiliting)
-	{
-		fSyntaxScanner.Reset(fLanguage);
-		if (GetTextLength() > 0)
-			NextSyntaxState();
-	}
+	fDrawSpans = NULL;
+	fScannedLine = false;
+	fDrawStopTime = gApplication->GetCurrentTime() + kDrawScanTime;
+	fDrawOutOfTime = false;
 	
 	TTextView::RedrawLines(startLine, endLine, showHideInsertionPoint, clip);
 
-	if (fUseSyntaxHiliting)
+	// lines that were all in the cache have not changed, so neither has anything after them
+	if (fUseSyntaxHiliting && fScannedLine)
 	{
 		// this is a tweak to make sure fCachedSyntaxScanStateStart and fCachedSyntaxScanStateEnd are updated properly 
 		// when typing at the end of a line
@@ -114,7 +211,7 @@ void TSyntaxTextView::RedrawLines(uint32 startLine, uint32 endLine, bool showHid
 			uint32 lastVisible = LastVisibleLine();
 			
 			if (endLine < lastVisible)
-				RedrawLines(endLine + 1, lastVisible, showHideInsertionPoint, clip);
+				InvalidateLines(endLine + 1, lastVisible, false);
 		}
 	}
 }
@@ -127,77 +224,61 @@ void TSyntaxTextView::DrawText(const TChar* text, int length, TDrawContext& cont
 
 	if (fUseSyntaxHiliting && context.GetDepth() >= 8)
 	{	
-		const TChar* textStart = fLayout->GetText();
-		const TChar* drawTextEnd = text + length;
-	
-		STextOffset offset = text - textStart;
-		if (offset < fSyntaxOffset)
-		{
-			fSyntaxScanner.Reset(fLanguage);
-			NextSyntaxState();
-		}
-
-		while (fSyntaxOffset + fSyntaxLength < offset)
-			NextSyntaxState();
+		STextOffset offset = text - fLayout->GetText();
 		
-		const TChar* syntaxEnd = textStart + fSyntaxOffset + fSyntaxLength;
+		if (!fDrawSpans || offset < fDrawLineStart || offset >= fDrawLineEnd)
+			FindLineSpans(offset);
+
+		// find the span offset is in
+		const TSyntaxLineCache::Span* span = fDrawSpans;
+		const TSyntaxLineCache::Span* spanEnd = fDrawSpans + fDrawSpanCount;
+		STextOffset spanStart = fDrawLineStart;
+
+		while (span < spanEnd && spanStart + span->length <= offset)
+			spanStart += (span++)->length;
 		
-		while (length > 0)
+		while (length > 0 && span < spanEnd)
 		{
-			uint32 drawLength = (syntaxEnd > drawTextEnd ? drawTextEnd - text : syntaxEnd - text);
+			uint32 drawLength = spanStart + span->length - offset;
+			if (drawLength > (uint32)length)
+				drawLength = length;
 				
-			switch (fSyntaxState)
+			switch (span->style)
 			{
-				case TSyntaxScanner::kWhiteSpace:
+				case TSyntaxLineCache::kNoStyle:
 					break;
 	
-				case TSyntaxScanner::kComment:
-				case TSyntaxScanner::kTeXSpecialChar:
+				case TSyntaxLineCache::kPlainStyle:
+					context.SetForeColor(fForeColor);
+					break;
+
+				case TSyntaxLineCache::kCommentStyle:
 					context.SetForeColor(sCommentColor);
 					break;
 
-				case TSyntaxScanner::kPreprocessor:
-				case TSyntaxScanner::kTeXComment:
+				case TSyntaxLineCache::kPreprocessorStyle:
 					context.SetForeColor(sPreprocessorColor);
 					break;
 	
-				case TSyntaxScanner::kIdentifier:
-					if (IsKeyword(textStart + fSyntaxOffset, fSyntaxLength))
-						context.SetForeColor(sKeywordColor);
-					else
-						context.SetForeColor(fForeColor);
-					break;
-	
-				case TSyntaxScanner::kTeXCommand:
-				case TSyntaxScanner::kTag:
+				case TSyntaxLineCache::kKeywordStyle:
 					context.SetForeColor(sKeywordColor);
 					break;
 
-				case TSyntaxScanner::kString:
+				case TSyntaxLineCache::kStringStyle:
 					context.SetForeColor(sStringColor);
 					break;
-	
-				case TSyntaxScanner::kContent:
-				case TSyntaxScanner::kUnknown:
-					context.SetForeColor(fForeColor);
-					break;
-					
-				case TSyntaxScanner::kNoScanState:
-					ASSERT(0);
-					break;
 			}
 
 			TTextView::DrawText(text, drawLength, context);
 			
 			text += drawLength;
+			offset += drawLength;
 			length -= drawLength;
-			
-			if (length > 0)
-			{
-				NextSyntaxState();
-				syntaxEnd = textStart + fSyntaxOffset + fSyntaxLength;;
-			}
+			spanStart += (span++)->length;
 		}
+
+		if (length > 0)
+			TTextView::DrawText(text, length, context);
 	}
 	else
 	{
@@ -206,6 +287,170 @@ void TSyntaxTextView::DrawText(const TChar* text, int length, TDrawContext& cont
 }
 
 
+// sets fDrawSpans to the colors of the line containing offset, from the cache or else by scanning the line
+void TSyntaxTextView::FindLineSpans(STextOffset offset)
+{
+	uint32 line = fLayout->OffsetToLine(offset);
+	STextOffset start = fLayout->LineToOffset(line);
+	STextOffset end = fLayout->LineToOffset(line + 1);
+
+	fDrawLineStart = start;
+	fDrawLineEnd = end;
+	fDrawSpans = fLineCache.Find(start, end, fSyntaxScanner.GetResyncOffset(), fDrawSpanCount);
+
+	if (fDrawSpans)
+		return;
+
+	// out of time for this pass, so draw the line plain and color it when idle
+	if (fDrawOutOfTime || (fScannedLine && gApplication->GetCurrentTime() >= fDrawStopTime))
+	{
+		UsePlainLine(line);
+		return;
+	}
+
+	// drawing down the screen can carry on from the line before
+	if (!fScannedLine || start != fScannedLineEnd)
+	{
+		fSyntaxScanner.Seek(fLanguage, start);
+		NextSyntaxState();
+	}
+
+	// the tail of a very long line is not worth scanning
+	STextOffset lineEnd = end;
+	if (end - start > kMaxHilitedLineLength)
+		end = start + kMaxHilitedLineLength;
+
+	fScannedLine = true;
+	fScannedLineEnd = end;
+	fLineSpanCount = 0;
+
+	STextOffset textLength = GetTextLength();
+	uint32 catchUpCount = 0;
+	
+	while (start < end)
+	{
+		STextOffset tokenEnd = fSyntaxOffset + fSyntaxLength;
+
+		if (tokenEnd <= start && fSyntaxOffset < textLength)
+		{
+			// the checkpoint may be far back, as past the uncolored tail of a very long line,
+			// so catching up to the line is held to the time for drawing too
+			if (++catchUpCount % kCatchUpCheckCount == 0 && gApplication->GetCurrentTime() >= fDrawStopTime)
+			{
+				fScannedLine = false;
+				fDrawOutOfTime = true;
+				UsePlainLine(line);
+				return;
+			}
+
+			NextSyntaxState();
+		}
+		else if (fSyntaxOffset > start || tokenEnd <= start)
+		{
+			// text the scanner did not cover
+			STextOffset gapEnd = (fSyntaxOffset > start && fSyntaxOffset < end ? fSyntaxOffset : end);
+			AddLineSpan(gapEnd - start, TSyntaxLineCache::kPlainStyle);
+			start = gapEnd;
+		}
+		else
+		{
+			STextOffset spanEnd = (tokenEnd < end ? tokenEnd : end);
+			AddLineSpan(spanEnd - start, GetSyntaxStyle());
+			start = spanEnd;
+		}
+	}
+
+	if (lineEnd > end)
+		AddLineSpan(lineEnd - end, TSyntaxLineCache::kPlainStyle);
+
+	fLineCache.Store(fDrawLineStart, fDrawLineEnd, fLineSpans, fLineSpanCount);
+	fDrawSpans = fLineSpans;
+	fDrawSpanCount = fLineSpanCount;
+}
+
+
+// draws the line being drawn plain, and has it redrawn in color once the idle scan has caught up
+void TSyntaxTextView::UsePlainLine(uint32 line)
+{
+	if (!fHasPlainLines || line < fPlainStartLine)
+		fPlainStartLine = line;
+	if (!fHasPlainLines || line > fPlainEndLine)
+		fPlainEndLine = line;
+	fHasPlainLines = true;
+	fScanIdler->EnableIdling(true);
+
+	fPlainSpan.length = fDrawLineEnd - fDrawLineStart;
+	fPlainSpan.style = TSyntaxLineCache::kPlainStyle;
+	fDrawSpans = &fPlainSpan;
+	fDrawSpanCount = 1;
+}
+
+
+void TSyntaxTextView::AddLineSpan(uint32 length, TSyntaxLineCache::EStyle style)
+{
+	// white space keeps the color before it
+	if (fLineSpanCount > 0 && (style == TSyntaxLineCache::kNoStyle || style == fLineSpans[fLineSpanCount - 1].style))
+	{
+		fLineSpans[fLineSpanCount - 1].length += length;
+		return;
+	}
+
+	if (fLineSpanCount == fLineSpanSize)
+	{
+		fLineSpanSize = (fLineSpanSize > 0 ? fLineSpanSize * 2 : 64);
+		fLineSpans = (TSyntaxLineCache::Span *)realloc(fLineSpans, fLineSpanSize * sizeof(TSyntaxLineCache::Span));
+		ASSERT(fLineSpans);
+	}
+
+	fLineSpans[fLineSpanCount].length = length;
+	fLineSpans[fLineSpanCount].style = style;
+	fLineSpanCount++;
+}
+
+
+TSyntaxLineCache::EStyle TSyntaxTextView::GetSyntaxStyle()
+{
+	switch (fSyntaxState)
+	{
+		case TSyntaxScanner::kWhiteSpace:
+			return TSyntaxLineCache::kNoStyle;
+
+		case TSyntaxScanner::kComment:
+		case TSyntaxScanner::kTeXSpecialChar:
+			return TSyntaxLineCache::kCommentStyle;
+
+		case TSyntaxScanner::kPreprocessor:
+		case TSyntaxScanner::kTeXComment:
+			return TSyntaxLineCache::kPreprocessorStyle;
+
+		case TSyntaxScanner::kIdentifier:
+			// the scanner returns a very long identifier in pieces, and the last of them is no keyword
+			if ((fSyntaxOffset == 0 || !IsWordChar(fLayout->GetText()[fSyntaxOffset - 1])) &&
+				IsKeyword(fLayout->GetText() + fSyntaxOffset, fSyntaxLength))
+				return TSyntaxLineCache::kKeywordStyle;
+			else
+				return TSyntaxLineCache::kPlainStyle;
+
+		case TSyntaxScanner::kTeXCommand:
+		case TSyntaxScanner::kTag:
+			return TSyntaxLineCache::kKeywordStyle;
+
+		case TSyntaxScanner::kString:
+			return TSyntaxLineCache::kStringStyle;
+
+		case TSyntaxScanner::kContent:
+		case TSyntaxScanner::kUnknown:
+			return TSyntaxLineCache::kPlainStyle;
+			
+		case TSyntaxScanner::kNoScanState:
+			ASSERT(0);
+			break;
+	}
+
+	return TSyntaxLineCache::kPlainStyle;
+}
+
+
 TCoord TSyntaxTextView::GetLineLimit(TDrawContext& context)
 {
     if (fUseSyntaxHiliting)
@@ -235,6 +480,61 @@ void TSyntaxTextView::SetSelection(STextOffset start, STextOffset end, bool redr
 }
 
 
+void TSyntaxTextView::ShowFunction(STextOffset offset)
+{
+	// leave a line above the function showing
+	uint32 line = fLayout->OffsetToLine(offset);
+	ScrollToLine(line > 0 ? line - 1 : 0);
+	TTextView::SetSelection(fLayout->LineToOffset(line));
+}
+
+
+// typing letters, digits and spaces can only change the colors of the words around them.
+// anything else might start or end a comment or string and change the rest of the line.
+bool TSyntaxTextView::CanMoveLineTail(STextOffset start, STextOffset end, const TChar* text, STextOffset length) const
+{
+	if (!TTextView::CanMoveLineTail(start, end, text, length))
+		return false;
+
+	if (fUseSyntaxHiliting)
+	{
+		const TChar* oldText = GetText() + start;
+		STextOffset i;
+
+		for (i = 0; i < end - start; i++)
+			if (!IsWordChar(oldText[i]) && oldText[i] != ' ' && oldText[i] != '\t')
+				return false;
+
+		for (i = 0; i < length; i++)
+			if (!IsWordChar(text[i]) && text[i] != ' ' && text[i] != '\t')
+				return false;
+	}
+
+	return true;
+}
+
+
+void TSyntaxTextView::ExtendLineEditDamage(STextOffset& ioStart, STextOffset& ioEnd) const
+{
+	if (fUseSyntaxHiliting)
+	{
+		const TChar* text = GetText();
+		STextOffset length = GetTextLength();
+
+		while (ioStart > 0 && IsWordChar(text[ioStart - 1]))
+			ioStart--;
+		while (ioEnd < length && IsWordChar(text[ioEnd]))
+			ioEnd++;
+
+		// and the character on either side, which may belong to the same token, as in #include or \section
+		if (ioStart > 0 && !isspace((unsigned char)text[ioStart - 1]))
+			ioStart--;
+		if (ioEnd < length && !isspace((unsigned char)text[ioEnd]))
+			ioEnd++;
+	}
+}
+
+
 void TSyntaxTextView::NextSyntaxState()
 {
 	do 
@@ -258,51 +558,94 @@ void TSyntaxTextView::NextSyntaxState()
 }
 
 
+void TSyntaxTextView::TextChangedCallback(TTextLayout* /*layout*/, STextOffset offset, STextOffset oldLength, STextOffset newLength, void* clientData)
+{
+	TSyntaxTextView* view = (TSyntaxTextView *)clientData;
+	
+	// the cache needs to know where the scan came back in step after the edit before
+	view->fLineCache.TextChanged(offset, oldLength, newLength, view->fSyntaxScanner.GetResyncOffset());
+	view->fSyntaxScanner.TextChanged(offset, oldLength, newLength);
+	view->fFunctionIndex.TextChanged(offset, oldLength, newLength);
+	view->fWordIndex.TextChanged(offset, oldLength, newLength);
+	view->fDrawSpans = NULL;
+	view->fScannedLine = false;
+	view->StartBackgroundScan();
+}
+
+
+void TSyntaxTextView::StartBackgroundScan()
+{
+	fScanIdler->EnableIdling((fUseSyntaxHiliting && fLanguage != kLanguageNone) || fWordIndex.NeedsUpdate());
+}
+
+
+void TSyntaxTextView::BackgroundScan()
+{
+	TTime stopTime = gApplication->GetCurrentTime() + kBackgroundScanTime;
+	
+	// drawing cannot carry on from where it left the scanner
+	fScannedLine = false;
+
+	// color the lines drawn plain when drawing ran out of time
+	if (fHasPlainLines)
+	{
+		InvalidateLines(fPlainStartLine, fPlainEndLine, false);
+		fHasPlainLines = false;
+	}
+
+	bool hiliting = (fUseSyntaxHiliting && fLanguage != kLanguageNone);
+
+	// give way as soon as there is input to handle, the words are indexed once the colors are done
+	do
+	{
+		if (!(hiliting && fSyntaxScanner.ScanAhead(fLanguage, kBackgroundScanLength)) &&
+			!fWordIndex.UpdateAhead(kBackgroundScanLength))
+		{
+			fScanIdler->EnableIdling(false);
+			break;
+		}
+	}
+	while (!gApplication->HasPendingEvents() && gApplication->GetCurrentTime() < stopTime);
+}
+
+
 bool TSyntaxTextView::IsKeyword(const TChar* text, uint32 length)
 {
 	ASSERT(length > 0);
 	
-	const char** keyword;
+	const TKeywordTable* keywords;
 	
 	switch (fLanguage)
 	{
 		case kLanguageC:
-			keyword = kCKeywords;
+			keywords = &sCKeywords;
 			break;
 		case kLanguageCPlusPlus:
-			keyword = kCPlusPlusKeywords;
+			keywords = &sCPlusPlusKeywords;
 			break;
 		case kLanguageObjC:
-			keyword = kObjCKeywords;
+			keywords = &sObjCKeywords;
 			break;
 		case kLanguageObjCPlusPlus:
-			keyword = kObjCPlusPlusKeywords;
+			keywords = &sObjCPlusPlusKeywords;
 			break;
 		case kLanguageJava:
-			keyword = kJavaKeywords;
+			keywords = &sJavaKeywords;
 			break;
 		case kLanguageRuby:
-			keyword = kRubyKeywords;
+			keywords = &sRubyKeywords;
 			break;
 		case kLanguagePython:
-			keyword = kPythonKeywords;
+			keywords = &sPythonKeywords;
 			break;
 		case kLanguageSwift:
-			keyword = kPythonKeywords;
+			keywords = &sSwiftKeywords;
 			break;						
 		default:
 			return false;
 	}
 	
-	while (**keyword)
-	{
-		if (length == strlen(*keyword) && strncmp(*keyword, text, length) == 0)
-			return true;
-		else
-			keyword++;
-	}
-	
-	return false;
+	return keywords->Contains(text, length);
 }
 
 
@@ -22,9 +22,13 @@
 
 #include "fw/TTextView.h"
 #include "TSyntaxScanner.h"
+#include "TSyntaxLineCache.h"
+#include "TFunctionIndex.h"
+#include "TWordIndex.h"
 #include "TLanguage.h"
 
 class TSettingsFile;
+class TSyntaxScanIdler;
 
 
 class TSyntaxTextView : public TTextView
@@ -35,13 +39,17 @@ public:
 								TSyntaxTextView(TWindow* parent, const TRect& bounds, TFont* font, bool modifiable);
 	
 	void						SetUseSyntaxHiliting(bool doit);
-	inline void					SetLanguage(ELanguage language) { fLanguage = language; }
+	void						SetLanguage(ELanguage language);
 
 	static void					ReadFromSettingsFile(TSettingsFile* settingsFile);
 	static void					WriteToSettingsFile(TSettingsFile* settingsFile);
 	
 	static inline bool			DefaultLineWrap()	{ return sDefaultLineWrap; }
 
+	inline TFunctionIndex&		GetFunctionIndex()	{ return fFunctionIndex; }
+	inline TWordIndex&			GetWordIndex()		{ return fWordIndex; }
+	void						ShowFunction(STextOffset offset);
+
 protected:
 	virtual						~TSyntaxTextView();
 
@@ -53,8 +61,17 @@ protected:
 	virtual void				SetSelection(STextOffset start, STextOffset end, bool redraw = true);
 
 	virtual void				EraseContentDifference(const TPoint& oldContentSize, const TPoint& newContentSize);
+	virtual bool				CanMoveLineTail(STextOffset start, STextOffset end, const TChar* text, STextOffset length) const;
+	virtual void				ExtendLineEditDamage(STextOffset& ioStart, STextOffset& ioEnd) const;
 	
 	void						NextSyntaxState();
+	void						FindLineSpans(STextOffset offset);
+	void						UsePlainLine(uint32 line);
+	void						AddLineSpan(uint32 length, TSyntaxLineCache::EStyle style);
+	TSyntaxLineCache::EStyle	GetSyntaxStyle();
+	void						StartBackgroundScan();
+	void						BackgroundScan();
+	static void					TextChangedCallback(TTextLayout* layout, STextOffset offset, STextOffset oldLength, STextOffset newLength, void* clientData);
 	bool						IsKeyword(const TChar* text, uint32 length);
 
 	TCoord						GetLineLimit(TDrawContext& context);
@@ -69,6 +86,28 @@ protected:
 	
 	TSyntaxScanner::TScanState	fCachedSyntaxScanStateStart;	// cached scan state at start of selection
 	TSyntaxScanner::TScanState	fCachedSyntaxScanStateEnd;		// cached scan state at line after end of selection
+
+	TSyntaxScanIdler*			fScanIdler;						// fills in the scanner checkpoints ahead of drawing
+
+	TSyntaxLineCache			fLineCache;
+	const TSyntaxLineCache::Span*	fDrawSpans;					// colors of the line being drawn, NULL if not known yet
+	uint32						fDrawSpanCount;
+	STextOffset					fDrawLineStart;
+	STextOffset					fDrawLineEnd;
+	TSyntaxLineCache::Span*		fLineSpans;						// colors of the last line scanned
+	uint32						fLineSpanCount;
+	uint32						fLineSpanSize;
+	STextOffset					fScannedLineEnd;
+	bool						fScannedLine;					// the scanner was used while drawing
+	TTime						fDrawStopTime;					// lines not cached are drawn plain after this
+	bool						fDrawOutOfTime;					// the rest of the lines being drawn are drawn plain
+	TSyntaxLineCache::Span		fPlainSpan;
+	uint32						fPlainStartLine;				// lines drawn plain, to redraw when idle
+	uint32						fPlainEndLine;
+	bool						fHasPlainLines;
+
+	TFunctionIndex				fFunctionIndex;
+	TWordIndex					fWordIndex;						// indexed by the background scan too
 	
 	static TColor				sCommentColor;
 	static TColor				sPreprocessorColor;
@@ -83,6 +122,7 @@ protected:
 	static int					sSpacesPerTab;
 	static int                  sLineLimit;
 
+	friend class TSyntaxScanIdler;
 };
 
 #endif // __TEditorTextView__
@@ -25,12 +25,15 @@
 
 #include "TTextDocument.h"
 #include "TEditorTextView.h"
+#include "TCompletionMenu.h"
+#include "TFunctionNavigator.h"
 #include "TFunctionsMenu.h"
 #include "TIDEApplication.h"
 #include "TLineNumberBehavior.h"
 #include "TFilePathBehavior.h"
 #include "TProjectCommands.h"
 #include "TProjectDocument.h"
+#include "TSymbolIndex.h"
 #include "THTMLCommands.h"
 #include "THTMLBehavior.h"
 #include "TTeXCommands.h"
@@ -39,6 +42,7 @@
 #include "fw/TStatusBar.h"
 #include "fw/TDocumentWindow.h"
 #include "fw/TWindowPositioners.h"
+#include "fw/TTopLevelWindow.h"
 #include "fw/TApplication.h"
 #include "fw/TMenuBar.h"
 #include "fw/TWindowsMenu.h"
@@ -46,15 +50,22 @@
 #include "fw/TFont.h"
 #include "fw/TCommandID.h"
 #include "fw/TTextFindBehavior.h"
+#include "fw/TEditJournal.h"
+#include "fw/TCommonDialogs.h"
 
 #include "fw/intl.h"
 
 #include <X11/keysym.h>
 #include <stdlib.h>
+#include <stdio.h>
+#include <limits.h>
 
 
 long TTextDocument::sNextLineNumber = -1;
 
+const uint32 kMaxDefinitions = 100;
+const uint32 kMaxCompletions = 20;
+
 
 static TMenuItemRec sFileFormatMenu[] = 
 {
@@ -91,6 +102,20 @@ static TMenuItemRec sFileMenu[] =
 	{ "" }
 };
 
+static TMenuItemRec sLinesMenu[] = 
+{
+	{ N_("Sort"), kSortLinesCommandID },
+	{ N_("Sort Numerically"), kSortLinesNumericallyCommandID },
+	{ N_("Sort Ignoring Case"), kSortLinesIgnoringCaseCommandID },
+	{ N_("Sort by Column..."), kSortLinesByColumnCommandID },
+	{ N_("Sort in Reverse"), kSortLinesReversedCommandID },
+	{ "-" },
+	{ N_("Remove Duplicates"), kUniqueLinesCommandID },
+	{ N_("Keep Lines Matching..."), kKeepMatchingLinesCommandID },
+	{ N_("Delete Lines Matching..."), kDeleteMatchingLinesCommandID },
+	{ "" }
+};
+
 static TMenuItemRec sEditMenu[] = 
 {
 	{ N_("Undo"), kUndoCommandID, Mod1Mask, 'z' },
@@ -105,6 +130,9 @@ static TMenuItemRec sEditMenu[] =
 	{ N_("Shift Left"), kShiftLeftCommandID, Mod1Mask, '[' },
 	{ N_("Shift Right"), kShiftRightCommandID, Mod1Mask, ']' },
 	{ N_("Balance Selection"), kBalanceSelectionCommandID, Mod1Mask, 'b' },
+	{ N_("Complete Word"), kCompleteWordCommandID, ControlMask, '/' },
+	{ "-" },
+	{ N_("Lines"), 0, 0, 0, sLinesMenu },
 	{ "" }
 };
 
@@ -120,6 +148,10 @@ static TMenuItemRec sSearchMenu[] =
 	{ N_("Replace and Find Next"), kReplaceNextCommandID, Mod1Mask, 'l' },
 	{ "-" },
 	{ N_("Goto Line..."), kGotoLineCommandID, Mod1Mask, ',' },
+	{ N_("Goto Function..."), kGotoFunctionCommandID, Mod1Mask, 'e' },
+	{ N_("Find Definition"), kFindDefinitionCommandID, ShiftMask|Mod1Mask, 'e' },
+	{ N_("Next Change"), kNextChangeCommandID, Mod1Mask, 'j' },
+	{ N_("Previous Change"), kPreviousChangeCommandID, ShiftMask|Mod1Mask, 'j' },
 	{ "" }
 };
 
@@ -229,11 +261,14 @@ TTextDocument::TTextDocument(TFile* file)
 	:	TDocument(file),
 		fTextView(NULL),
 		fFunctionsMenu(NULL),
+		fCompletionMenu(NULL),
 		fHTMLMenu(NULL),
 		fTeXMenu(NULL),
 		fWindowsMenu(NULL),
 		fMenuBar(NULL),
-		fLineEndingsChanged(false)
+		fLineEndingsChanged(false),
+		fEditJournal(NULL),
+		fRecovered(false)
 {
 	AddBehavior(new TProjectBehavior(NULL));
 	
@@ -246,6 +281,15 @@ TTextDocument::TTextDocument(TFile* file)
 TTextDocument::~TTextDocument()
 {
 	gApplication->RemoveNotifyFileChanged(this);
+
+	// the document was either saved or the user chose to throw away the changes
+	if (fEditJournal)
+	{
+		fEditJournal->Discard();
+		delete fEditJournal;
+	}
+
+	delete fCompletionMenu;
 }
 
 
@@ -276,6 +320,7 @@ void TTextDocument::Open(TDocumentWindow* window)
 	TEditorTextView* textView = new TEditorTextView(scroller, bounds, font);
 	scroller->SetContainedView(textView);
 	fTextView = textView;
+	textView->SetShowModifiedLines(true);
 	window->SetTarget(textView);	
 	if (TSyntaxTextView::DefaultLineWrap())
 		textView->SetLineWrap(true);
@@ -338,15 +383,32 @@ void TTextDocument::ReadFromFile(TFile* file)
 	ASSERT(data || length == 0);
 
 	if (data)
-	{
 		file->Read(data, length);
-		fTextView->SetText(data, length, true);
-	}
 
 	file->Close();
+
+	// replay edits that were never saved if we went away without closing the document
+	fRecovered = false;
+
+	if (TEditJournal::CanRecover(*file))
+	{
+		char	prompt[PATH_MAX + 100];
+		sprintf(prompt, _("The file \"%s\" has unsaved changes from a previous session.  Do you want to recover them?"), file->GetFileName());
+
+		if (TCommonDialogs::ConfirmDialog(prompt, _("Recover Changes"), NULL, _("Recover"), _("Discard")))
+			fRecovered = TEditJournal::Recover(*file, data, length);
+	}
+
+	if (data)
+		fTextView->SetText(data, length, true);
 	
 	// clear undo/redo, in case file was reloaded
 	fTextView->ClearUndoRedo();
+
+	StartEditJournal(file, fRecovered);
+
+	if (fRecovered)
+		SetModified(true);
 }
 
 
@@ -364,9 +426,44 @@ void TTextDocument::WriteToFile(TFile* file)
 	
 	fTextView->TextSaved();		// record undo/redo index at this point
 	fLineEndingsChanged = false;
+
+	// the file on disk has all the edits now, unless we were saving a copy
+	if (!fFile.IsSpecified() || Tstrcmp(fFile.GetPath(), file->GetPath()) == 0)
+	{
+		fRecovered = false;
+		StartEditJournal(file, false);
+	}
 	
 	if (Tstrcmp(gApplication->GetSettingsFilePath(), file->GetPath()) == 0)
 		gApplication->ReloadSettings();
+
+	TProjectDocument* project = TProjectDocument::GetCurrentProject();
+	if (project)
+		project->FileSaved(*file);
+}
+
+
+void TTextDocument::StartEditJournal(TFile* file, bool recovered)
+{
+	ASSERT(fTextView);
+
+	if (fEditJournal && Tstrcmp(fEditJournal->GetFile().GetPath(), file->GetPath()) != 0)
+	{
+		fEditJournal->Discard();
+		delete fEditJournal;
+		fEditJournal = NULL;
+	}
+
+	if (!fEditJournal)
+	{
+		fEditJournal = new TEditJournal(*file);
+		fTextView->SetEditJournal(fEditJournal);
+	}
+
+	if (recovered)
+		fEditJournal->Continue();
+	else
+		fEditJournal->Begin();
 }
 
 
@@ -378,9 +475,7 @@ void TTextDocument::SetTitle(const TChar* title)
 	
 	ELanguage language = GetFileLanguage(extension);
 
-	if (language == kLanguageC || language == kLanguageCPlusPlus ||
-		language == kLanguageObjC || language == kLanguageObjCPlusPlus ||
-		language == kLanguageJava || language == kLanguageSwift)
+	if (LanguageHasFunctions(language))
 		AddFunctionsMenu();
 	else
 		RemoveFunctionsMenu();
@@ -412,7 +507,7 @@ void TTextDocument::SetTitle(const TChar* title)
 
 bool TTextDocument::IsModified() const
 {
-	return (fModified && fTextView->NeedsSaving()) || fLineEndingsChanged;
+	return (fModified && fTextView->NeedsSaving()) || fLineEndingsChanged || fRecovered;
 }
 
 
@@ -428,6 +523,16 @@ void TTextDocument::DoSetupMenu(TMenu* menu)
 	menu->EnableCommand(kToggleHTMLMenuCommandID, (fHTMLMenu != NULL));
 	menu->EnableCommand(kToggleTeXMenuCommandID, (fTeXMenu != NULL));
 
+	if (fFunctionsMenu)
+		menu->EnableCommand(kGotoFunctionCommandID);
+
+	if (fTextView && fTextView->IsModifiable())
+		menu->EnableCommand(kCompleteWordCommandID);
+
+	TProjectDocument* project = TProjectDocument::GetCurrentProject();
+	if (project && project->GetSymbolIndex())
+		menu->EnableCommand(kFindDefinitionCommandID);
+
 	TDocument::DoSetupMenu(menu);
 }
 
@@ -484,6 +589,21 @@ bool TTextDocument::DoCommand(TCommandHandler* sender, TCommandHandler* receiver
 
 		return true;
 	}
+	else if (command == kGotoFunctionCommandID && fFunctionsMenu)
+	{
+		TFunctionNavigator::GotoFunction(fTextView);
+		return true;
+	}
+	else if (command == kFindDefinitionCommandID)
+	{
+		FindDefinition();
+		return true;
+	}
+	else if (command == kCompleteWordCommandID)
+	{
+		CompleteWord();
+		return true;
+	}
 	else
 		return TDocument::DoCommand(sender, receiver, command);
 }
@@ -592,6 +712,116 @@ bool TTextDocument::DoKeyDown(KeySym key, TModifierState state, const char* stri
 }
 
 
+void TTextDocument::FindDefinition()
+{
+	TProjectDocument* project = TProjectDocument::GetCurrentProject();
+	TSymbolIndex* index = (project ? project->GetSymbolIndex() : NULL);
+	if (!index)
+		return;
+
+	// the selection, or the word the insertion point is in
+	STextOffset start, end;
+	fTextView->GetSelection(start, end);
+
+	if (start == end)
+	{
+		STextOffset offset = start;
+		if (!fTextView->GetTextLayout()->FindWord(offset, start, end))
+		{
+			gApplication->Beep();
+			return;
+		}
+	}
+
+	TSymbolIndex::Definition definitions[kMaxDefinitions];
+	uint32 count = index->FindSymbol(fTextView->GetText() + start, end - start, definitions, kMaxDefinitions);
+
+	if (count == 0)
+	{
+		gApplication->Beep();
+		return;
+	}
+
+	if (count > kMaxDefinitions)
+		count = kMaxDefinitions;
+
+	// from one of the definitions go on to the next, so doing it again steps through them all
+	uint32 line = fTextView->GetTextLayout()->OffsetToLine(start, true);
+	uint32 next = 0;
+	TString path;
+
+	for (uint32 i = 0; i < count; i++)
+	{
+		index->GetFilePath(definitions[i].file, path);
+
+		if (definitions[i].line == line && fFile.IsSpecified() && Tstrcmp(path, fFile.GetPath()) == 0)
+		{
+			next = (i + 1) % count;
+			break;
+		}
+	}
+
+	index->GetFilePath(definitions[next].file, path);
+	TFile file(path);
+	gApplication->OpenFile(&file, definitions[next].line + 1);
+}
+
+
+void TTextDocument::CompleteWord()
+{
+	STextOffset start, end;
+	fTextView->GetSelection(start, end);
+
+	const TChar* text = fTextView->GetText();
+	STextOffset prefixStart = end;
+
+	while (prefixStart > 0 && TWordIndex::IsWordCharacter(text[prefixStart - 1]))
+		prefixStart--;
+
+	if (start != end || prefixStart == end)
+	{
+		gApplication->Beep();
+		return;
+	}
+
+	// still showing, and may be the one handling this
+	if (fCompletionMenu && fTextView->GetTopLevelWindow()->GetTarget() == fCompletionMenu)
+		return;
+
+	// the words of all the open documents
+	TDynamicArray<TWordIndex::Completion> completions(4096);
+	TListIterator<TWindowContext> iter(gApplication->GetSubContextList());
+	TWindowContext* context;
+
+	while ((context = iter.Next()) != NULL)
+	{
+		TTextDocument* document = dynamic_cast<TTextDocument*>(context);
+
+		if (document && document->fTextView)
+			document->fTextView->GetWordIndex().FindCompletions(text + prefixStart, end - prefixStart, completions);
+	}
+
+	uint32 count = completions.GetSize();
+	if (count > 0)
+		count = TWordIndex::MergeCompletions(&completions[0], count, kMaxCompletions);
+
+	if (count == 0)
+		gApplication->Beep();
+	else if (count == 1)
+		TCompletionMenu::InsertCompletion(fTextView, completions[0].word, completions[0].length, end - prefixStart);
+	else
+	{
+		delete fCompletionMenu;
+		fCompletionMenu = new TCompletionMenu(fTextView, end - prefixStart);
+
+		for (uint32 i = 0; i < count; i++)
+			fCompletionMenu->AddCompletion(completions[i].word, completions[i].length);
+
+		fCompletionMenu->DisplayAtInsertionPoint();
+	}
+}
+
+
 void TTextDocument::AddFunctionsMenu()
 {
 	if (! fFunctionsMenu)
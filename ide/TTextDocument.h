@@ -27,6 +27,8 @@ class TDocumentWindow;
 class TMenuBar;
 class TWindow;
 class TFunctionsMenu;
+class TCompletionMenu;
+class TEditJournal;
 
 
 class TTextDocument : public TDocument
@@ -60,6 +62,10 @@ protected:
 	virtual bool			DoCommand(TCommandHandler* sender, TCommandHandler* receiver, TCommandID command);
 	virtual bool			DoKeyDown(KeySym key, TModifierState state, const char* string);
 	
+	void					StartEditJournal(TFile* file, bool recovered);
+	void					FindDefinition();
+	void					CompleteWord();
+
 	void					AddFunctionsMenu();
 	void					RemoveFunctionsMenu();
 
@@ -72,11 +78,14 @@ protected:
 protected:
 	TEditorTextView*		fTextView;
 	TFunctionsMenu*			fFunctionsMenu;
+	TCompletionMenu*		fCompletionMenu;
 	TMenu*					fHTMLMenu;
 	TMenu*					fTeXMenu;
 	TMenu*					fWindowsMenu;
 	TMenuBar*				fMenuBar;
 	bool					fLineEndingsChanged;
+	TEditJournal*			fEditJournal;
+	bool					fRecovered;				// contains edits recovered from the journal that have not been saved
 	
 	static long				sNextLineNumber;
 };
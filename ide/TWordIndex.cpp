@@ -0,0 +1,696 @@
+// ========================================================================================
+//	TWordIndex.cpp			   Copyright (C) 2001-2009 Mike Voydanoff. All rights reserved.
+// ========================================================================================
+/*
+	This program is free software; you can redistribute it and/or
+	modify it under the terms of the GNU General Public License
+	as published by the Free Software Foundation; either version 2
+	of the License, or (at your option) any later version.
+	
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+	
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*/
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "IDECommon.h"
+
+#include "TWordIndex.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+
+const STextOffset kChunkLength = 4096;
+const uint32 kMinWordLength = 2;
+const uint32 kMaxWordLength = 256;
+const uint32 kMinCompactCount = 4096;			// dead words to collect before compacting
+const uint32 kNoWord = (uint32)-1;				// -1 rather than 0xFFFFFFFF so filling with 0xFF matches when uint32 is 64 bits
+
+
+struct NewWord
+{
+	const TChar*	name;
+	uint32			length;
+	uint32			word;
+};
+
+
+// where offset is after oldLength characters at offset are replaced by newLength others
+static inline STextOffset ShiftOffset(STextOffset value, STextOffset offset, STextOffset oldLength, STextOffset newLength)
+{
+	if (value >= offset + oldLength)
+		return value - oldLength + newLength;
+	else if (value > offset)
+		return offset;
+	else
+		return value;
+}
+
+
+static inline uint32 HashWord(const TChar* name, uint32 length)
+{
+	uint32 hash = 2166136261U;
+
+	for (uint32 i = 0; i < length; i++)
+		hash = ((hash ^ (unsigned char)name[i]) * 16777619U) & 0xFFFFFFFF;
+
+	return hash;
+}
+
+
+static inline int CompareWords(const TChar* name1, uint32 length1, const TChar* name2, uint32 length2)
+{
+	int result = memcmp(name1, name2, (length1 < length2 ? length1 : length2));
+
+	if (result == 0)
+		result = (length1 < length2 ? -1 : (length1 > length2 ? 1 : 0));
+
+	return result;
+}
+
+
+static int CompareNewWords(const void* item1, const void* item2)
+{
+	const NewWord* word1 = (const NewWord *)item1;
+	const NewWord* word2 = (const NewWord *)item2;
+
+	return CompareWords(word1->name, word1->length, word2->name, word2->length);
+}
+
+
+static int CompareCompletionWords(const void* item1, const void* item2)
+{
+	const TWordIndex::Completion* completion1 = (const TWordIndex::Completion *)item1;
+	const TWordIndex::Completion* completion2 = (const TWordIndex::Completion *)item2;
+
+	return CompareWords(completion1->word, completion1->length, completion2->word, completion2->length);
+}
+
+
+static int CompareCompletionCounts(const void* item1, const void* item2)
+{
+	const TWordIndex::Completion* completion1 = (const TWordIndex::Completion *)item1;
+	const TWordIndex::Completion* completion2 = (const TWordIndex::Completion *)item2;
+
+	if (completion1->count != completion2->count)
+		return (completion1->count > completion2->count ? -1 : 1);
+	else
+		return CompareCompletionWords(item1, item2);
+}
+
+
+TWordIndex::TWordIndex(const TTextLayout* layout)
+	:	fLayout(layout),
+		fChunks(NULL),
+		fChunkCount(0),
+		fEdited(true),
+		fWords(NULL),
+		fWordCount(0),
+		fWordSize(0),
+		fLiveCount(0),
+		fNames(NULL),
+		fNamesLength(0),
+		fNamesSize(0),
+		fBuckets(NULL),
+		fBucketCount(0),
+		fSorted(NULL),
+		fSortedCount(0),
+		fScanWords(NULL),
+		fScanWordCount(0),
+		fScanWordSize(0),
+		fScanMark(0)
+{
+	ASSERT(layout);
+
+	// all of the text is still to be indexed
+	fChunks = (Chunk *)malloc(sizeof(Chunk));
+	ASSERT(fChunks);
+	fChunks[0].start = 0;
+	fChunks[0].words = NULL;
+	fChunks[0].wordCount = 0;
+	fChunks[0].edited = true;
+	fChunkCount = 1;
+
+	Rehash(1024);
+}
+
+
+TWordIndex::~TWordIndex()
+{
+	for (uint32 i = 0; i < fChunkCount; i++)
+		free(fChunks[i].words);
+
+	free(fChunks);
+	free(fWords);
+	free(fNames);
+	free(fBuckets);
+	free(fSorted);
+	free(fScanWords);
+}
+
+
+void TWordIndex::TextChanged(STextOffset offset, STextOffset oldLength, STextOffset newLength)
+{
+	STextOffset textLength = fLayout->GetTextLength();
+
+	for (uint32 i = 1; i < fChunkCount; i++)
+		fChunks[i].start = ShiftOffset(fChunks[i].start, offset, oldLength, newLength);
+
+	// the chunks either side that touch the edit are taken too, since a word there may have joined or split
+	for (uint32 i = 0; i < fChunkCount; i++)
+	{
+		STextOffset end = (i + 1 < fChunkCount ? fChunks[i + 1].start : textLength);
+
+		if (fChunks[i].start <= offset + newLength && end >= offset)
+			fChunks[i].edited = true;
+	}
+
+	fEdited = true;
+}
+
+
+bool TWordIndex::UpdateAhead(STextOffset maxLength)
+{
+	uint32 first = 0;
+	while (first < fChunkCount && !fChunks[first].edited)
+		first++;
+
+	if (first == fChunkCount)
+	{
+		Sort();
+		fEdited = false;
+		return false;
+	}
+
+	uint32 last = first + 1;
+	while (last < fChunkCount && fChunks[last].edited)
+		last++;
+
+	const TChar* text = fLayout->GetText();
+	STextOffset start = fChunks[first].start;
+	STextOffset end = (last < fChunkCount ? fChunks[last].start : fLayout->GetTextLength());
+
+	for (uint32 i = first; i < last; i++)
+	{
+		RemoveWords(fChunks[i]);
+		free(fChunks[i].words);
+	}
+
+	// at most one chunk more than fits in maxLength, and what is left is edited
+	uint32 newCount = 0;
+	uint32 newSize = (end - start > maxLength ? maxLength : end - start) / kChunkLength + 2;
+	Chunk* newChunks = (Chunk *)malloc(newSize * sizeof(Chunk));
+	ASSERT(newChunks);
+
+	STextOffset offset = start;
+
+	do
+	{
+		STextOffset chunkEnd = offset + kChunkLength;
+
+		if (chunkEnd >= end)
+			chunkEnd = end;
+		else
+		{
+			// chunks end between words
+			while (chunkEnd < end && IsWordCharacter(text[chunkEnd]))
+				chunkEnd++;
+		}
+
+		ASSERT(newCount < newSize);
+		Chunk& chunk = newChunks[newCount++];
+		ScanChunk(chunk, offset, chunkEnd);
+		offset = chunkEnd;
+	}
+	while (offset < end && offset - start < maxLength && newCount + 1 < newSize);
+
+	if (offset < end)
+	{
+		Chunk& chunk = newChunks[newCount++];
+		chunk.start = offset;
+		chunk.words = NULL;
+		chunk.wordCount = 0;
+		chunk.edited = true;
+	}
+
+	// replace the chunks from first to last with the new ones
+	uint32 chunkCount = fChunkCount - (last - first) + newCount;
+
+	if (chunkCount > fChunkCount)
+	{
+		fChunks = (Chunk *)realloc(fChunks, chunkCount * sizeof(Chunk));
+		ASSERT(fChunks);
+	}
+
+	memmove(fChunks + first + newCount, fChunks + last, (fChunkCount - last) * sizeof(Chunk));
+	memcpy(fChunks + first, newChunks, newCount * sizeof(Chunk));
+	fChunkCount = chunkCount;
+	free(newChunks);
+
+	if (fWordCount - fLiveCount > kMinCompactCount && fWordCount - fLiveCount > fLiveCount)
+		Compact();
+
+	return true;
+}
+
+
+void TWordIndex::Update()
+{
+	while (UpdateAhead(fLayout->GetTextLength() + kChunkLength))
+		;
+}
+
+
+void TWordIndex::FindCompletions(const TChar* prefix, STextOffset length, TDynamicArray<Completion>& completions)
+{
+	Update();
+
+	// find the first word not before prefix
+	uint32 low = 0;
+	uint32 high = fSortedCount;
+
+	while (low < high)
+	{
+		uint32 middle = (low + high) / 2;
+		const Word& word = fWords[fSorted[middle]];
+
+		if (CompareWords(fNames + word.name, word.length, prefix, length) < 0)
+			low = middle + 1;
+		else
+			high = middle;
+	}
+
+	for (uint32 i = low; i < fSortedCount; i++)
+	{
+		const Word& word = fWords[fSorted[i]];
+
+		if (word.length < length || memcmp(fNames + word.name, prefix, length) != 0)
+			break;
+
+		if (word.count > 0 && word.length > length)
+		{
+			Completion completion;
+			completion.word = fNames + word.name;
+			completion.length = word.length;
+			completion.count = word.count;
+			completions.InsertLast(completion);
+		}
+	}
+}
+
+
+// where the run of completions in order that starts at start ends
+static inline uint32 RunEnd(const TWordIndex::Completion* completions, uint32 start, uint32 count)
+{
+	uint32 end = start + 1;
+
+	while (end < count && CompareCompletionWords(&completions[end - 1], &completions[end]) <= 0)
+		end++;
+
+	return end;
+}
+
+
+// sorts completions made of a few runs that are already in order by merging the runs in pairs
+static void MergeRuns(TWordIndex::Completion* completions, uint32 count)
+{
+	TWordIndex::Completion* temp = NULL;
+	TWordIndex::Completion* from = completions;
+	TWordIndex::Completion* to = NULL;
+
+	while (RunEnd(from, 0, count) < count)
+	{
+		if (!temp)
+		{
+			temp = (TWordIndex::Completion *)malloc(count * sizeof(TWordIndex::Completion));
+			ASSERT(temp);
+			to = temp;
+		}
+
+		uint32 start = 0;
+
+		while (start < count)
+		{
+			uint32 middle = RunEnd(from, start, count);
+			uint32 end = (middle < count ? RunEnd(from, middle, count) : count);
+			uint32 left = start;
+			uint32 right = middle;
+
+			for (uint32 i = start; i < end; i++)
+			{
+				if (right == end || (left < middle && CompareCompletionWords(&from[left], &from[right]) <= 0))
+					to[i] = from[left++];
+				else
+					to[i] = from[right++];
+			}
+
+			start = end;
+		}
+
+		TWordIndex::Completion* swap = from;
+		from = to;
+		to = swap;
+	}
+
+	if (from != completions)
+		memcpy(completions, from, count * sizeof(TWordIndex::Completion));
+
+	free(temp);
+}
+
+
+uint32 TWordIndex::MergeCompletions(Completion* completions, uint32 count, uint32 maxCount)
+{
+	if (count == 0)
+		return 0;
+
+	// each index gives its words in order, so the runs from each only need merging
+	MergeRuns(completions, count);
+
+	uint32 result = 1;
+
+	for (uint32 i = 1; i < count; i++)
+	{
+		Completion& previous = completions[result - 1];
+
+		if (CompareWords(previous.word, previous.length, completions[i].word, completions[i].length) == 0)
+			previous.count += completions[i].count;
+		else
+			completions[result++] = completions[i];
+	}
+
+	// move the most used to the front, without sorting the rest
+	if (result > maxCount)
+	{
+		uint32 kept = 0;
+
+		for (uint32 i = 0; i < result; i++)
+		{
+			if (kept == maxCount && CompareCompletionCounts(&completions[i], &completions[kept - 1]) >= 0)
+				continue;
+
+			Completion completion = completions[i];
+			uint32 j = (kept < maxCount ? kept++ : kept - 1);
+
+			while (j > 0 && CompareCompletionCounts(&completion, &completions[j - 1]) < 0)
+			{
+				completions[j] = completions[j - 1];
+				j--;
+			}
+
+			completions[j] = completion;
+		}
+
+		result = maxCount;
+	}
+	else
+		qsort(completions, result, sizeof(Completion), CompareCompletionCounts);
+
+	return result;
+}
+
+
+void TWordIndex::ScanChunk(Chunk& chunk, STextOffset start, STextOffset end)
+{
+	const TChar* text = fLayout->GetText();
+
+	fScanMark++;
+	fScanWordCount = 0;
+
+	STextOffset offset = start;
+
+	while (offset < end)
+	{
+		if (!IsWordCharacter(text[offset]))
+		{
+			offset++;
+			continue;
+		}
+
+		STextOffset wordStart = offset;
+		while (offset < end && IsWordCharacter(text[offset]))
+			offset++;
+
+		// numbers are not worth completing
+		uint32 length = offset - wordStart;
+		if (length < kMinWordLength || length > kMaxWordLength || isdigit((unsigned char)text[wordStart]))
+			continue;
+
+		const TChar* name = text + wordStart;
+		uint32 hash = HashWord(name, length);
+		uint32 index = FindWord(name, length, hash);
+
+		if (index == kNoWord)
+			index = AddWord(name, length, hash);
+
+		Word& word = fWords[index];
+
+		if (word.count++ == 0)
+			fLiveCount++;
+
+		if (word.scanMark == fScanMark)
+			fScanWords[word.scanEntry].count++;
+		else
+		{
+			if (fScanWordCount == fScanWordSize)
+			{
+				fScanWordSize = (fScanWordSize > 0 ? fScanWordSize * 2 : 256);
+				fScanWords = (ChunkWord *)realloc(fScanWords, fScanWordSize * sizeof(ChunkWord));
+				ASSERT(fScanWords);
+			}
+
+			word.scanMark = fScanMark;
+			word.scanEntry = fScanWordCount;
+			fScanWords[fScanWordCount].word = index;
+			fScanWords[fScanWordCount].count = 1;
+			fScanWordCount++;
+		}
+	}
+
+	chunk.start = start;
+	chunk.wordCount = fScanWordCount;
+	chunk.edited = false;
+	chunk.words = NULL;
+
+	if (fScanWordCount > 0)
+	{
+		chunk.words = (ChunkWord *)malloc(fScanWordCount * sizeof(ChunkWord));
+		ASSERT(chunk.words);
+		memcpy(chunk.words, fScanWords, fScanWordCount * sizeof(ChunkWord));
+	}
+}
+
+
+void TWordIndex::RemoveWords(Chunk& chunk)
+{
+	for (uint32 i = 0; i < chunk.wordCount; i++)
+	{
+		Word& word = fWords[chunk.words[i].word];
+		ASSERT(word.count >= chunk.words[i].count);
+
+		word.count -= chunk.words[i].count;
+		if (word.count == 0)
+			fLiveCount--;
+	}
+
+	chunk.wordCount = 0;
+}
+
+
+uint32 TWordIndex::FindWord(const TChar* name, uint32 length, uint32 hash)
+{
+	uint32 index = fBuckets[hash & (fBucketCount - 1)];
+
+	while (index != kNoWord)
+	{
+		const Word& word = fWords[index];
+
+		if (word.length == length && memcmp(fNames + word.name, name, length) == 0)
+			break;
+
+		index = word.next;
+	}
+
+	return index;
+}
+
+
+uint32 TWordIndex::AddWord(const TChar* name, uint32 length, uint32 hash)
+{
+	if (fWordCount == fWordSize)
+	{
+		fWordSize = (fWordSize > 0 ? fWordSize * 2 : 1024);
+		fWords = (Word *)realloc(fWords, fWordSize * sizeof(Word));
+		ASSERT(fWords);
+	}
+
+	if (fNamesLength + length > fNamesSize)
+	{
+		fNamesSize = (fNamesLength + length) * 2 + 4096;
+		fNames = (TChar *)realloc(fNames, fNamesSize * sizeof(TChar));
+		ASSERT(fNames);
+	}
+
+	uint32 index = fWordCount++;
+	Word& word = fWords[index];
+	word.name = fNamesLength;
+	word.length = length;
+	word.count = 0;
+	word.scanMark = 0;
+	word.scanEntry = 0;
+
+	memcpy(fNames + fNamesLength, name, length * sizeof(TChar));
+	fNamesLength += length;
+
+	uint32& bucket = fBuckets[hash & (fBucketCount - 1)];
+	word.next = bucket;
+	bucket = index;
+
+	if (fWordCount > fBucketCount)
+		Rehash(fBucketCount * 2);
+
+	return index;
+}
+
+
+void TWordIndex::Rehash(uint32 bucketCount)
+{
+	fBucketCount = bucketCount;
+	fBuckets = (uint32 *)realloc(fBuckets, fBucketCount * sizeof(uint32));
+	ASSERT(fBuckets);
+	memset(fBuckets, 0xFF, fBucketCount * sizeof(uint32));
+
+	for (uint32 i = 0; i < fWordCount; i++)
+	{
+		Word& word = fWords[i];
+		uint32& bucket = fBuckets[HashWord(fNames + word.name, word.length) & (fBucketCount - 1)];
+		word.next = bucket;
+		bucket = i;
+	}
+}
+
+
+void TWordIndex::Sort()
+{
+	if (fSortedCount == fWordCount)
+		return;
+
+	// sort the words added since and merge them in
+	uint32 newCount = fWordCount - fSortedCount;
+	NewWord* newWords = (NewWord *)malloc(newCount * sizeof(NewWord));
+	ASSERT(newWords);
+
+	for (uint32 i = 0; i < newCount; i++)
+	{
+		const Word& word = fWords[fSortedCount + i];
+		newWords[i].name = fNames + word.name;
+		newWords[i].length = word.length;
+		newWords[i].word = fSortedCount + i;
+	}
+
+	qsort(newWords, newCount, sizeof(NewWord), CompareNewWords);
+
+	uint32* sorted = (uint32 *)malloc(fWordCount * sizeof(uint32));
+	ASSERT(sorted);
+
+	uint32 oldIndex = 0;
+	uint32 newIndex = 0;
+	uint32 count = 0;
+
+	while (oldIndex < fSortedCount || newIndex < newCount)
+	{
+		if (newIndex == newCount)
+			sorted[count++] = fSorted[oldIndex++];
+		else if (oldIndex == fSortedCount)
+			sorted[count++] = newWords[newIndex++].word;
+		else
+		{
+			const Word& word = fWords[fSorted[oldIndex]];
+
+			if (CompareWords(fNames + word.name, word.length, newWords[newIndex].name, newWords[newIndex].length) <= 0)
+				sorted[count++] = fSorted[oldIndex++];
+			else
+				sorted[count++] = newWords[newIndex++].word;
+		}
+	}
+
+	free(newWords);
+	free(fSorted);
+	fSorted = sorted;
+	fSortedCount = fWordCount;
+}
+
+
+void TWordIndex::Compact()
+{
+	// drop the words no longer used and renumber the rest, keeping their order
+	uint32* remap = (uint32 *)malloc(fWordCount * sizeof(uint32));
+	ASSERT(remap);
+
+	TChar* names = (TChar *)malloc((fNamesLength > 0 ? fNamesLength : 1) * sizeof(TChar));
+	ASSERT(names);
+
+	uint32 count = 0;
+	uint32 namesLength = 0;
+	uint32 sortedCount = 0;
+
+	for (uint32 i = 0; i < fWordCount; i++)
+	{
+		if (fWords[i].count == 0)
+		{
+			remap[i] = kNoWord;
+			continue;
+		}
+
+		if (i < fSortedCount)
+			sortedCount++;
+
+		Word& word = fWords[count];
+		word = fWords[i];
+		memcpy(names + namesLength, fNames + word.name, word.length * sizeof(TChar));
+		word.name = namesLength;
+		word.scanMark = 0;
+		namesLength += word.length;
+		remap[i] = count++;
+	}
+
+	for (uint32 i = 0; i < fChunkCount; i++)
+	{
+		Chunk& chunk = fChunks[i];
+
+		for (uint32 j = 0; j < chunk.wordCount; j++)
+			chunk.words[j].word = remap[chunk.words[j].word];
+	}
+
+	uint32 sorted = 0;
+
+	for (uint32 i = 0; i < fSortedCount; i++)
+	{
+		if (remap[fSorted[i]] != kNoWord)
+			fSorted[sorted++] = remap[fSorted[i]];
+	}
+
+	ASSERT(sorted == sortedCount);
+	free(remap);
+
+	free(fNames);
+	fNames = names;
+	fNamesLength = namesLength;
+	fNamesSize = (namesLength > 0 ? namesLength : 1);
+	fWordCount = count;
+	fSortedCount = sortedCount;
+
+	uint32 bucketCount = 1024;
+	while (bucketCount < fWordCount)
+		bucketCount *= 2;
+
+	Rehash(bucketCount);
+}
@@ -0,0 +1,119 @@
+// ========================================================================================
+//	TWordIndex.h			   Copyright (C) 2001-2009 Mike Voydanoff. All rights reserved.
+// ========================================================================================
+/*
+	This program is free software; you can redistribute it and/or
+	modify it under the terms of the GNU General Public License
+	as published by the Free Software Foundation; either version 2
+	of the License, or (at your option) any later version.
+	
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+	
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+*/
+#ifndef __TWordIndex__
+#define __TWordIndex__
+
+#include "fw/TTextLayout.h"
+#include "fw/TDynamicArray.h"
+
+#include <ctype.h>
+
+
+// The words in a text and how many times each is used, kept up to date as the text is edited.
+// The text is split into chunks of about kChunkLength characters that remember the words they added,
+// so an edit only takes back and rescans the words of the chunks it touched.
+// The words are also kept sorted, so the ones starting with a prefix are found with a binary search.
+
+class TWordIndex
+{
+public:
+	struct Completion
+	{
+		const TChar*		word;
+		STextOffset			length;
+		uint32				count;
+	};
+
+							TWordIndex(const TTextLayout* layout);
+							~TWordIndex();
+
+	void					TextChanged(STextOffset offset, STextOffset oldLength, STextOffset newLength);
+
+	// indexes about maxLength characters of the text edited since, returns false when there was none left
+	bool					UpdateAhead(STextOffset maxLength);
+	void					Update();
+	inline bool				NeedsUpdate() const { return fEdited; }
+
+	// adds the words longer than prefix that start with it, in order.  the words are valid until the index changes.
+	void					FindCompletions(const TChar* prefix, STextOffset length, TDynamicArray<Completion>& completions);
+
+	// combines the same words found in different indexes and puts the maxCount most used first, returns how many that left
+	static uint32			MergeCompletions(Completion* completions, uint32 count, uint32 maxCount);
+
+	static inline bool		IsWordCharacter(TChar ch) { return (isalnum((unsigned char)ch) || ch == '_' || (unsigned char)ch >= 0x80); }
+
+protected:
+	struct Word
+	{
+		uint32				name;			// offset in fNames
+		uint32				length;
+		uint32				count;
+		uint32				next;			// in the same hash bucket
+		uint32				scanMark;		// last chunk scan that found it
+		uint32				scanEntry;		// and where it is in fScanWords
+	};
+
+	struct ChunkWord
+	{
+		uint32				word;
+		uint32				count;
+	};
+
+	struct Chunk
+	{
+		STextOffset			start;
+		ChunkWord*			words;
+		uint32				wordCount;
+		bool				edited;
+	};
+
+	void					ScanChunk(Chunk& chunk, STextOffset start, STextOffset end);
+	void					RemoveWords(Chunk& chunk);
+	uint32					FindWord(const TChar* name, uint32 length, uint32 hash);
+	uint32					AddWord(const TChar* name, uint32 length, uint32 hash);
+	void					Rehash(uint32 bucketCount);
+	void					Sort();
+	void					Compact();
+
+protected:
+	const TTextLayout*		fLayout;
+	Chunk*					fChunks;				// sorted, the first always starts at 0
+	uint32					fChunkCount;
+	bool					fEdited;
+
+	Word*					fWords;
+	uint32					fWordCount;
+	uint32					fWordSize;
+	uint32					fLiveCount;				// words that are still used somewhere
+	TChar*					fNames;
+	uint32					fNamesLength;
+	uint32					fNamesSize;
+	uint32*					fBuckets;
+	uint32					fBucketCount;			// a power of 2
+	uint32*					fSorted;				// the first fSortedCount words, by name
+	uint32					fSortedCount;
+
+	// while a chunk is scanned
+	ChunkWord*				fScanWords;
+	uint32					fScanWordCount;
+	uint32					fScanWordSize;
+	uint32					fScanMark;
+};
+
+#endif // __TWordIndex__